@@ -12,9 +12,32 @@
 #include <cli/text_io_handler.hpp>
 #include <script/functions/functions.hpp>
 #include <script/profiler.hpp>
+#include <script/to_value.hpp>
+#include <script/script_cache.hpp>
+#include <script/scriptable.hpp>
+#include <util/lru_cache.hpp>
+#include <util/tagged_string.hpp>
+#include <util/stage_timer.hpp>
+#include <util/io/package_manager.hpp>
 #include <data/format/formats.hpp>
+#include <data/game.hpp>
+#include <data/card.hpp>
+#include <data/keyword.hpp>
+#include <data/field/text.hpp>
+#include <data/field/choice.hpp>
+#include <data/field/color.hpp>
+#include <data/field/information.hpp>
+#include <data/field/package_choice.hpp>
+#include <gui/control/graph.hpp>
+#include <render/text/layout_cache.hpp>
+#include <gfx/gfx.hpp>
+#include <gfx/generated_image.hpp>
+#include <gfx/simd.hpp>
 #include <wx/process.h>
+#include <wx/thread.h>
 #include <wx/wfstream.h>
+#include <wx/mstream.h>
+#include <chrono>
 
 String read_utf8_line(wxInputStream& input, bool until_eof = false);
 
@@ -57,6 +80,7 @@ void CLISetInterface::onChangeSet() {
   Context& ctx = getContext();
   scope = ctx.openScope();
   ei.set = set;
+  stats_cache.clear();
 }
 
 void CLISetInterface::setExportInfoCwd() {
@@ -94,6 +118,577 @@ bool run_script_file(String const& filename) {
   return true;
 }
 
+void CLISetInterface::showStatistics(const String& name) {
+  if (!set) {
+    cli.show_message(MESSAGE_ERROR,_("No set loaded"));
+    return;
+  }
+  StatsDimensionP dim;
+  FOR_EACH(d, set->game->statistics_dimensions) {
+    if (name.empty()) cli << d->name << ENDL;
+    else if (d->name == name) dim = d;
+  }
+  if (name.empty()) return;
+  if (!dim) {
+    cli.show_message(MESSAGE_ERROR,_("Unknown statistics dimension: ") + name);
+    return;
+  }
+  // values are cached, so asking again after changing the set only evaluates changed cards
+  vector<size_t> card_indices;
+  vector<vector<String>> rows;
+  stats_cache.rows(*set, vector<StatsDimensionP>(1, dim), card_indices, rows);
+  // group in the same way as the statistics panel
+  GraphDataPre pre;
+  pre.axes.push_back(make_intrusive<GraphAxis>(dim->name, AUTO_COLOR_NO, dim->numeric, dim->bin_size,
+                                               &dim->colors, dim->groups.empty() ? nullptr : &dim->groups));
+  for (size_t i = 0 ; i < rows.size() ; ++i) {
+    GraphElementP e = make_intrusive<GraphElement>(card_indices[i]);
+    e->values.swap(rows[i]);
+    pre.elements.push_back(e);
+  }
+  if (dim->split_list) pre.splitList(0);
+  GraphData data(pre);
+  FOR_EACH_CONST(g, data.axes[0]->groups) {
+    cli << String::Format(_("%6d  "), (int)g.size) << g.name << ENDL;
+  }
+}
+
+double run_timed(const Char* name, int repeat, const function<void()>& fn) {
+  using namespace std::chrono;
+  PROFILER(name);
+  steady_clock::time_point start = steady_clock::now();
+  for (int i = 0 ; i < repeat ; ++i) fn();
+  return duration<double>(steady_clock::now() - start).count();
+}
+
+void write_report(const String& path, const boost::json::object& report) {
+  std::string json = boost::json::serialize(report);
+  if (path.empty()) {
+    cli << String::FromUTF8(json.c_str()) << ENDL;
+    cli.flush();
+  } else {
+    wxFileOutputStream file(path);
+    if (!file.IsOk()) throw Error(_("Unable to open output file: ") + path);
+    file.Write(json.data(), json.size());
+  }
+}
+
+boost::json::object benchmark_script_file(String const& filename, const SetP& set, int repeat, bool& passed) {
+  ScriptP script = parse(read_file(filename));
+  #if USE_SCRIPT_PROFILING
+    small_number_cache_counter.reset();
+  #endif
+  long count = 0;
+  double total = run_timed(_("benchmark script"), repeat, [&]() {
+    FOR_EACH_CONST(card, set->cards) {
+      set->getContext(card).eval(*script);
+      ++count;
+    }
+  });
+  // warnings and errors of the script, for example failed assertions
+  long messages = 0;
+  MessageType type;
+  String message;
+  while (get_queued_message(type, message)) {
+    cli.show_message(type, message);
+    ++messages;
+  }
+  passed = messages == 0;
+  // report
+  boost::json::object result;
+  result["script"]                 = std::string(filename.ToUTF8());
+  result["set"]                    = std::string(set->absoluteFilename().ToUTF8());
+  result["evaluations"]            = count;
+  result["repeat"]                 = repeat;
+  result["total_seconds"]          = total;
+  result["evaluations_per_second"] = total > 0 ? count / total : 0.0;
+  result["messages"]               = messages;
+  #if USE_SCRIPT_PROFILING
+    // numbers created by the scripts, misses had to be allocated
+    long hits = small_number_cache_counter.hits, misses = small_number_cache_counter.misses;
+    result["numbers"] = {{"hits", hits}, {"misses", misses}, {"hit_rate", small_number_cache_counter.hitRate()},
+                         {"allocations_per_evaluation", count > 0 ? (double)misses / count : 0.0}};
+  #endif
+  return result;
+}
+
+boost::json::object benchmark_load_set(String const& filename, int repeat) {
+  // average time to load the set, packages are loaded again each time
+  auto time_loads = [&](bool cold) {
+    double total = 0;
+    for (int i = 0 ; i < repeat ; ++i) {
+      package_manager.reset();
+      if (cold) script_cache.clear();
+      total += run_timed(cold ? _("load set, cold") : _("load set, warm"), 1, [&]() { import_set(filename); });
+    }
+    return total / repeat;
+  };
+  double cold = time_loads(true);
+  // the last cold load filled the cache
+  script_cache.counter.reset();
+  double warm = time_loads(false);
+  // report
+  boost::json::object result;
+  result["set"]          = std::string(filename.ToUTF8());
+  result["repeat"]       = repeat;
+  result["cold_seconds"] = cold;
+  result["warm_seconds"] = warm;
+  result["speedup"]      = warm > 0 ? cold / warm : 0.0;
+  result["script_cache"] = {{"hits", (long)script_cache.counter.hits}, {"misses", (long)script_cache.counter.misses},
+                            {"hit_rate", script_cache.counter.hitRate()}};
+  return result;
+}
+
+/// Are the values of a field always computed by a script?
+bool has_value_script(const Field& field) {
+  if (const TextField*          f = dynamic_cast<const TextField*>(&field))          return (bool)f->script;
+  if (const ChoiceField*        f = dynamic_cast<const ChoiceField*>(&field))        return (bool)f->script;
+  if (const ColorField*         f = dynamic_cast<const ColorField*>(&field))         return (bool)f->script;
+  if (const InfoField*          f = dynamic_cast<const InfoField*>(&field))          return (bool)f->script;
+  if (const PackageChoiceField* f = dynamic_cast<const PackageChoiceField*>(&field)) return (bool)f->script;
+  return false;
+}
+
+boost::json::object benchmark_update_all(const SetP& set, int repeat, int max_jobs, bool& consistent) {
+  // the values computed by scripts, these are cleared before each update,
+  // so every run computes them from scratch instead of starting from the values of the previous run
+  vector<size_t> script_fields;
+  FOR_EACH_CONST(field, set->game->card_fields) {
+    if (has_value_script(*field)) script_fields.push_back(field->index);
+  }
+  auto clear_script_values = [&]() {
+    FOR_EACH(card, set->cards) {
+      for (size_t i : script_fields) {
+        if (i < card->data.size()) card->data.at(i) = set->game->card_fields[i]->newValue();
+      }
+    }
+  };
+  int jobs = 1;
+  auto time_updates = [&](bool parallel) {
+    double total = 0;
+    for (int i = 0 ; i < repeat ; ++i) {
+      clear_script_values();
+      total += run_timed(parallel ? _("update all, parallel") : _("update all, serial"), 1, [&]() {
+        jobs = set->updateAll(parallel, max_jobs);
+      });
+    }
+    return total / repeat;
+  };
+  auto card_values = [&]() {
+    vector<String> values;
+    FOR_EACH_CONST(card, set->cards) {
+      FOR_EACH_CONST(v, card->data) values.push_back(v->toString());
+    }
+    return values;
+  };
+  double serial = time_updates(false);
+  vector<String> expected = card_values();
+  double parallel = time_updates(true);
+  vector<String> actual = card_values();
+  // the parallel update should give exactly the same values
+  long mismatches = 0;
+  for (size_t i = 0 ; i < expected.size() ; ++i) {
+    if (expected[i] != actual[i]) ++mismatches;
+  }
+  consistent = mismatches == 0;
+  #if !USE_SCRIPT_PROFILING // otherwise the cards are always updated one at a time
+    // with a single thread, the parallel update is the same as the serial one, so nothing was checked
+    if (jobs <= 1) consistent = false;
+  #endif
+  // report
+  boost::json::object result;
+  result["set"]              = std::string(set->absoluteFilename().ToUTF8());
+  result["cards"]            = set->cards.size();
+  result["jobs"]             = jobs;
+  result["repeat"]           = repeat;
+  result["serial_seconds"]   = serial;
+  result["parallel_seconds"] = parallel;
+  result["speedup"]          = parallel > 0 ? serial / parallel : 0.0;
+  result["values"]           = expected.size();
+  result["script_values"]    = script_fields.size() * set->cards.size();
+  result["mismatches"]       = mismatches;
+  return result;
+}
+
+boost::json::object benchmark_parse_set(String const& filename, int repeat) {
+  // load the set and its packages, recording the scripts in them
+  vector<ScriptSource> sources;
+  package_manager.reset();
+  recorded_script_sources = &sources;
+  SetP set;
+  try {
+    set = import_set(filename);
+  } catch (...) {
+    recorded_script_sources = nullptr;
+    throw;
+  }
+  recorded_script_sources = nullptr;
+  // tokenize
+  long characters = 0, tokens = 0;
+  FOR_EACH_CONST(s, sources) {
+    characters += (long)s.source.size();
+    tokens     += (long)count_tokens(s.source, s.string_mode);
+  }
+  double tokenize = run_timed(_("tokenize"), repeat, [&]() {
+    FOR_EACH_CONST(s, sources) count_tokens(s.source, s.string_mode);
+  });
+  // parse, the scripts are already known to be valid
+  double total = run_timed(_("parse"), repeat, [&]() {
+    vector<ScriptParseError> errors;
+    FOR_EACH_CONST(s, sources) parse(s.source, s.package, s.string_mode, errors);
+  });
+  // report
+  boost::json::object result;
+  result["set"]               = std::string(filename.ToUTF8());
+  result["scripts"]           = sources.size();
+  result["characters"]        = characters;
+  result["tokens"]            = tokens;
+  result["repeat"]            = repeat;
+  result["tokenize_seconds"]  = tokenize;
+  result["tokens_per_second"] = tokenize > 0 ? tokens * repeat / tokenize : 0.0;
+  result["total_seconds"]     = total;
+  result["parse_seconds"]     = total / repeat;
+  return result;
+}
+
+boost::json::object benchmark_export_image(const SetP& set, int repeat) {
+  reset_stage_times();
+  text_measure_cache_counter.reset();
+  text_layout_cache_counter.reset();
+  generated_image_cache_counter.reset();
+  clear_generated_image_cache(); // measure how much work the cards share
+  stage_timing_enabled = true;
+  double render_time = 0;
+  long count = 0;
+  double total = run_timed(_("render benchmark"), repeat, [&]() {
+    FOR_EACH_CONST(card, set->cards) {
+      Image img;
+      render_time += run_timed(_("export_image"), 1, [&]() { img = export_image(set, card); });
+      // encode to memory, the speed of the disk is not what we are measuring
+      StageTimer timer(STAGE_IMAGE_ENCODE);
+      wxMemoryOutputStream out;
+      img.SaveFile(out, wxBITMAP_TYPE_PNG);
+      ++count;
+    }
+  });
+  stage_timing_enabled = false;
+  // report
+  boost::json::object stages;
+  for (int i = 0 ; i < STAGE_COUNT ; ++i) {
+    StageTime t = stage_time((RenderStage)i);
+    stages[stage_name((RenderStage)i)] = {{"seconds", t.seconds}, {"calls", t.calls}};
+  }
+  // the whole of export_image, includes all stages except encoding
+  stages["render"] = {{"seconds", render_time}, {"calls", count}};
+  boost::json::object result;
+  result["set"]              = std::string(set->absoluteFilename().ToUTF8());
+  result["cards"]            = count;
+  result["repeat"]           = repeat;
+  result["total_seconds"]    = total;
+  result["cards_per_second"] = total > 0 ? count / total : 0.0;
+  result["stages"]           = stages;
+  auto counter = [](const CacheCounter& c) -> boost::json::object {
+    return {{"hits", (long)c.hits}, {"misses", (long)c.misses}, {"hit_rate", c.hitRate()}};
+  };
+  result["text_measure_cache"]    = counter(text_measure_cache_counter);
+  result["text_layout_cache"]     = counter(text_layout_cache_counter);
+  result["generated_image_cache"] = counter(generated_image_cache_counter);
+  return result;
+}
+
+boost::json::object benchmark_keywords(const SetP& set, int repeat, bool& consistent) {
+  // the keywords of the set and the game, like expand_keywords uses
+  KeywordDatabase db;
+  db.prepare_parameters(set->game->keyword_parameter_types, set->keywords);
+  db.prepare_parameters(set->game->keyword_parameter_types, set->game->keywords);
+  db.add(set->keywords);
+  db.add(set->game->keywords);
+  // keywords are expanded in the untagged text
+  vector<String> texts;
+  FOR_EACH_CONST(card, set->cards) {
+    FOR_EACH_CONST(v, card->data) {
+      if (TextValue* text = dynamic_cast<TextValue*>(v.get())) {
+        texts.push_back(untag_no_escape(text->value()));
+      }
+    }
+  }
+  auto time_matches = [&](bool reference, vector<pair<size_t,const Keyword*>>& found) {
+    return run_timed(reference ? _("match keywords, reference") : _("match keywords"), repeat, [&]() {
+      found.clear();
+      FOR_EACH_CONST(text, texts) {
+        FOR_EACH_CONST(m, db.matches(text, reference)) found.emplace_back(m.pos, m.keyword);
+      }
+    }) / repeat;
+  };
+  vector<pair<size_t,const Keyword*>> expected, actual;
+  double reference = time_matches(true,  expected);
+  double matcher   = time_matches(false, actual);
+  // the matches are sorted, but keywords with the same name, position and length can be in any order
+  sort(expected.begin(), expected.end());
+  sort(actual.begin(),   actual.end());
+  consistent = expected == actual;
+  // report
+  boost::json::object result;
+  result["set"]               = std::string(set->absoluteFilename().ToUTF8());
+  result["keywords"]          = set->keywords.size() + set->game->keywords.size();
+  result["texts"]             = texts.size();
+  result["repeat"]            = repeat;
+  result["matches"]           = actual.size();
+  result["reference_seconds"] = reference;
+  result["seconds"]           = matcher;
+  result["speedup"]           = matcher > 0 ? reference / matcher : 0.0;
+  result["consistent"]        = consistent;
+  return result;
+}
+
+/// Gaussian blur with the full kernel, to compare gaussian_blur with, the results are in [0..255]
+void reference_gaussian_blur(const Byte* in, double* out, int w, int h, double sigma_x, double sigma_y) {
+  vector<double> horizontal((size_t)w * h);
+  for (int pass = 0 ; pass < 2 ; ++pass) {
+    double sigma = pass == 0 ? sigma_x : sigma_y;
+    int radius = (int)ceil(4 * sigma);
+    vector<double> kernel;
+    double total = 0;
+    for (int d = -radius ; d <= radius ; ++d) {
+      kernel.push_back(sigma > 0 ? exp(-d * d / (2 * sigma * sigma)) : 1);
+      total += kernel.back();
+    }
+    for (int y = 0 ; y < h ; ++y) {
+      for (int x = 0 ; x < w ; ++x) {
+        double sum = 0;
+        for (int d = -radius ; d <= radius ; ++d) {
+          int xx = pass == 0 ? x + d : x, yy = pass == 0 ? y : y + d;
+          if (xx < 0 || yy < 0 || xx >= w || yy >= h) continue;
+          sum += kernel[d + radius] * (pass == 0 ? in[xx + yy * w] : horizontal[xx + yy * w]);
+        }
+        (pass == 0 ? horizontal[x + y * w] : out[x + y * w]) = sum / total;
+      }
+    }
+  }
+}
+
+boost::json::object benchmark_blend(int repeat, bool& exact) {
+  // Correctness: every pair of bytes, followed by some bytes for the scalar tail
+  const size_t pairs = 256 * 256 + 37;
+  vector<Byte> a(pairs), b(pairs), mask(pairs * 3), expected(pairs), actual(pairs);
+  unsigned int seed = 12345;
+  auto random_byte = [&seed]() { seed = seed * 1103515245 + 12345; return Byte(seed >> 16); };
+  for (size_t i = 0 ; i < pairs ; ++i) {
+    a[i] = i < 65536 ? Byte(i >> 8)  : random_byte();
+    b[i] = i < 65536 ? Byte(i & 255) : random_byte();
+  }
+  boost::json::array mismatched_modes;
+  for (int combine = COMBINE_NORMAL ; combine <= COMBINE_SMALLER_THAN_250 ; ++combine) {
+    expected = a;
+    actual   = a;
+    combine_bytes(expected.data(), b.data(), pairs, (ImageCombine)combine, true);
+    combine_bytes(actual.data(),   b.data(), pairs, (ImageCombine)combine);
+    if (expected != actual) mismatched_modes.push_back(combine);
+  }
+  // the mask and alpha kernels, for every mask value, with a contiguous and a strided (red channel) mask
+  int blend_mismatches = 0;
+  for (int m = 0 ; m < 256 ; ++m) {
+    for (size_t stride = 1 ; stride <= 3 ; stride += 2) {
+      for (size_t i = 0 ; i < mask.size() ; ++i) {
+        mask[i] = i % stride == 0 ? Byte(m) : random_byte();
+      }
+      expected = a;
+      actual   = a;
+      mask_blend_bytes(expected.data(), b.data(), mask.data(), pairs, stride, true);
+      mask_blend_bytes(actual.data(),   b.data(), mask.data(), pairs, stride);
+      if (expected != actual) blend_mismatches++;
+      expected = a;
+      actual   = a;
+      multiply_alpha_bytes(expected.data(), mask.data(), pairs, stride, true);
+      multiply_alpha_bytes(actual.data(),   mask.data(), pairs, stride);
+      if (expected != actual) blend_mismatches++;
+    }
+    expected = a;
+    actual   = a;
+    multiply_alpha_bytes(expected.data(), Byte(m), pairs, true);
+    multiply_alpha_bytes(actual.data(),   Byte(m), pairs);
+    if (expected != actual) blend_mismatches++;
+  }
+  // the gaussian blur is approximated, it must be within its tolerance, for small and large blurs
+  const int blur_w = 200, blur_h = 150;
+  vector<Byte> shape(blur_w * blur_h);
+  for (int y = 0 ; y < blur_h ; ++y) {
+    for (int x = 0 ; x < blur_w ; ++x) {
+      bool in_rect = x > 40 && x < 120 && y > 30 && y < 100;
+      shape[x + y * blur_w] = in_rect || random_byte() < 16 ? 255 : 0;
+    }
+  }
+  vector<UInt> blurred(shape.size());
+  vector<double> expected_blur(shape.size());
+  double blur_error = 0;
+  for (double sigma : {0.0, 0.5, 1.5, 2.0, 3.0, 8.0, 25.0, 50.0, 120.0}) {
+    UInt scale = gaussian_blur(shape.data(), blurred.data(), blur_w, blur_h, sigma, sigma * 0.7);
+    reference_gaussian_blur(shape.data(), expected_blur.data(), blur_w, blur_h, sigma, sigma * 0.7);
+    for (size_t i = 0 ; i < shape.size() ; ++i) {
+      blur_error = max(blur_error, fabs(blurred[i] / (double)scale - expected_blur[i]));
+    }
+  }
+  // generated images are shared between equal image graphs, but never between different ones
+  int sharing_mismatches = check_generated_image_sharing();
+  exact = mismatched_modes.empty() && blend_mismatches == 0 && blur_error <= GAUSSIAN_BLUR_TOLERANCE && sharing_mismatches == 0;
+  
+  // Throughput: buffers the size of a 1024x1024 image, time the scalar and the vectorized versions
+  const size_t size = 1024 * 1024 * 3;
+  vector<Byte> data(size), other(size), image_mask(size);
+  for (size_t i = 0 ; i < size ; ++i) {
+    data[i]       = random_byte();
+    other[i]      = random_byte();
+    image_mask[i] = random_byte();
+  }
+  auto report = [](double reference, double fast) {
+    boost::json::object result;
+    result["reference_seconds"] = reference;
+    result["seconds"]           = fast;
+    result["speedup"]           = fast > 0 ? reference / fast : 0.0;
+    return result;
+  };
+  auto time_combine = [&](bool reference) {
+    return run_timed(reference ? _("combine, reference") : _("combine"), repeat, [&]() {
+      for (int combine = COMBINE_NORMAL ; combine <= COMBINE_SMALLER_THAN_250 ; ++combine) {
+        combine_bytes(data.data(), other.data(), size, (ImageCombine)combine, reference);
+      }
+    });
+  };
+  auto time_mask_blend = [&](bool reference) {
+    return run_timed(reference ? _("mask blend, reference") : _("mask blend"), repeat, [&]() {
+      mask_blend_bytes(data.data(), other.data(), image_mask.data(), size, 1, reference);
+      mask_blend_bytes(data.data(), other.data(), image_mask.data(), size / 3, 3, reference);
+    });
+  };
+  auto time_alpha = [&](bool reference) {
+    return run_timed(reference ? _("set alpha, reference") : _("set alpha"), repeat, [&]() {
+      multiply_alpha_bytes(data.data(), image_mask.data(), size / 3, 1, reference);
+      multiply_alpha_bytes(data.data(), image_mask.data(), size / 3, 3, reference);
+      multiply_alpha_bytes(data.data(), Byte(200), size / 3, reference);
+    });
+  };
+  auto time_blur = [&](bool reference) {
+    // blur one channel of the image, with a radius of 2% of its width, like a drop shadow
+    vector<UInt>   result(size / 3);
+    vector<double> reference_result(reference ? size / 3 : 0);
+    return run_timed(reference ? _("gaussian blur, reference") : _("gaussian blur"), repeat, [&]() {
+      if (reference) reference_gaussian_blur(data.data(), reference_result.data(), 1024, 1024, 20, 20);
+      else           gaussian_blur          (data.data(), result.data(),           1024, 1024, 20, 20);
+    });
+  };
+  // the tables for the modes without a vector version were built by the correctness check, so they are not timed
+  double combine_reference    = time_combine(true),    combine_fast    = time_combine(false);
+  double mask_blend_reference = time_mask_blend(true), mask_blend_fast = time_mask_blend(false);
+  double alpha_reference      = time_alpha(true),      alpha_fast      = time_alpha(false);
+  double blur_reference       = time_blur(true),       blur_fast       = time_blur(false);
+  // report
+  boost::json::object result;
+  result["instruction_set"]  = simd_name();
+  result["repeat"]           = repeat;
+  result["exact"]            = exact;
+  result["mismatched_modes"] = mismatched_modes;
+  result["blend_mismatches"] = blend_mismatches;
+  result["blur_error"]       = blur_error;
+  result["sharing_mismatches"] = sharing_mismatches;
+  result["combine"]          = report(combine_reference,    combine_fast);
+  result["mask_blend"]       = report(mask_blend_reference, mask_blend_fast);
+  result["set_alpha"]        = report(alpha_reference,      alpha_fast);
+  result["gaussian_blur"]    = report(blur_reference,       blur_fast);
+  return result;
+}
+
+boost::json::object benchmark_resample(int repeat, bool& exact) {
+  unsigned int seed = 54321;
+  auto random_image = [&seed](int w, int h, bool alpha) {
+    Image img(w, h, false);
+    if (alpha) img.InitAlpha();
+    Byte* data = img.GetData();
+    for (int i = 0 ; i < 3 * w * h ; ++i) {
+      seed = seed * 1103515245 + 12345;
+      data[i] = Byte(seed >> 16);
+    }
+    if (alpha) {
+      // runs of transparent and opaque pixels, and some in between
+      Byte* a = img.GetAlpha();
+      for (int i = 0 ; i < w * h ; ++i) {
+        seed = seed * 1103515245 + 12345;
+        int r = (seed >> 16) & 255;
+        a[i] = Byte(r < 64 ? 0 : r < 160 ? 255 : r);
+      }
+    }
+    return img;
+  };
+  auto same_pixels = [](const Image& a, const Image& b) {
+    size_t n = (size_t)a.GetWidth() * a.GetHeight();
+    if (memcmp(a.GetData(), b.GetData(), 3 * n) != 0) return false;
+    if (a.HasAlpha() != b.HasAlpha()) return false;
+    return !a.HasAlpha() || memcmp(a.GetAlpha(), b.GetAlpha(), n) == 0;
+  };
+  // Correctness: the box filter must give exactly the results of the original resampler,
+  // when downsampling, upsampling, resizing in one direction, and with images large enough to use multiple threads
+  struct Case { int w_in, h_in, w_out, h_out; };
+  const Case cases[] = {
+    {301, 211, 75, 52}, {75, 52, 301, 211}, {100, 100, 100, 37}, {37, 100, 200, 100},
+    {37, 100, 1, 1}, {1, 1, 5, 3}, {1000, 800, 333, 267}, {1200, 900, 1500, 1100},
+  };
+  int mismatches = 0;
+  for (const Case& c : cases) {
+    for (int alpha = 0 ; alpha < 2 ; ++alpha) {
+      Image in = random_image(c.w_in, c.h_in, alpha);
+      wxRect rect(0, 0, c.w_in, c.h_in);
+      if (c.w_in > 50 && c.h_in > 50) rect = wxRect(7, 11, c.w_in - 20, c.h_in - 30); // clip some of the input
+      Image expected(c.w_out, c.h_out, false), actual(c.w_out, c.h_out, false);
+      resample_reference(in, expected, rect);
+      resample_and_clip (in, actual,   rect);
+      if (!same_pixels(expected, actual)) ++mismatches;
+    }
+  }
+  // the lanczos filter must keep a constant image constant, and not change an image that is not resized
+  int lanczos_error = 0;
+  Image constant(300, 200, false);
+  memset(constant.GetData(), 123, 3 * 300 * 200);
+  for (const Case& c : cases) {
+    Image out = resample(constant, c.w_out, c.h_out, RESAMPLE_LANCZOS);
+    const Byte* data = out.GetData();
+    for (int i = 0 ; i < 3 * c.w_out * c.h_out ; ++i) {
+      lanczos_error = max(lanczos_error, abs(data[i] - 123));
+    }
+  }
+  Image unchanged = random_image(120, 80, false), same_size(120, 80, false);
+  resample(unchanged, same_size, RESAMPLE_LANCZOS);
+  if (!same_pixels(unchanged, same_size)) ++mismatches;
+  exact = mismatches == 0 && lanczos_error <= 1;
+  
+  // Throughput: card art is usually much larger than the card, and card frames are upsampled for export
+  auto report = [&](const Image& in, int w, int h) {
+    wxRect rect(0, 0, in.GetWidth(), in.GetHeight());
+    Image out(w, h, false);
+    double reference = run_timed(_("resample, reference"), repeat, [&]() { resample_reference(in, out, rect); });
+    double box       = run_timed(_("resample, box"),       repeat, [&]() { resample_and_clip(in, out, rect); });
+    double lanczos   = run_timed(_("resample, lanczos"),   repeat, [&]() { resample_and_clip(in, out, rect, RESAMPLE_LANCZOS); });
+    boost::json::object result;
+    result["reference_seconds"] = reference;
+    result["seconds"]           = box;
+    result["speedup"]           = box > 0 ? reference / box : 0.0;
+    result["lanczos_seconds"]   = lanczos;
+    return result;
+  };
+  Image art  = random_image(3000, 2000, false);
+  Image card = random_image(375, 523, true);
+  // report
+  boost::json::object result;
+  result["instruction_set"] = simd_name();
+  result["cpus"]            = wxThread::GetCPUCount();
+  result["repeat"]          = repeat;
+  result["exact"]           = exact;
+  result["mismatches"]      = mismatches;
+  result["lanczos_error"]   = lanczos_error;
+  result["art_to_card"]     = report(art,  375,  250);
+  result["art_to_export"]   = report(art,  1125, 750);
+  result["card_to_export"]  = report(card, 1125, 1569);
+  return result;
+}
+
 void CLISetInterface::run() {
   // show welcome logo
   if (!quiet) showWelcome();
@@ -136,6 +731,8 @@ void CLISetInterface::showUsage() {
   cli << _("   :pwd                Print the current working directory.\n");
   cli << _("   :cd                 Change the working directory.\n");
   cli << _("   :! <command>        Perform a shell command.\n");
+  cli << _("   :stats [<dimension>] Show the number of cards for each value of a statistics dimension,\n");
+  cli << _("                       or list the dimensions.\n");
   cli << _("\n Commands can be abreviated to their first letter if there is no ambiguity.\n\n");
 }
 
@@ -175,6 +772,8 @@ void CLISetInterface::handleCommand(const String& command) {
         } else {
           cli << _("No set loaded") << ENDL;
         }
+      } else if (before == _(":s") || before == _(":stats")) {
+        showStatistics(arg);
       } else if (before == _(":c") || before == _(":cd")) {
         if (arg.empty()) {
           cli.show_message(MESSAGE_ERROR,_("Give a new working directory."));
@@ -211,6 +810,9 @@ void CLISetInterface::handleCommand(const String& command) {
             arg.ToLong(&level);
             showProfilingStats(profile_aggregated(level));
           }
+          cli << GRAY << String::Format(_("Regex cache: %ld hits, %ld misses (%.1f%%), %d cached"),
+                                        (long)regex_cache_counter.hits, (long)regex_cache_counter.misses,
+                                        100 * regex_cache_counter.hitRate(), (int)regex_cache_size()) << NORMAL << ENDL;
       #endif
       } else {
         cli.show_message(MESSAGE_ERROR,_("Unknown command, type :help for help."));
@@ -12,6 +12,9 @@
 #include <data/set.hpp>
 #include <data/export_template.hpp>
 #include <script/profiler.hpp>
+#include <data/statistics.hpp>
+#include <boost/json.hpp>
+#include <functional>
 
 // ----------------------------------------------------------------------------- : Command line interface
 
@@ -31,6 +34,7 @@ private:
   void showWelcome();
   void showUsage();
   void handleCommand(const String& command);
+  void showStatistics(const String& dimension);
   #if USE_SCRIPT_PROFILING
     void showProfilingStats(const FunctionProfile& parent, int level = 0);
   #endif
@@ -40,6 +44,9 @@ private:
   unique_ptr<Context> our_context;
   size_t scope;
   
+  // values of statistics dimensions, for :stats
+  StatsCache stats_cache;
+  
   // export info, so we can write files
   ExportInfo ei;
   void setExportInfoCwd();
@@ -47,3 +54,45 @@ private:
 
 bool run_script_file(String const& filename);
 
+// ----------------------------------------------------------------------------- : Benchmarks
+
+/// Call fn repeat times, and return how many seconds that took in total
+/** In builds with script profiling the time also shows up in the profile under the given name */
+double run_timed(const Char* name, int repeat, const function<void()>& fn);
+
+/// Write the report of a benchmark as JSON to a file, or to stdout if the path is empty
+void write_report(const String& path, const boost::json::object& report);
+
+/// Evaluate a script file for each card in a set, and report how long that took as JSON
+/** passed is set to whether the script gave no warnings or errors, so the script can check the set with assert */
+boost::json::object benchmark_script_file(String const& filename, const SetP& set, int repeat, bool& passed);
+
+/// Render and encode the images of all cards in a set repeat times, without writing them to disk
+/** Reports the total time and the time spent in each stage of rendering (see RenderStage) as JSON */
+boost::json::object benchmark_export_image(const SetP& set, int repeat = 1);
+
+/// Load a set with its game and stylesheets, with an empty and with a filled script cache, and report how long that took as JSON
+boost::json::object benchmark_load_set(String const& filename, int repeat = 1);
+
+/// Update all card values of a set serially and in parallel, and report how long that took as JSON
+/** Values computed by scripts are cleared before each update, so each run computes all of them.
+ *  The parallel update uses at most max_jobs threads, or one for each processor if max_jobs is 0.
+ *  consistent is set to whether both ways give the same values, and the parallel update used more than one thread */
+boost::json::object benchmark_update_all(const SetP& set, int repeat, int max_jobs, bool& consistent);
+
+/// Parse all scripts in a set and its packages again, and report the parse time and tokenizer throughput as JSON
+boost::json::object benchmark_parse_set(String const& filename, int repeat = 1);
+
+/// Find the keywords in the text values of all cards in a set, and report how long that took as JSON
+/** consistent is set to whether the keyword matcher finds the same matches as searching for every keyword */
+boost::json::object benchmark_keywords(const SetP& set, int repeat, bool& consistent);
+
+/// Compare the vectorized blending and combining kernels with the scalar versions, and report their throughput as JSON
+/** exact is set to whether all kernels gave the same results as the scalar code */
+boost::json::object benchmark_blend(int repeat, bool& exact);
+
+/// Compare the tiled resampler with the original one, and report how long resizing typical card art takes as JSON
+/** exact is set to whether the box filter gave the same results as the original resampler,
+ *  and the lanczos filter kept constant images constant */
+boost::json::object benchmark_resample(int repeat, bool& exact);
+
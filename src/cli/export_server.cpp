@@ -0,0 +1,214 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/error.hpp>
+#include <cli/export_server.hpp>
+#include <cli/text_io_handler.hpp>
+#include <script/functions/functions.hpp>
+#include <script/parser.hpp>
+#include <script/to_value.hpp>
+#include <data/set.hpp>
+#include <data/card.hpp>
+#include <data/format/formats.hpp>
+#include <wx/filename.h>
+#include <chrono>
+
+ScriptValueP export_set(SetP const& set, vector<CardP> const& cards, ExportTemplateP const& exp, String const& outname);
+
+// ----------------------------------------------------------------------------- : Utilities
+
+std::string to_json_string(const String& str) {
+  return std::string(str.ToUTF8());
+}
+String from_json_string(const boost::json::string& str) {
+  return String::FromUTF8(str.data(), str.size());
+}
+
+/// Get a string field of a request
+String request_string(const boost::json::object& request, const char* key, bool required = true) {
+  const boost::json::value* v = request.if_contains(key);
+  if (!v) {
+    if (required) throw Error(_("Missing field in request: ") + String(key));
+    return String();
+  }
+  if (!v->is_string()) throw Error(_("Field should be a string: ") + String(key));
+  return from_json_string(v->get_string());
+}
+
+/// Get a card by index from a request
+CardP request_card(const boost::json::object& request, const SetP& set, bool required = true) {
+  const boost::json::value* v = request.if_contains("card");
+  if (!v) {
+    if (required) throw Error(_("Missing field in request: card"));
+    return CardP();
+  }
+  if (!v->is_int64()) throw Error(_("Field should be an integer: card"));
+  int64_t i = v->get_int64();
+  if (i < 0 || (size_t)i >= set->cards.size()) {
+    throw Error(String::Format(_("Card index out of range: %d, the set has %d cards"), (int)i, (int)set->cards.size()));
+  }
+  return set->cards[(size_t)i];
+}
+
+/// Read a line of UTF-8 from a file, without the newline, returns false at the end of the file
+bool read_line(FILE* file, std::string& line) {
+  line.clear();
+  char buffer[2048];
+  while (fgets(buffer, sizeof(buffer), file)) {
+    line += buffer;
+    if (!line.empty() && line.back() == '\n') {
+      line.pop_back();
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      return true;
+    }
+  }
+  return !line.empty();
+}
+
+const char* message_type_name(MessageType type) {
+  switch (type) {
+    case MESSAGE_INFO:        return "info";
+    case MESSAGE_WARNING:     return "warning";
+    case MESSAGE_ERROR:       return "error";
+    case MESSAGE_FATAL_ERROR: return "fatal error";
+    default:                  return "message";
+  }
+}
+
+// ----------------------------------------------------------------------------- : ExportServer
+
+ExportServer::ExportServer()
+  : running(false)
+{
+  // write to and read from the current directory, like the cli
+  ei.directory_relative = ei.directory_absolute = wxGetCwd();
+  ei.export_template = make_intrusive<Package>();
+  ei.export_template->open(ei.directory_absolute, true);
+}
+
+void ExportServer::run() {
+  // Responses are written directly to stdout, not through cli, so they are UTF-8 and always one line.
+  // cli.init() made sure that messages are queued instead of written to stdout, they go in the responses.
+  running = true;
+  std::string line;
+  while (running && read_line(stdin, line)) {
+    if (line.find_first_not_of(" \t") == std::string::npos) continue;
+    std::string response = handleLine(line);
+    response += '\n';
+    fwrite(response.data(), 1, response.size(), stdout);
+    fflush(stdout);
+  }
+}
+
+std::string ExportServer::handleLine(const std::string& line) {
+  using namespace std::chrono;
+  boost::json::object response;
+  steady_clock::time_point start = steady_clock::now();
+  try {
+    boost::system::error_code ec;
+    boost::json::value request = boost::json::parse(line, ec);
+    if (ec) throw Error(_("Invalid JSON request: ") + String::FromUTF8(ec.message().c_str()));
+    if (!request.is_object()) throw Error(_("A request should be a JSON object"));
+    const boost::json::object& obj = request.get_object();
+    if (const boost::json::value* id = obj.if_contains("id")) response["id"] = *id;
+    response["result"] = handleCommand(obj);
+    response["ok"] = true;
+  } catch (const Error& e) {
+    response["ok"] = false;
+    response["error"] = to_json_string(e.what());
+  } catch (const std::exception& e) {
+    response["ok"] = false;
+    response["error"] = e.what();
+  }
+  response["seconds"] = duration<double>(steady_clock::now() - start).count();
+  // warnings and errors from scripts are not fatal, they are included in the response
+  boost::json::array messages;
+  MessageType type;
+  String msg;
+  while (get_queued_message(type, msg)) {
+    messages.push_back({{"type", message_type_name(type)}, {"message", to_json_string(msg)}});
+  }
+  response["messages"] = std::move(messages);
+  return boost::json::serialize(response);
+}
+
+boost::json::value ExportServer::handleCommand(const boost::json::object& request) {
+  String command = request_string(request, "command");
+  if (command == _("load")) {
+    SetP set = loadSet(request_string(request, "set"));
+    this->set = set;
+    return {{"set", to_json_string(set->absoluteFilename())}, {"cards", set->cards.size()}};
+  } else if (command == _("render")) {
+    SetP set = requestSet(request);
+    CardP card = request_card(request, set);
+    String out = request_string(request, "out");
+    export_image(set, card, out);
+    return to_json_string(out);
+  } else if (command == _("eval")) {
+    ScriptP script = parse(request_string(request, "script"));
+    WITH_DYNAMIC_ARG(export_info, &ei);
+    if (request.contains("set") || set) {
+      SetP set = requestSet(request);
+      ei.set = set;
+      CardP card = request_card(request, set, false);
+      Context& ctx = card ? set->getContext(card) : set->getContext();
+      LocalScope scope(ctx);
+      return to_json_string(ctx.eval(*script, false)->toCode());
+    } else {
+      if (!our_context) {
+        our_context = make_unique<Context>();
+        init_script_functions(*our_context);
+      }
+      LocalScope scope(*our_context);
+      return to_json_string(our_context->eval(*script, false)->toCode());
+    }
+  } else if (command == _("export")) {
+    SetP set = requestSet(request);
+    ExportTemplateP exp = ExportTemplate::byName(request_string(request, "template"));
+    String out = request_string(request, "out", false);
+    ScriptValueP result = export_set(set, set->cards, exp, out);
+    return to_json_string(out.empty() ? result->toString() : out);
+  } else if (command == _("unload")) {
+    if (request.contains("set")) {
+      wxFileName fn(request_string(request, "set"));
+      fn.MakeAbsolute();
+      auto it = sets.find(fn.GetFullPath());
+      if (it != sets.end()) {
+        if (set == it->second) set = SetP();
+        sets.erase(it);
+      }
+    } else {
+      sets.clear();
+      set = SetP();
+    }
+    ei.set = SetP();
+    return nullptr;
+  } else if (command == _("quit")) {
+    running = false;
+    return nullptr;
+  } else {
+    throw Error(_("Unknown command: ") + command);
+  }
+}
+
+SetP ExportServer::loadSet(const String& filename) {
+  wxFileName fn(filename);
+  fn.MakeAbsolute();
+  auto it = sets.find(fn.GetFullPath());
+  if (it != sets.end()) return it->second;
+  SetP set = import_set(fn.GetFullPath());
+  sets[fn.GetFullPath()] = set;
+  return set;
+}
+
+SetP ExportServer::requestSet(const boost::json::object& request) {
+  if (request.contains("set")) return loadSet(request_string(request, "set"));
+  if (!set) throw Error(_("No set loaded"));
+  return set;
+}
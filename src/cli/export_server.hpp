@@ -0,0 +1,52 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <data/export_template.hpp>
+#include <boost/json.hpp>
+
+// ----------------------------------------------------------------------------- : Export server
+
+/// Long running batch mode, reads requests as JSON lines from stdin and writes a JSON line response for each
+/** Loaded sets, and the games and stylesheets they use, stay in memory between requests.
+ *  Each request is an object with a "command" and an optional "id" that is copied to the response:
+ *    {"command":"load",   "set":FILE}
+ *    {"command":"render", "card":N, "out":FILE}
+ *    {"command":"eval",   "script":CODE, ["card":N]}
+ *    {"command":"export", "template":NAME, ["out":FILE]}
+ *    {"command":"unload", ["set":FILE]}
+ *    {"command":"quit"}
+ *  render, eval and export work on the last loaded set, or on the "set" given in the request.
+ *  The response is {"id":..., "ok":true, "result":..., "seconds":..., "messages":[...]},
+ *  or {"id":..., "ok":false, "error":MESSAGE, ...} when the request failed.
+ */
+class ExportServer {
+public:
+  ExportServer();
+  
+  /// Handle requests until stdin is closed or a quit command is received
+  void run();
+  
+  /// Handle a single request line, return the response line, both in UTF-8
+  std::string handleLine(const std::string& line);
+  
+private:
+  bool running;
+  map<String,SetP> sets;  ///< Loaded sets, by absolute filename
+  SetP set;               ///< Set used when a request doesn't name one
+  ExportInfo ei;          ///< Export info for eval requests, files are written relative to the cwd
+  unique_ptr<Context> our_context; ///< Context for eval requests when no set is loaded
+  
+  boost::json::value handleCommand(const boost::json::object& request);
+  /// Load a set, or find it if it was already loaded
+  SetP loadSet(const String& filename);
+  /// The set a request is about
+  SetP requestSet(const boost::json::object& request);
+};
@@ -55,7 +55,8 @@ void TextIOHandler::init() {
     have_console = false;
     have_stderr = false;
     // Use console mode if one of the cli flags is passed
-    static const Char* redirect_flags[] = {_("-?"),_("--help"),_("-v"),_("--version"),_("--cli"),_("-c"),_("--export"),_("--create-installer")};
+    static const Char* redirect_flags[] = {_("-?"),_("--help"),_("-v"),_("--version"),_("--cli"),_("-c"),_("--export"),_("--export-images"),_("--create-installer"),
+                                           _("--benchmark"),_("--benchmark-blend"),_("--benchmark-resample"),_("--serve")};
     for (int i = 1 ; i < wxTheApp->argc ; ++i) {
       for (size_t j = 0 ; j < sizeof(redirect_flags)/sizeof(redirect_flags[0]) ; ++j) {
         if (String(wxTheApp->argv[i]) == redirect_flags[j]) {
@@ -70,8 +71,15 @@ void TextIOHandler::init() {
   // write to standard output
   stream = stdout;
   raw_mode = false;
-  // always write to stderr if possible
-  if (have_console) {
+  // the export server writes only responses to stdout, messages are included in the responses
+  bool serving = false;
+  for (int i = 1 ; i < wxTheApp->argc ; ++i) {
+    if (String(wxTheApp->argv[i]) == _("--serve")) serving = true;
+  }
+  if (serving) {
+    show_message_box_for_fatal_errors = false;
+  } else if (have_console) {
+    // always write to stderr if possible
     write_errors_to_cli = true;
   }
 }
@@ -86,7 +94,7 @@ bool TextIOHandler::haveConsole() const {
 TextIOHandler& TextIOHandler::operator << (const Char* str) {
   if ((escapes && !raw_mode) || str[0] != 27) {
     if (have_console && !raw_mode) {
-      IF_UNICODE(fwprintf,fprintf)(stream,str);
+      IF_UNICODE(fputws,fputs)(str,stream);
     } else {
       buffer += str;
     }
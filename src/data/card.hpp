@@ -125,3 +125,7 @@ inline String type_name(const vector<CardP>&) {
 
 void mark_dependency_member(const Card& value, const String& name, const Dependency& dep);
 
+inline const IndexMap<FieldP, ValueP>* nameless_members(const Card& card) {
+  return &card.data;
+}
+
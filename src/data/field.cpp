@@ -34,10 +34,16 @@ Field::Field()
   , card_list_visible(false)
   , card_list_allow  (true)
   , card_list_align  (ALIGN_LEFT)
+  , name_id          (NO_NAME_ID)
 {}
 
 Field::~Field() {}
 
+void Field::setName(const String& name) {
+  this->name = name;
+  name_id = intern_name(name);
+}
+
 void Field::initDependencies(Context& ctx, const Dependency& dep) const {
   sort_script.initDependencies(ctx, dep);
 }
@@ -69,6 +75,7 @@ IMPLEMENT_REFLECTION(Field) {
 
 void Field::after_reading(Version ver) {
   name = canonical_name_form(name);
+  name_id = intern_name(name);
   if(caption.default_.empty()) caption.default_ = tr(package_relative_filename, name, name_to_caption);
   if(card_list_name.default_.empty()) card_list_name.default_ = tr(package_relative_filename, caption.default_, capitalize);
 }
@@ -119,7 +126,7 @@ Style::Style(const FieldP& field)
 
 Style::~Style()
 {
-  fieldP->styleP = nullptr;
+  if (fieldP->styleP == this) fieldP->styleP = nullptr; // not for copies
 }
 
 IMPLEMENT_REFLECTION(Style) {
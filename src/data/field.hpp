@@ -64,6 +64,20 @@ public:
   Dependencies    dependent_scripts;         ///< Scripts that depend on values of this field
   String          package_relative_filename;
   StyleP          styleP;                    ///< Style for this field, should have the right type! Can be null.
+  
+  /// The interned name, for looking up fields by name without comparing strings
+  /** The name is interned the first time the id is needed, and again after reading.
+   *  Use setName to rename a field that may already have been looked up. */
+  inline NameId nameId() const {
+    NameId id = name_id.load(memory_order_relaxed);
+    if (id == NO_NAME_ID) {
+      id = intern_name(name);
+      name_id.store(id, memory_order_relaxed);
+    }
+    return id;
+  }
+  /// Change the name of this field, and its interned name
+  void setName(const String& name);
 
   /// Creates a new Value corresponding to this Field
   virtual ValueP newValue() = 0;
@@ -76,6 +90,8 @@ public:
   virtual void initDependencies(Context& ctx, const Dependency& dep) const;
   
 private:
+  mutable atomic<NameId> name_id;            ///< Interned name, NO_NAME_ID until it is first needed
+  
   DECLARE_REFLECTION_VIRTUAL();
   virtual void after_reading(Version ver);
   friend void after_reading(Field& s, Version ver);
@@ -169,8 +185,15 @@ public:
 
 private:
   DECLARE_REFLECTION_VIRTUAL();
+  /// Listeners of a style, a copy of a style starts without any
+  class Listeners : public vector<StyleListener*> {
+  public:
+    Listeners() {}
+    Listeners(Listeners const&) {} // don't copy
+    void operator = (Listeners const&) {}
+  };
   /// Things that are listening to changes in this style
-  vector<StyleListener*> listeners;
+  Listeners listeners;
 };
 
 /// What changed in a style update?
@@ -186,6 +209,7 @@ enum StyleChange
 void init_object(const FieldP&, StyleP&);
 inline const FieldP& get_key     (const StyleP& s) { return s->fieldP; }
 inline const String& get_key_name(const StyleP& s) { return s->fieldP->name; }
+inline NameId        get_key_name_id(const StyleP& s) { return s->fieldP->nameId(); }
 template <> StyleP read_new<Style>(Reader&);
 
 inline String type_name(const Style&) {
@@ -256,6 +280,7 @@ private:
 void init_object(const FieldP&, ValueP&);
 inline const FieldP& get_key     (const ValueP& v) { return v->fieldP; }
 inline const String& get_key_name(const ValueP& v) { return v->fieldP->name; }
+inline NameId        get_key_name_id(const ValueP& v) { return v->fieldP->nameId(); }
 template <> ValueP read_new<Value>(Reader&);
 
 inline String type_name(const Value&) {
@@ -92,6 +92,9 @@ public:
   Direction direction;                        ///< In what direction is text layed out?
   // information from text rendering
   TextLayoutP layout;
+  /// Identifies this style in the text layout cache, unlike the address of the style it is never reused.
+  /** Copies made with clone() share it, they lay out text in the same way */
+  Age layout_id;
   
   int  update(Context&) override;
   void initDependencies(Context&, const Dependency&) const override;
@@ -100,7 +100,10 @@ Image export_image(const SetP& set, const vector<CardP>& cards, bool scale_to_lo
 
 /// Export the image of one or more cards to a given filename
 void export_image(const SetP& set, const CardP& card, const String& filename);
-void export_image(const SetP& set, const vector<CardP>& cards, const String& path, const String& filename_template, FilenameConflicts conflicts);
+/// Export the images of cards to files in a directory, returns the number of images written
+/** With jobs > 1, the images are encoded and written by that many threads, while the next cards are rendered.
+ */
+size_t export_image(const SetP& set, const vector<CardP>& cards, const String& path, const String& filename_template, FilenameConflicts conflicts, int jobs = 1);
 
 /// Export a set to Magic Workstation format
 void export_mws(Window* parent, const SetP& set);
@@ -17,7 +17,9 @@
 #include <data/settings.hpp>
 #include <gui/util.hpp>
 #include <render/card/viewer.hpp>
+#include <util/stage_timer.hpp>
 #include <wx/filename.h>
+#include <wx/thread.h>
 
 // ----------------------------------------------------------------------------- : Card export
 
@@ -27,6 +29,7 @@ public:
   UnzoomedDataViewer(double zoom, Radians angle);
   virtual ~UnzoomedDataViewer() {};
   Rotation getRotation() const override;
+  ResampleFilter resampleFilter() const override;
 private:
   double zoom;
   double angle;
@@ -61,6 +64,10 @@ Rotation UnzoomedDataViewer::getRotation() const {
   }
 }
 
+ResampleFilter UnzoomedDataViewer::resampleFilter() const {
+  return RESAMPLE_LANCZOS; // exported images are worth the extra time
+}
+
 // ----------------------------------------------------------------------------- : wxBitmap export
 
 Bitmap export_bitmap(const SetP& set, const CardP& card) {
@@ -179,20 +186,130 @@ Image export_image(const SetP& set, const vector<CardP>& cards, bool scale_to_lo
 
 void export_image(const SetP& set, const CardP& card, const String& filename) {
   Image img = export_image(set, card);
+  StageTimer timer(STAGE_IMAGE_ENCODE);
   img.SaveFile(filename); // can't use Bitmap::saveFile, it wants to know the file type
                           // but image.saveFile determines it automagicly
 }
 
-void export_image(const SetP& set, const vector<CardP>& cards,
-                   const String& path, const String& filename_template, FilenameConflicts conflicts)
+// ----------------------------------------------------------------------------- : Parallel image writing
+
+/// A pool of threads that encode and write card images to disk.
+/** Rendering has to happen on the main thread (script contexts and DCs are not thread safe),
+ *  but PNG encoding is about as expensive, so it is overlapped with the rendering of the next cards.
+ *  The images are encoded in exactly the same way as with a direct Image::SaveFile.
+ */
+class ImageWriterPool {
+public:
+  ImageWriterPool(int jobs);
+  /// Waits for all images to be written
+  ~ImageWriterPool();
+  
+  /// Add an image to be written, blocks while too many images are waiting
+  /** The pool takes ownership of the image, it must not share its data with any other Image. */
+  void write(unique_ptr<Image> img, const String& filename);
+  
+private:
+  class Worker;
+  wxMutex     mutex;
+  wxCondition not_empty;
+  wxCondition not_full;
+  deque<pair<unique_ptr<Image>,String>> queue; ///< Images waiting to be written
+  size_t          max_queue; ///< Maximum number of rendered images that are kept in memory
+  bool            closed;    ///< No more images will be added
+  vector<Worker*> workers;
+  
+  /// Get the next image to write, returns false if there are no more images
+  bool next(unique_ptr<Image>& img, String& filename);
+};
+
+class ImageWriterPool::Worker : public wxThread {
+public:
+  Worker(ImageWriterPool& pool) : wxThread(wxTHREAD_JOINABLE), pool(pool) {}
+  ExitCode Entry() override {
+    unique_ptr<Image> img;
+    String filename;
+    while (pool.next(img, filename)) {
+      StageTimer timer(STAGE_IMAGE_ENCODE);
+      img->SaveFile(filename);
+      img.reset();
+    }
+    return 0;
+  }
+private:
+  ImageWriterPool& pool;
+};
+
+ImageWriterPool::ImageWriterPool(int jobs)
+  : not_empty(mutex)
+  , not_full(mutex)
+  , max_queue(2 * jobs)
+  , closed(false)
+{
+  for (int i = 0 ; i < jobs ; ++i) {
+    Worker* worker = new Worker(*this);
+    if (worker->Run() != wxTHREAD_NO_ERROR) {
+      delete worker;
+      break;
+    }
+    workers.push_back(worker);
+  }
+}
+
+ImageWriterPool::~ImageWriterPool() {
+  {
+    wxMutexLocker lock(mutex);
+    closed = true;
+    not_empty.Broadcast();
+  }
+  FOR_EACH(worker, workers) {
+    worker->Wait();
+    delete worker;
+  }
+  // if no worker could be started, write the images ourselves
+  FOR_EACH(item, queue) {
+    StageTimer timer(STAGE_IMAGE_ENCODE);
+    item.first->SaveFile(item.second);
+  }
+}
+
+void ImageWriterPool::write(unique_ptr<Image> img, const String& filename) {
+  wxMutexLocker lock(mutex);
+  while (queue.size() >= max_queue && !workers.empty()) {
+    not_full.Wait();
+  }
+  queue.emplace_back(move(img), filename);
+  not_empty.Signal();
+}
+
+bool ImageWriterPool::next(unique_ptr<Image>& img, String& filename) {
+  wxMutexLocker lock(mutex);
+  while (queue.empty()) {
+    if (closed) return false;
+    not_empty.Wait();
+  }
+  img      = move(queue.front().first);
+  filename = queue.front().second;
+  queue.pop_front();
+  not_full.Signal();
+  return true;
+}
+
+// ----------------------------------------------------------------------------- : Multiple card export
+
+size_t export_image(const SetP& set, const vector<CardP>& cards,
+                    const String& path, const String& filename_template, FilenameConflicts conflicts, int jobs)
 {
   wxBusyCursor busy;
   // Script
   ScriptP filename_script = parse(filename_template, nullptr, true);
   // Path
   wxFileName fn(path);
+  // Writer threads
+  unique_ptr<ImageWriterPool> writers;
+  if (jobs > 1) writers = make_unique<ImageWriterPool>(jobs);
   // Export
-  std::set<String> used; // for CONFLICT_NUMBER_OVERWRITE
+  std::set<String> used; // for CONFLICT_NUMBER_OVERWRITE, and files that are not written yet
+  size_t count = 0;
   FOR_EACH_CONST(card, cards) {
     // filename for this card
     Context& ctx = set->getContext(card);
@@ -205,6 +322,15 @@ void export_image(const SetP& set, const vector<CardP>& cards,
     // write image
     filename = fn.GetFullPath();
     used.insert(filename);
-    export_image(set, card, filename);
+    if (writers) {
+      // note: the image data is copied before handing it to another thread,
+      //       so the (non-atomic) reference count of the image data is only touched by one thread at a time
+      unique_ptr<Image> img = make_unique<Image>(export_image(set, card).Copy());
+      writers->write(move(img), filename);
+    } else {
+      export_image(set, card, filename);
+    }
+    ++count;
   }
+  return count;
 }
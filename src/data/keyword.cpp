@@ -9,10 +9,7 @@
 #include <util/prec.hpp>
 #include <data/keyword.hpp>
 #include <util/tagged_string.hpp>
-#include <unordered_map>
-#include <unordered_set>
 
-class KeywordTrie;
 DECLARE_POINTER_TYPE(KeywordParamValue);
 class Value;
 DECLARE_DYNAMIC_ARG(Value*, value_being_updated);
@@ -208,103 +205,68 @@ void Keyword::prepare(const vector<KeywordParamP>& param_types, bool force) {
   valid = !match_re.matches(_(""));
 }
 
-// ----------------------------------------------------------------------------- : KeywordTrie
+// ----------------------------------------------------------------------------- : KeywordMatcher
 
-namespace std {
-  template <> struct hash<wxUniChar> {
-    inline size_t operator () (wxUniChar x) const {
-      return std::hash<wxUniChar::value_type>()(x.GetValue());
-    }
-  };
-}
-
-/// A node in a trie to match keywords
-/* The trie is used to speed up matching, by quickly finding candidate keywords.
-*/
-class KeywordTrie {
+/// An Aho-Corasick automaton to find the places where keywords can match
+/* Every keyword has a literal part that must appear in the text for the keyword to match:
+ * the text before its first parameter, or if that is empty, the text after it.
+ * The automaton finds the occurrences of the literals of all keywords in a single pass over the text,
+ * so the time taken doesn't depend on the number of keywords.
+ * When the literal is at the start of the keyword, a match can only start where the literal occurs.
+ */
+class KeywordMatcher {
 public:
-  KeywordTrie();
-  ~KeywordTrie();
+  KeywordMatcher();
+  
+  /// Add a keyword, compile() must be called before matching
+  void add(const Keyword& kw);
+  /// Determine the failure links of the automaton
+  void compile();
   
-  unordered_map<wxUniChar, unique_ptr<KeywordTrie>> children; ///< children after a given character
-  KeywordTrie* on_any_star; ///< children on /.*/ (owned or this)
-  vector<const Keyword*> finished; ///< keywords that end in this node
+  /// A keyword that can match in a string
+  struct Candidate {
+    Candidate(const Keyword* keyword, bool at_start) : keyword(keyword), at_start(at_start) {}
+    const Keyword* keyword;
+    bool           at_start; ///< Can matches only start at the positions in starts?
+    vector<size_t> starts;   ///< Positions where the literal of the keyword occurs
+  };
+  /// Find the keywords whose literal occurs in the untagged string
+  vector<Candidate> candidates(const String& untagged) const;
+  /// All keywords, without information on where they can match
+  vector<Candidate> all() const;
   
-  /// Insert nodes representing the given character
-  /** return the node where the evaluation will be after matching the character */
-  KeywordTrie* insert(wxUniChar match);
-  /// Insert nodes representing the given string
-  /** return the node where the evaluation will be after matching the string */
-  KeywordTrie* insert(const String& match);
-
-  /// Insert nodes representing the regex /.*/
-  /** return the node where the evaluation will be after matching that regex */
-  KeywordTrie* insertAnyStar();
+private:
+  struct Node {
+    Node() : fail(0), output(-1) {}
+    vector<pair<wxUniChar,int>> children; ///< Next node after a character, sorted by character
+    int         fail;   ///< Node of the longest proper suffix of this node that is in the trie
+    int         output; ///< First node along the failure links where a literal ends, or -1
+    vector<int> ends;   ///< Literals that end in this node
+  };
+  struct Literal {
+    const Keyword* keyword;
+    size_t         length;
+    bool           at_start; ///< Is the literal at the start of the keyword?
+  };
+  vector<Node>           nodes;   ///< The nodes of the trie, nodes[0] is the root
+  vector<Literal>        literals;
+  vector<const Keyword*> always;  ///< Keywords without a literal, they can always match
+  
+  /// The child of a node after a character, or -1
+  int child(int node, wxUniChar c) const;
+  /// The node after matching a character, following failure links
+  int step(int node, wxUniChar c) const;
 };
 
-
-KeywordTrie::KeywordTrie()
-  : on_any_star(nullptr)
-{}
-KeywordTrie::~KeywordTrie() {
-  if (on_any_star != this) delete on_any_star;
-}
-
-KeywordTrie* KeywordTrie::insert(wxUniChar c) {
-  #if USE_CASE_INSENSITIVE_KEYWORDS
-    c = toLower(c); // case insensitive matching
-  #endif
-  unique_ptr<KeywordTrie>& child = children[c];
-  if (!child) child.reset(new KeywordTrie);
-  return child.get();
-}
-KeywordTrie* KeywordTrie::insert(const String& match) {
-  KeywordTrie* cur = this;
-  for (wxUniChar c : match) {
-    cur = cur->insert(c);
-  }
-  return cur;
-}
-
-KeywordTrie* KeywordTrie::insertAnyStar() {
-  if (!on_any_star) on_any_star = new KeywordTrie();
-  on_any_star->on_any_star = on_any_star; // circular reference to itself
-  return on_any_star;
-}
-
-
-// ----------------------------------------------------------------------------- : KeywordDatabase
-
-IMPLEMENT_DYNAMIC_ARG(KeywordUsageStatistics*, keyword_usage_statistics, nullptr);
-
-KeywordDatabase::KeywordDatabase()
-  : root(nullptr)
+KeywordMatcher::KeywordMatcher()
+  : nodes(1)
 {}
-// Note: has to be here because in the header KeywordTrie is not defined
-KeywordDatabase::~KeywordDatabase() {}
 
-void KeywordDatabase::clear() {
-  root.reset();
-}
-
-void KeywordDatabase::add(const vector<KeywordP>& kws) {
-  FOR_EACH_CONST(kw, kws) {
-    add(*kw);
-  }
-}
-
-void KeywordDatabase::add(const Keyword& kw) {
-  if (kw.match.empty() || !kw.valid) return; // can't handle empty keywords
-  // Create root
-  if (!root) {
-    root = make_unique<KeywordTrie>();
-    root->on_any_star = root.get();
-  }
-  KeywordTrie* cur = root->insertAnyStar();
-  // Add to trie
+void KeywordMatcher::add(const Keyword& kw) {
+  // find the literal, the separators are eaten in the same way as in Keyword::prepare
   String text; // normal text
   size_t param = 0;
-  bool only_star = true;
+  bool at_start = true;
   for (size_t i = 0 ; i < kw.match.size() ;) {
     Char c = kw.match.GetChar(i);
     if (is_substr(kw.match, i, _("<atom-param"))) {
@@ -315,133 +277,163 @@ void KeywordDatabase::add(const Keyword& kw) {
         kw.parameters[param]->eat_separator_after(kw.match, i);
       }
       ++param;
-      // match anything
-      cur = cur->insert(text);
-      text.clear();
-      cur = cur->insertAnyStar();
-      // enough?
-      if (!only_star) {
-        // If we have matched anything specific, this is a good time to stop
-        // it doesn't really matter how long we go on, since the trie is only used
-        // as an optimization to not have to match lots of regexes.
-        // As an added bonus, we get a better behaviour of matching earlier keywords first.
-        break;
-      }
+      if (!text.empty()) break;
+      at_start = false;
     } else {
       text += c;
       i++;
-      only_star = false;
     }
   }
-  cur = cur->insert(text);
-  // now cur is the trie after matching the keyword anywhere in the input text
-  cur->finished.push_back(&kw);
+  if (text.empty()) {
+    always.push_back(&kw);
+    return;
+  }
+  // add to trie
+  int node = 0;
+  for (wxUniChar c : text) {
+    #if USE_CASE_INSENSITIVE_KEYWORDS
+      c = toLower(c); // case insensitive matching
+    #endif
+    int next = child(node, c);
+    if (next < 0) {
+      next = (int)nodes.size();
+      vector<pair<wxUniChar,int>>& children = nodes[node].children;
+      children.insert(lower_bound(children.begin(), children.end(), make_pair(c, 0)), make_pair(c, next));
+      nodes.emplace_back();
+    }
+    node = next;
+  }
+  nodes[node].ends.push_back((int)literals.size());
+  literals.push_back(Literal{&kw, text.size(), at_start});
+}
+
+void KeywordMatcher::compile() {
+  // breadth first, so the failure links of shorter prefixes are known
+  vector<int> queue(1, 0);
+  for (size_t i = 0 ; i < queue.size() ; ++i) {
+    int node = queue[i];
+    FOR_EACH_CONST(c, nodes[node].children) {
+      Node& next = nodes[c.second];
+      next.fail   = node == 0 ? 0 : step(nodes[node].fail, c.first);
+      next.output = nodes[next.fail].ends.empty() ? nodes[next.fail].output : next.fail;
+      queue.push_back(c.second);
+    }
+  }
 }
 
-void KeywordDatabase::prepare_parameters(const vector<KeywordParamP>& ps, const vector<KeywordP>& kws) {
-  FOR_EACH_CONST(kw, kws) {
-    kw->prepare(ps);
+int KeywordMatcher::child(int node, wxUniChar c) const {
+  const vector<pair<wxUniChar,int>>& children = nodes[node].children;
+  auto it = lower_bound(children.begin(), children.end(), make_pair(c, 0));
+  return it != children.end() && it->first == c ? it->second : -1;
+}
+
+int KeywordMatcher::step(int node, wxUniChar c) const {
+  while (true) {
+    int next = child(node, c);
+    if (next >= 0) return next;
+    if (node == 0) return 0;
+    node = nodes[node].fail;
   }
 }
 
-#ifdef _DEBUG
-void dump(int i, const KeywordTrie* t) {
-  FOR_EACH(c, t->children) {
-    wxLogDebug(String(i, _(' ')) + c.first + _("     ") + String::Format(_("%p"), c.second.get()));
-    dump(i + 2, c.second.get());
+vector<KeywordMatcher::Candidate> KeywordMatcher::candidates(const String& untagged) const {
+  vector<vector<size_t>> starts(literals.size());
+  int node = 0;
+  size_t pos = 0;
+  for (wxUniChar c : untagged) {
+    ++pos;
+    node = step(node, toLower(c)); // case insensitive matching
+    for (int n = node ; n >= 0 ; n = nodes[n].output) {
+      FOR_EACH_CONST(l, nodes[n].ends) {
+        starts[l].push_back(pos - literals[l].length);
+      }
+    }
   }
-  if (t->on_any_star) {
-    wxLogDebug(String(i, _(' ')) + _(".*") + _("     ") + String::Format(_("%p"), t->on_any_star));
-    if (t->on_any_star != t) dump(i + 2, t->on_any_star);
+  vector<Candidate> out;
+  for (size_t l = 0 ; l < literals.size() ; ++l) {
+    if (starts[l].empty()) continue;
+    out.emplace_back(literals[l].keyword, literals[l].at_start);
+    swap(out.back().starts, starts[l]);
   }
+  FOR_EACH_CONST(kw, always) out.emplace_back(kw, false);
+  return out;
 }
-#endif
 
-// ----------------------------------------------------------------------------- : KeywordDatabase : matching
+vector<KeywordMatcher::Candidate> KeywordMatcher::all() const {
+  vector<Candidate> out;
+  FOR_EACH_CONST(l, literals) out.emplace_back(l.keyword, false);
+  FOR_EACH_CONST(kw, always)  out.emplace_back(kw, false);
+  return out;
+}
 
-// transitive closure of a state, follow all on_any_star links
-void closure(vector<const KeywordTrie*>& state) {
-  for (size_t j = 0 ; j < state.size() ; ++j) {
-    if (state[j]->on_any_star && state[j]->on_any_star != state[j]) {
-      state.push_back(state[j]->on_any_star);
-    }
-  }
+// ----------------------------------------------------------------------------- : KeywordDatabase
+
+IMPLEMENT_DYNAMIC_ARG(KeywordUsageStatistics*, keyword_usage_statistics, nullptr);
+
+KeywordDatabase::KeywordDatabase()
+  : matcher(nullptr)
+{}
+// Note: has to be here because in the header KeywordMatcher is not defined
+KeywordDatabase::~KeywordDatabase() {}
+
+void KeywordDatabase::clear() {
+  matcher.reset();
 }
 
-void step_state(vector<const KeywordTrie*>& state, wxUniChar c) {
-  vector<const KeywordTrie*> next;
-  for(auto kt : state) {
-    auto it = kt->children.find(c);
-    if (it != kt->children.end()) {
-      next.push_back(it->second.get());
-    }
-    // TODO: on any star first or last?
-    if (kt->on_any_star) {
-      next.push_back(kt->on_any_star);
-    }
+void KeywordDatabase::add(const vector<KeywordP>& kws) {
+  FOR_EACH_CONST(kw, kws) {
+    insert(*kw);
   }
-  swap(state,next);
+  if (matcher) matcher->compile();
 }
 
-// Collect possible matching keywords
-/* First step in matching is to run over the string, and use the trie to find keywords that *potentially* appear in it.
- */
-unordered_set<Keyword const*> possible_matches(String const& tagged_str, KeywordTrie const* trie_root) {
-  unordered_set<const Keyword*> possible_matches;
-  if (!trie_root) return possible_matches;
-
-  vector<const KeywordTrie*> state;
-  state.push_back(trie_root);
-
-  for (String::const_iterator it = tagged_str.begin(); it != tagged_str.end();) {
-    wxUniChar c = *it;
-    // tag?
-    if (c == '<') {
-      it = skip_tag(it, tagged_str.end());
-    } else {
-      ++it;
-      c = toLower(c); // case insensitive matching
-      // find 'next' trie node set matching c
-      step_state(state, c);
-      closure(state);
-      // matches
-      for (auto kt : state) {
-        for (auto kw : kt->finished) {
-          possible_matches.insert(kw);
-        }
-      }
-    }
+void KeywordDatabase::add(const Keyword& kw) {
+  insert(kw);
+  if (matcher) matcher->compile();
+}
+
+void KeywordDatabase::insert(const Keyword& kw) {
+  if (kw.match.empty() || !kw.valid) return; // can't handle empty keywords
+  if (!matcher) matcher = make_unique<KeywordMatcher>();
+  matcher->add(kw);
+}
+
+void KeywordDatabase::prepare_parameters(const vector<KeywordParamP>& ps, const vector<KeywordP>& kws) {
+  FOR_EACH_CONST(kw, kws) {
+    kw->prepare(ps);
   }
-  return possible_matches;
 }
 
-struct KeywordMatch {
-  Keyword const* keyword;
-  // match in (substring of) the untagged string
-  Regex::Results match;
-  // position of match in the untagged string
-  size_t pos;
-  KeywordMatch(Keyword const& keyword, Regex::Results match, size_t pos) : keyword(&keyword), match(match), pos(pos) {}
-};
+// ----------------------------------------------------------------------------- : KeywordDatabase : matching
 
 // Collect exact matching keywords
-/* Second step in matching is to match regexes
+/* The regex is searched for from the start of the string, and then again after each match.
+ * If the literal is at the start of the keyword, the search can skip ahead to the next place where the literal occurs.
  */
-void keyword_matches(const String& untagged_str, const Keyword& keyword, vector<KeywordMatch>& out) {
+void keyword_matches(const String& untagged_str, const KeywordMatcher::Candidate& candidate, vector<KeywordMatch>& out) {
+  const Keyword& keyword = *candidate.keyword;
+  const String::const_iterator begin = untagged_str.begin(), end = untagged_str.end();
   Regex::Results match;
-  size_t i = 0;
-  String::const_iterator it = untagged_str.begin();
-  while (keyword.match_re.matches(match, it, untagged_str.end())) {
-    size_t pos = match[0].first - untagged_str.begin();
+  String::const_iterator it = begin;
+  vector<size_t>::const_iterator next = candidate.starts.begin();
+  while (true) {
+    bool found;
+    if (candidate.at_start) {
+      size_t pos = it - begin;
+      while (next != candidate.starts.end() && *next < pos) ++next;
+      if (next == candidate.starts.end()) break;
+      // when skipping ahead, the text before is still used to find word boundaries, as if searching from it
+      found = *next == pos ? keyword.match_re.matches(match, it, end)
+                           : keyword.match_re.matchesAfter(match, begin + *next, end);
+    } else {
+      found = keyword.match_re.matches(match, it, end);
+    }
+    if (!found) break;
+    size_t pos = match[0].first - begin;
     out.emplace_back(keyword, match, pos);
     it = max(it+1, match[0].end());
   }
 }
-void keyword_matches(const String& untagged_str, unordered_set<Keyword const*> keywords, vector<KeywordMatch>& out) {
-  for (auto keyword : keywords) {
-    keyword_matches(untagged_str, *keyword, out);
-  }
-}
 void sort_keyword_matches(vector<KeywordMatch>& matches) {
   sort(matches.begin(), matches.end(), [](KeywordMatch const& a, KeywordMatch const& b) {
     // sort matches by their start position
@@ -457,9 +449,14 @@ void sort_keyword_matches(vector<KeywordMatch>& matches) {
     return a.keyword->keyword < b.keyword->keyword;
   });
 }
-vector<KeywordMatch> keyword_matches(const String& untagged_str, unordered_set<Keyword const*> keywords) {
+
+vector<KeywordMatch> KeywordDatabase::matches(const String& untagged, bool reference) const {
   vector<KeywordMatch> out;
-  keyword_matches(untagged_str, keywords, out);
+  if (!matcher) return out;
+  vector<KeywordMatcher::Candidate> candidates = reference ? matcher->all() : matcher->candidates(untagged);
+  FOR_EACH_CONST(c, candidates) {
+    keyword_matches(untagged, c, out);
+  }
   sort_keyword_matches(out);
   return out;
 }
@@ -783,14 +780,10 @@ String KeywordDatabase::expand(const String& text, KeywordExpandOptions const& o
   String tagged = remove_keyword_tags(text);
 
   // any keywords in database?
-  if (!root) return tagged;
-
-  // Find potential matches
-  auto possible_matches = ::possible_matches(tagged, root.get());
+  if (!matcher) return tagged;
 
-  // Refine
-  String untagged = untag_no_escape(tagged);
-  auto matches = keyword_matches(untagged, possible_matches);
+  // Find matches
+  auto matches = this->matches(untag_no_escape(tagged));
   
   // Expand
   String result = expand_keywords(tagged, matches, options);
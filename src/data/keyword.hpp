@@ -18,7 +18,7 @@ DECLARE_POINTER_TYPE(KeywordParam);
 DECLARE_POINTER_TYPE(KeywordMode);
 DECLARE_POINTER_TYPE(Keyword);
 DECLARE_POINTER_TYPE(ParamReferenceType);
-class KeywordTrie;
+class KeywordMatcher;
 class Value;
 
 // ----------------------------------------------------------------------------- : Keyword parameters
@@ -143,6 +143,14 @@ struct KeywordExpandOptions {
   const Value* stat_key;
 };
 
+/// A match of a keyword in an untagged string
+struct KeywordMatch {
+  KeywordMatch(Keyword const& keyword, Regex::Results match, size_t pos) : keyword(&keyword), match(match), pos(pos) {}
+  Keyword const* keyword;
+  Regex::Results match; ///< match in (substring of) the untagged string
+  size_t         pos;   ///< position of match in the untagged string
+};
+
 /// A database of keywords to allow for fast matching
 /** NOTE: keywords may not be altered after they are added to the database,
  *  The database should be rebuild.
@@ -163,7 +171,7 @@ public:
   /// Clear the database
   void clear();
   /// Is the database empty?
-  inline bool empty() const { return !root; }
+  inline bool empty() const { return !matcher; }
   
   /// Expand/update all keywords in the given string.
   /** @param options.expand_default script function indicating whether reminder text should be shown by default
@@ -174,8 +182,16 @@ public:
    */
   String expand(const String& text, const KeywordExpandOptions&) const;
   
+  /// Find all keywords that match in an untagged string, in the order they should be expanded
+  /** If reference, then the regex of every keyword is searched for,
+   *  instead of only where the matcher found the keyword. This should give the same matches. */
+  vector<KeywordMatch> matches(const String& untagged, bool reference = false) const;
+  
 private:
-  unique_ptr<KeywordTrie> root; ///< Data structure for finding keywords
+  unique_ptr<KeywordMatcher> matcher; ///< Automaton for finding keywords
+  
+  /// Add a keyword to the matcher, without compiling it
+  void insert(const Keyword&);
   
   /// (try to) expand a single keyword
   /** If the keyword matches:
@@ -67,6 +67,9 @@ void Set::updateStyles(const CardP& card, bool only_content_dependent) {
 void Set::updateDelayed() {
   script_manager->updateDelayed();
 }
+int Set::updateAll(bool parallel, int max_jobs) {
+  return script_manager->updateAll(parallel, max_jobs);
+}
 
 Context& Set::getContextForThumbnails() {
   assert(!wxThread::IsMain());
@@ -90,6 +93,11 @@ Context& Set::getContextForThumbnails(const StyleSheetP& stylesheet) {
   return thumbnail_script_context->getContext(stylesheet);
 }
 
+unique_ptr<SetScriptContextFork> Set::forkContext(const vector<CardP>& cards) {
+  assert(wxThread::IsMain());
+  return make_unique<SetScriptContextFork>(*script_manager, cards);
+}
+
 const StyleSheet& Set::stylesheetFor(const CardP& card) {
   if (card && card->stylesheet) return *card->stylesheet;
   else                          return *stylesheet;
@@ -278,6 +286,11 @@ ScriptValueP make_iterator(const Set& set) {
 }
 
 void mark_dependency_member(const Set& set, const String& name, const Dependency& dep) {
+  // are we only checking whether a script looks at the set? (see StatsCache)
+  if (dep.type == DEP_DUMMY && dep.data == &set) {
+    const_cast<Dependency&>(dep).index = true;
+    return;
+  }
   // is it the card list?
   if (name == _("cards")) {
     set.game->dependent_scripts_cards.add(dep);
@@ -27,6 +27,7 @@ DECLARE_POINTER_TYPE(PackType);
 DECLARE_POINTER_TYPE(ScriptValue);
 class SetScriptManager;
 class SetScriptContext;
+class SetScriptContextFork;
 class Context;
 class Dependency;
 template <typename> class OrderCache;
@@ -71,6 +72,10 @@ public:
   void updateStyles(const CardP& card, bool only_content_dependent);
   /// Update scripts that were delayed
   void updateDelayed();
+  /// Update all set and card values, as is done after loading the set
+  /** If parallel, card values that don't depend on other cards are updated using at most max_jobs threads,
+   *  or one for each processor if max_jobs is 0. Returns the number of threads that were used. */
+  int updateAll(bool parallel = true, int max_jobs = 0);
   /// A context for performing scripts
   /** Should only be used from the thumbnail thread! */
   Context& getContextForThumbnails();
@@ -80,6 +85,9 @@ public:
   /// A context for performing scripts on a particular stylesheet
   /** Should only be used from the thumbnail thread! */
   Context& getContextForThumbnails(const StyleSheetP& stylesheet);
+  /// Copies of the script contexts, for evaluating scripts of the given cards from another thread
+  /** Should only be called from the main thread, the result can be used from one other thread. */
+  unique_ptr<SetScriptContextFork> forkContext(const vector<CardP>& cards);
   
   /// Stylesheet to use for a particular card
   /** card may be null */
@@ -151,8 +159,14 @@ inline int item_count(const Set& set) {
 }
 ScriptValueP make_iterator(const Set& set);
 
+/// Add a dependency on a member of the set
+/** If dep is DEP_DUMMY with the set as data, only set dep.index to true */
 void mark_dependency_member(const Set& set, const String& name, const Dependency& dep);
 
+inline const IndexMap<FieldP, ValueP>* nameless_members(const Set& set) {
+  return &set.data;
+}
+
 // ----------------------------------------------------------------------------- : SetView
 
 /// A 'view' of a Set, is notified when the Set is updated
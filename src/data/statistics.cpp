@@ -10,6 +10,11 @@
 #include <data/statistics.hpp>
 #include <data/field.hpp>
 #include <data/field/choice.hpp>
+#include <data/set.hpp>
+#include <data/card.hpp>
+#include <script/context.hpp>
+#include <util/tagged_string.hpp>
+#include <util/error.hpp>
 
 extern ScriptValueP script_primary_choice;
 
@@ -125,6 +130,96 @@ void StatsCategory::find_dimensions(const vector<StatsDimensionP>& available) {
   }
 }
 
+// ----------------------------------------------------------------------------- : Statistics values
+
+const vector<optional<String>>& StatsCache::values(Set& set, const StatsDimensionP& dim) {
+  auto inserted = columns.try_emplace(dim);
+  Column& column = inserted.first->second;
+  Context& global_ctx = set.getContext();
+  if (inserted.second) {
+    // a script that looks at the set can depend on other cards or on set fields,
+    // then the values can't be kept when only another card changes
+    Dependency test(DEP_DUMMY, false, &set);
+    try {
+      dim->script.initDependencies(global_ctx, test);
+    } catch (const Error&) {
+      test.index = true;
+    }
+    column.uses_set = test.index;
+  }
+  // the global value is the same for all cards, if it changes all values have to be updated
+  ScriptValueP global_ctx_value = global_ctx.getVariableOpt("global_value");
+  ScriptValueP global_value;
+  try {
+    global_value = dim->global_script.invoke(global_ctx);
+  } catch (ScriptError const& e) {
+    handle_error(ScriptError(e.what() + _("\n  in global script for statistics dimension '") + dim->name + _("'")));
+    global_value = script_nil;
+  }
+  if (!column.global_value || !equal(global_value, column.global_value)) {
+    column.cached.clear();
+    column.global_value = global_value;
+  }
+  // find values for cards that changed, and drop cards that are no longer in the set
+  unordered_map<const Card*, pair<CardP,String>> cached;
+  cached.reserve(set.cards.size());
+  column.values.resize(set.cards.size());
+  for (size_t i = 0 ; i < set.cards.size() ; ++i) {
+    const CardP& card = set.cards[i];
+    auto it = column.cached.find(card.get());
+    if (it != column.cached.end()) {
+      column.values[i] = it->second.second;
+      cached.insert(*it);
+      continue;
+    }
+    Context& ctx = set.getContext(card);
+    ctx.setVariable("global_value", global_value);
+    try {
+      String value = untag(dim->script.invoke(ctx)->toString());
+      column.values[i] = value;
+      cached.insert(make_pair(card.get(), make_pair(card, value)));
+    } catch (ScriptError const& e) {
+      handle_error(ScriptError(e.what() + _("\n  in script for statistics dimension '") + dim->name + _("'")));
+      column.values[i] = nullopt; // not cached, so the error is shown again next time
+    }
+  }
+  column.cached.swap(cached);
+  // restore old global value if any
+  if (global_ctx_value) global_ctx.setVariable("global_value", global_ctx_value);
+  return column.values;
+}
+
+void StatsCache::rows(Set& set, const vector<StatsDimensionP>& dims, vector<size_t>& card_indices, vector<vector<String>>& rows) {
+  vector<const vector<optional<String>>*> dim_values;
+  FOR_EACH_CONST(dim, dims) {
+    dim_values.push_back(&values(set, dim));
+  }
+  for (size_t i = 0 ; i < set.cards.size() ; ++i) {
+    vector<String> row;
+    row.reserve(dims.size());
+    for (size_t d = 0 ; d < dims.size() ; ++d) {
+      const optional<String>& value = (*dim_values[d])[i];
+      if (!value || (value->empty() && !dims[d]->show_empty)) break; // don't show this card
+      row.push_back(*value);
+    }
+    if (row.size() == dims.size()) {
+      card_indices.push_back(i);
+      rows.push_back(move(row));
+    }
+  }
+}
+
+void StatsCache::invalidate(const Card* card) {
+  FOR_EACH(c, columns) {
+    if (c.second.uses_set) c.second.cached.clear();
+    else                   c.second.cached.erase(card);
+  }
+}
+
+void StatsCache::clear() {
+  columns.clear();
+}
+
 // ----------------------------------------------------------------------------- : GraphType (from graph_type.hpp)
 
 IMPLEMENT_REFLECTION_ENUM(GraphType) {
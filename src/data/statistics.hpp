@@ -15,6 +15,8 @@
 #include <script/scriptable.hpp>
 
 class Field;
+class Set;
+DECLARE_POINTER_TYPE(Card);
 DECLARE_POINTER_TYPE(StatsDimension);
 DECLARE_POINTER_TYPE(StatsCategory);
 
@@ -70,3 +72,36 @@ public:
   DECLARE_REFLECTION();
 };
 
+// ----------------------------------------------------------------------------- : Statistics values
+
+/// The values of statistics dimensions for the cards in a set
+/** The values are cached, and only calculated again for cards that changed.
+ *  The owner should call invalidate() when a card changes, and clear() for other changes to the set.
+ */
+class StatsCache {
+public:
+  /// The values of a dimension, for each card in set.cards
+  /** Cards for which the script gave an error have no value, the error is reported */
+  const vector<optional<String>>& values(Set& set, const StatsDimensionP& dim);
+  
+  /// The values of the given dimensions, for each card that should be shown
+  /** Cards with an error or an empty value for a dimension that doesn't show empty values are skipped.
+   *  card_indices are the positions of the cards in set.cards
+   */
+  void rows(Set& set, const vector<StatsDimensionP>& dims, vector<size_t>& card_indices, vector<vector<String>>& rows);
+  
+  /// The values for a card are out of date
+  /** Values of dimensions that look at the set, and so possibly at other cards, are out of date for all cards */
+  void invalidate(const Card* card);
+  /// All values are out of date
+  void clear();
+  
+private:
+  struct Column {
+    ScriptValueP global_value;                               ///< Result of the global_script
+    bool uses_set = false;                                   ///< Does the script look at the set, not just at the card?
+    unordered_map<const Card*, pair<CardP,String>> cached;   ///< Known values, the card is kept so the pointer is not reused
+    vector<optional<String>> values;                         ///< Values for set.cards
+  };
+  map<StatsDimensionP, Column> columns;
+};
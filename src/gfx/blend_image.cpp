@@ -8,6 +8,7 @@
 
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/simd.hpp>
 #include <util/error.hpp>
 
 // ----------------------------------------------------------------------------- : Linear Blend
@@ -42,39 +43,96 @@ void linear_blend(Image& img1, const Image& img2, double x1,double y1, double x2
   int ym = to_int( (y2 - y1) * height * a );
   int d  = to_int( - (x1 * width * xm + y1 * height * ym) );
   
-  Byte *data1 = img1.GetData(), *data2 = img2.GetData();
-  // blend pixels
-  for (int y = 0 ; y < height ; ++y) {
-    for (int x = 0 ; x < width ; ++x) {
+  // blend a row of pixels with the given number of channels.
+  // Outside the gradient mult is constant, there the pixels are either kept (mult == 0) or copied (mult == fixed),
+  // only pixels on the gradient itself need to be blended.
+  auto blend_row = [=](Byte* data1, const Byte* data2, int channels, int y) {
+    auto mult_at = [=](int x) {
       int mult = x * xm + y * ym + d;
       if (mult < 0)      mult = 0;
       if (mult > fixed)  mult = fixed;
-      data1[0] = data1[0] + mult * (data2[0] - data1[0]) / fixed;
-      data1[1] = data1[1] + mult * (data2[1] - data1[1]) / fixed;
-      data1[2] = data1[2] + mult * (data2[2] - data1[2]) / fixed;
-      data1 += 3;
-      data2 += 3;
+      return mult;
+    };
+    int x = 0;
+    while (x < width) {
+      int mult = mult_at(x);
+      if (mult == 0 || mult == fixed) {
+        int end = x + 1;
+        while (end < width && mult_at(end) == mult) ++end;
+        if (mult == fixed) {
+          memcpy(data1 + x * channels, data2 + x * channels, (end - x) * channels);
+        }
+        x = end;
+      } else {
+        for (int c = x * channels ; c < (x + 1) * channels ; ++c) {
+          data1[c] = data1[c] + mult * (data2[c] - data1[c]) / fixed;
+        }
+        ++x;
+      }
     }
+  };
+  
+  // blend pixels
+  Byte *data1 = img1.GetData(), *data2 = img2.GetData();
+  for (int y = 0 ; y < height ; ++y) {
+    blend_row(data1 + y * width * 3, data2 + y * width * 3, 3, y);
   }
 
   // Blend Alpha for the two images.
   if (img1.HasAlpha() && img2.HasAlpha()) {
     Byte *alpha1 = img1.GetAlpha(), *alpha2 = img2.GetAlpha();
     for (int y = 0; y < height; ++y) {
-      for (int x = 0; x < width; ++x) {
-        int mult = x * xm + y * ym + d;
-        if (mult < 0)      mult = 0;
-        if (mult > fixed)  mult = fixed;
-        alpha1[0] = alpha1[0] + mult * (alpha2[0] - alpha1[0]) / fixed;
-        alpha1 += 1;
-        alpha2 += 1;
-      }
+      blend_row(alpha1 + y * width, alpha2 + y * width, 1, y);
     }
   }
 }
 
 // ----------------------------------------------------------------------------- : Mask Blend
 
+#if MSE_SIMD
+// Call f(start, n, m) for chunks of the bytes [0..size), where m[j] == mask[(start + j) * mask_stride].
+// For strided masks the values are first gathered into a buffer, so f can use vector loads.
+// f returns the number of bytes it handled, the rest has to be handled by the caller.
+template <typename F>
+size_t for_each_gathered(size_t size, const Byte* mask, size_t mask_stride, F f) {
+  if (mask_stride == 1) {
+    return f(0, size, mask);
+  }
+  const size_t chunk = 16 * Simd::BYTES;
+  Byte buffer[chunk];
+  size_t i = 0;
+  while (i + Simd::BYTES <= size) {
+    size_t n = min(chunk, (size - i) / Simd::BYTES * Simd::BYTES);
+    for (size_t j = 0 ; j < n ; ++j) buffer[j] = mask[(i + j) * mask_stride];
+    i += f(i, n, buffer);
+  }
+  return i;
+}
+#endif
+
+void mask_blend_bytes(Byte* a, const Byte* b, const Byte* mask, size_t size, size_t mask_stride, bool reference) {
+  size_t i = 0;
+  #if MSE_SIMD
+    if (!reference) {
+      i = for_each_gathered(size, mask, mask_stride, [a, b](size_t start, size_t n, const Byte* m) {
+        size_t j = 0;
+        for ( ; j + Simd::BYTES <= n ; j += Simd::BYTES) {
+          Simd::V result = Simd::per16(Simd::load(a + start + j), Simd::load(b + start + j), Simd::load(m + j),
+            [](Simd::V a, Simd::V b, Simd::V m) {
+              return div255<Simd>(Simd::add16(Simd::mul16(a, m), Simd::mul16(b, Simd::sub16(Simd::set16(255), m))));
+            });
+          Simd::store(a + start + j, result);
+        }
+        return j;
+      });
+    }
+  #endif
+  for ( ; i < size ; ++i) {
+    Byte m = mask[i * mask_stride];
+    a[i] = (a[i] * m + b[i] * (255 - m)) / 255;
+  }
+}
+
 void mask_blend(Image& img1, const Image& img2, const Image& mask) {
   int width = img1.GetWidth(), height = img1.GetHeight();
   if (img2.GetWidth() != width || img2.GetHeight() != height) {
@@ -84,36 +142,69 @@ void mask_blend(Image& img1, const Image& img2, const Image& mask) {
     throw Error(_("Mask used for blending in masked_blend function must have the same size as the images"));
   }
 
-  UInt size = width * height;
+  size_t size = (size_t)width * height;
   // these have the following structure:
   // [pixel1red, pixel1green, pixel1blue, pixel2red, pixel2green, pixel2blue, pixel3red, etc...]
   Byte *data1 = img1.GetData(), *data2 = img2.GetData(), *dataM = mask.GetData();
   // for each subpixel...
-  for (UInt i = 0; i < (size * 3); ++i) {
-    data1[i] = (data1[i] * dataM[i] + data2[i] * (255 - dataM[i])) / 255;
-  }
+  mask_blend_bytes(data1, data2, dataM, size * 3, 1);
 
   if (img1.HasAlpha() && img2.HasAlpha()) {
     // these have the following structure:
     // [pixel1alpha, pixel2alpha, pixel3alpha, etc...]
     Byte *alpha1 = img1.GetAlpha(), *alpha2 = img2.GetAlpha();
-    for (UInt i = 0; i < size; ++i) {
-      // use mask's red channel to blend alpha (all mask channels should be identical since it's grey scale)
-      alpha1[i] = (alpha1[i] * dataM[i * 3] + alpha2[i] * (255 - dataM[i * 3])) / 255;
-    }
+    // use mask's red channel to blend alpha (all mask channels should be identical since it's grey scale)
+    mask_blend_bytes(alpha1, alpha2, dataM, size, 3);
   }
 }
 
 // ----------------------------------------------------------------------------- : Alpha
 
+void multiply_alpha_bytes(Byte* a, const Byte* alpha, size_t size, size_t alpha_stride, bool reference) {
+  size_t i = 0;
+  #if MSE_SIMD
+    if (!reference) {
+      i = for_each_gathered(size, alpha, alpha_stride, [a](size_t start, size_t n, const Byte* al) {
+        size_t j = 0;
+        for ( ; j + Simd::BYTES <= n ; j += Simd::BYTES) {
+          Simd::V result = Simd::per16(Simd::load(a + start + j), Simd::load(al + j), [](Simd::V a, Simd::V al) {
+            return div255<Simd>(Simd::mul16(a, al));
+          });
+          Simd::store(a + start + j, result);
+        }
+        return j;
+      });
+    }
+  #endif
+  for ( ; i < size ; ++i) {
+    a[i] = (a[i] * alpha[i * alpha_stride]) / 255;
+  }
+}
+
+void multiply_alpha_bytes(Byte* a, Byte alpha, size_t size, bool reference) {
+  size_t i = 0;
+  #if MSE_SIMD
+    if (!reference) {
+      Simd::V al = Simd::set8(alpha);
+      for ( ; i + Simd::BYTES <= size ; i += Simd::BYTES) {
+        Simd::V result = Simd::per16(Simd::load(a + i), al, [](Simd::V a, Simd::V al) {
+          return div255<Simd>(Simd::mul16(a, al));
+        });
+        Simd::store(a + i, result);
+      }
+    }
+  #endif
+  for ( ; i < size ; ++i) {
+    a[i] = (a[i] * alpha) / 255;
+  }
+}
+
 void set_alpha(Image& img, const Image& img_alpha) {
   Image img_alpha_resampled = resample(img_alpha, img.GetWidth(), img.GetHeight());
   if (!img.HasAlpha()) img.InitAlpha();
   Byte *im = img.GetAlpha(), *al = img_alpha_resampled.GetData();
   size_t size = img.GetWidth() * img.GetHeight();
-  for (size_t i = 0 ; i < size ; ++i) {
-    im[i] = (im[i] * al[i*3]) / 255;
-  }
+  multiply_alpha_bytes(im, al, size, 3); // red channel
 }
 
 void set_alpha(Image& img, Byte* al, const wxSize& alpha_size) {
@@ -128,9 +219,7 @@ void set_alpha(Image& img, Byte* al, const wxSize& alpha_size) {
     // merge
     Byte *im = img.GetAlpha();
     size_t size = img.GetWidth() * img.GetHeight();
-    for (size_t i = 0 ; i < size ; ++i) {
-      im[i] = (im[i] * al[i]) / 255;
-    }
+    multiply_alpha_bytes(im, al, size, 1);
   }
 }
 
@@ -142,8 +231,6 @@ void set_alpha(Image& img, double alpha) {
   } else {
     Byte *im = img.GetAlpha();
     size_t size = img.GetWidth() * img.GetHeight();
-    for (size_t i = 0 ; i < size ; ++i) {
-      im[i] = (im[i] * b_alpha) / 255;
-    }
+    multiply_alpha_bytes(im, b_alpha, size);
   }
 }
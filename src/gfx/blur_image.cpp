@@ -0,0 +1,194 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/gfx.hpp>
+#include <gfx/simd.hpp>
+
+// ----------------------------------------------------------------------------- : Blurring columns
+
+// The blur works on images of ints, and only ever blurs the columns of an image.
+// Then the inner loops go over the pixels in a row, so they can be vectorized.
+// To blur horizontally the image is transposed first.
+//
+// The images have a margin of zeros around them, that is large enough to hold everything that is blurred
+// outside the image. So the result is the same as blurring an image that is zero outside its bounds.
+
+/// Number of box blurs used to approximate a gaussian blur
+const int BOX_BLUR_PASSES = 3;
+/// For smaller standard deviations box blurs are not a good approximation, so a gaussian kernel is used directly.
+/// Such a kernel has at most 13 elements.
+const double MIN_BOX_BLUR_SIGMA = 2.0;
+
+/// How to blur in one direction with a given standard deviation
+struct BlurPass {
+  BlurPass(double sigma);
+
+  int radius;           ///< Radius of the box or of the kernel
+  int passes;           ///< Number of times the box is applied, or 0 if the kernel is used instead
+  float edge;           ///< Weight of the pixels just outside the box, relative to the pixels inside
+  float scale;          ///< One over the total weight of the box
+  vector<float> kernel; ///< Gaussian kernel, if passes == 0
+
+  /// Size of the margin of zeros that is needed around the image
+  /** Each box blur spreads the image by radius+1, and only the rows at least radius+1 from the edge are blurred. */
+  inline int margin() const {
+    return passes ? passes * (radius + 1) : radius;
+  }
+};
+
+BlurPass::BlurPass(double sigma)
+  : radius(0), passes(0), edge(0), scale(1)
+{
+  if (sigma >= MIN_BOX_BLUR_SIGMA) {
+    // extended box blur, from "Theoretical foundations of Gaussian convolution by extended box filtering"
+    // the box has weight 1 inside the radius and weight alpha at radius+1, so its variance can be matched exactly
+    double variance = sigma * sigma / BOX_BLUR_PASSES;
+    int r = max(0, (int)floor(0.5 * sqrt(12 * variance + 1) - 0.5));
+    double alpha = (2*r + 1) * (r * (r + 1) - 3 * variance) / (6 * (variance - (r + 1) * (r + 1)));
+    radius = r;
+    passes = BOX_BLUR_PASSES;
+    edge   = (float)alpha;
+    scale  = (float)(1 / (2*r + 1 + 2 * alpha));
+  } else if (sigma > 0) {
+    radius = (int)ceil(3 * sigma);
+    double total = 0;
+    for (int d = -radius ; d <= radius ; ++d) {
+      kernel.push_back((float)exp(-d * d / (2 * sigma * sigma)));
+      total += kernel.back();
+    }
+    FOR_EACH(k, kernel) k = (float)(k / total);
+  } else {
+    kernel.push_back(1); // no blur
+  }
+}
+
+/// Blur the columns of in with a box of the given pass, store the results in out.
+/** Only the rows that have all the rows they use in the image are blurred, the others become 0. */
+void box_blur_columns(const int* in, int* out, int w, int h, const BlurPass& pass) {
+  const int r = pass.radius;
+  fill(out, out + (r + 1) * w, 0);
+  fill(out + (h - r - 1) * w, out + h * w, 0);
+  vector<int> sums(w, 0);
+  int* sum = sums.data();
+  for (int y = 0 ; y <= 2 * r ; ++y) {
+    const int* row = in + y * w;
+    for (int x = 0 ; x < w ; ++x) sum[x] += row[x];
+  }
+  for (int y = r + 1 ; y < h - r - 1 ; ++y) {
+    const int* before = in + (y - r - 1) * w; // just outside the box, and it leaves the box
+    const int* last   = in + (y + r)     * w; // enters the box
+    const int* after  = in + (y + r + 1) * w; // just outside the box
+    int* out_row = out + y * w;
+    int x = 0;
+    #if MSE_SIMD
+      Simd::F edge = Simd::setf(pass.edge), scale = Simd::setf(pass.scale), half = Simd::setf(0.5f);
+      for ( ; x + (int)Simd::INTS <= w ; x += Simd::INTS) {
+        Simd::V b = Simd::load32(before + x);
+        Simd::V s = Simd::add32(Simd::load32(sum + x), Simd::sub32(Simd::load32(last + x), b));
+        Simd::store32(sum + x, s);
+        Simd::F edges = Simd::mulf(Simd::to_float(Simd::add32(b, Simd::load32(after + x))), edge);
+        Simd::store32(out_row + x, Simd::to_int(Simd::addf(Simd::mulf(Simd::addf(Simd::to_float(s), edges), scale), half)));
+      }
+    #endif
+    for ( ; x < w ; ++x) {
+      sum[x] += last[x] - before[x];
+      out_row[x] = (int)((sum[x] + (before[x] + after[x]) * pass.edge) * pass.scale + 0.5f);
+    }
+  }
+}
+
+/// Blur the columns of in with the gaussian kernel of the given pass, store the results in out.
+/** Only the rows that have all the rows they use in the image are blurred, the others become 0. */
+void kernel_blur_columns(const int* in, int* out, int w, int h, const BlurPass& pass) {
+  const int r = pass.radius;
+  fill(out, out + r * w, 0);
+  fill(out + (h - r) * w, out + h * w, 0);
+  const int size = (int)pass.kernel.size();
+  const float* kernel = pass.kernel.data();
+  for (int y = r ; y < h - r ; ++y) {
+    const int* rows = in + (y - r) * w;
+    int* out_row = out + y * w;
+    int x = 0;
+    #if MSE_SIMD
+      for ( ; x + (int)Simd::INTS <= w ; x += Simd::INTS) {
+        Simd::F acc = Simd::setf(0.5f);
+        for (int k = 0 ; k < size ; ++k) {
+          acc = Simd::addf(acc, Simd::mulf(Simd::to_float(Simd::load32(rows + k * w + x)), Simd::setf(kernel[k])));
+        }
+        Simd::store32(out_row + x, Simd::to_int(acc));
+      }
+    #endif
+    for ( ; x < w ; ++x) {
+      float acc = 0.5f;
+      for (int k = 0 ; k < size ; ++k) {
+        acc += rows[k * w + x] * kernel[k];
+      }
+      out_row[x] = (int)acc;
+    }
+  }
+}
+
+/// Blur the columns of a w*h image in data, using buffer as scratch space.
+/** Returns data or buffer, whichever holds the result. */
+int* blur_columns(int* data, int* buffer, int w, int h, const BlurPass& pass) {
+  if (pass.passes == 0) {
+    kernel_blur_columns(data, buffer, w, h, pass);
+    return buffer;
+  }
+  for (int i = 0 ; i < pass.passes ; ++i) {
+    box_blur_columns(data, buffer, w, h, pass);
+    swap(data, buffer);
+  }
+  return data;
+}
+
+/// Transpose a w*h image in to the h*w image out, where the rows of out are stride apart.
+/** The values are multiplied by mult */
+template <typename T>
+void transpose(const T* in, int* out, int w, int h, int stride, int mult = 1) {
+  // work in blocks, so both images are read and written in cache friendly order
+  const int block = 32;
+  for (int y0 = 0 ; y0 < h ; y0 += block) {
+    for (int x0 = 0 ; x0 < w ; x0 += block) {
+      int y1 = min(h, y0 + block), x1 = min(w, x0 + block);
+      for (int x = x0 ; x < x1 ; ++x) {
+        for (int y = y0 ; y < y1 ; ++y) {
+          out[y + x * stride] = in[x + y * w] * mult;
+        }
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------- : Gaussian blur
+
+UInt gaussian_blur(const Byte* in, UInt* out, int w, int h, double sigma_x, double sigma_y) {
+  const int scale = 256; // fixed point, so rounding errors of the box blurs don't add up
+  BlurPass pass_x(sigma_x), pass_y(sigma_y);
+  int mx = pass_x.margin(), my = pass_y.margin();
+  int pw = w + 2 * mx, ph = h + 2 * my;
+  vector<int> buffer1((size_t)pw * ph, 0), buffer2((size_t)pw * ph, 0);
+  // blur horizontally, as columns of the transposed image (h wide, pw high)
+  transpose(in, buffer1.data() + mx * h, w, h, h, scale);
+  int* data = blur_columns(buffer1.data(), buffer2.data(), h, pw, pass_x);
+  // blur vertically (pw wide, ph high)
+  int* other = data == buffer1.data() ? buffer2.data() : buffer1.data();
+  fill(other, other + my * pw, 0);
+  fill(other + (my + h) * pw, other + ph * pw, 0);
+  transpose(data, other + my * pw, h, pw, pw);
+  data = blur_columns(other, data, pw, ph, pass_y);
+  // remove the margin
+  for (int y = 0 ; y < h ; ++y) {
+    const int* row = data + mx + (y + my) * pw;
+    for (int x = 0 ; x < w ; ++x) {
+      out[x + y * w] = (UInt)row[x];
+    }
+  }
+  return scale;
+}
@@ -8,6 +8,7 @@
 
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/simd.hpp>
 #include <util/reflect.hpp>
 #include <algorithm>
 
@@ -289,35 +290,132 @@ COMBINE_FUN(COMBINE_SMALLER_THAN_240, a < 240 ? b : a)
 COMBINE_FUN(COMBINE_SMALLER_THAN_245, a < 245 ? b : a)
 COMBINE_FUN(COMBINE_SMALLER_THAN_250, a < 250 ? b : a)
 
-// ----------------------------------------------------------------------------- : Combining
+// ----------------------------------------------------------------------------- : Vectorized combining functions
 
-/// Combine image b onto image a using some combining mode.
-/// The results are stored in the image A.
-template <ImageCombine combine>
-void combine_image_do(Image& a, Image b) {
-  UInt size = a.GetWidth() * a.GetHeight() * 3;
-  Byte* dataA = a.GetData(), * dataB = b.GetData();
-  // for each pixel: apply function
-  for (UInt i = 0; i < size; ++i) {
-    dataA[i] = Combine<combine>::f(dataA[i], dataB[i]);
+#if MSE_SIMD
+
+// Vectorized version of Combine<combine>::f, giving exactly the same results.
+// Works on S::BYTES bytes at the same time, using the instructions of S (see gfx/simd.hpp).
+// Modes that need a division don't have a vectorized version, they use a table instead.
+template <ImageCombine combine> struct CombineVector {
+  // The threshold modes are handled here, instead of specializing all 100 of them
+  static const bool greater   = combine >= COMBINE_GREATER_THAN_5 && combine <= COMBINE_GREATER_THAN_250;
+  static const bool smaller   = combine >= COMBINE_SMALLER_THAN_5 && combine <= COMBINE_SMALLER_THAN_250;
+  static const bool available = greater || smaller;
+  static const int  threshold = greater ? 5 * (combine - COMBINE_GREATER_THAN_5 + 1)
+                              : smaller ? 5 * (combine - COMBINE_SMALLER_THAN_5 + 1) : 0;
+  template <typename S> static inline typename S::V f(typename S::V a, typename S::V b) {
+    if (greater) return S::select(S::gt8(a, S::set8(threshold)), b, a);
+    else         return S::select(S::gt8(S::set8(threshold), a), b, a);
   }
+};
+
+// Give a vectorized combining function for enum value 'combine', working on bytes
+#define COMBINE_VECTOR(combine,fun) \
+  template <> struct CombineVector<combine> { \
+    static const bool available = true; \
+    template <typename S> static inline typename S::V f(typename S::V a, typename S::V b) { return fun; } \
+  };
+// Give a vectorized combining function for enum value 'combine', working on shorts, the results are clamped to [0..255]
+#define COMBINE_VECTOR16(combine,fun) \
+  COMBINE_VECTOR(combine, S::per16(a, b, [](typename S::V a, typename S::V b) { return fun; }))
+
+// overlay on shorts
+template <typename S> inline typename S::V overlay16(typename S::V a, typename S::V b) {
+  typename S::V c255 = S::set16(255);
+  return S::select(S::gt16(S::set16(128), a),
+                   S::template shr16<7>(S::mul16(a, b)),
+                   S::sub16(c255, S::template shr16<7>(S::mul16(S::sub16(c255, a), S::sub16(c255, b)))));
 }
 
-void combine_image(Image& a, const Image& b, ImageCombine combine) {
-  // Images must have same size
-  if (a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight()) {
-    throw Error(_ERROR_("images used for combine blending must have the same size"));
+COMBINE_VECTOR  (COMBINE_NORMAL,      b)
+COMBINE_VECTOR  (COMBINE_ADD,         S::adds8(a, b))
+COMBINE_VECTOR  (COMBINE_SUBTRACT,    S::subs8(a, b))
+COMBINE_VECTOR16(COMBINE_STAMP,       S::sub16(S::add16(a, S::set16(256)), S::add16(b, b)))
+COMBINE_VECTOR  (COMBINE_DIFFERENCE,  S::or_(S::subs8(a, b), S::subs8(b, a)))
+COMBINE_VECTOR16(COMBINE_NEGATION,    S::sub16(S::set16(255), S::max16(S::sub16(S::sub16(S::set16(255), a), b),
+                                                                   S::sub16(S::add16(a, b), S::set16(255)))))
+COMBINE_VECTOR16(COMBINE_MULTIPLY,    div255<S>(S::mul16(a, b)))
+COMBINE_VECTOR  (COMBINE_DARKEN,      S::min8(a, b))
+COMBINE_VECTOR  (COMBINE_LIGHTEN,     S::max8(a, b))
+COMBINE_VECTOR16(COMBINE_SCREEN,      S::sub16(S::set16(255), div255<S>(S::mul16(S::sub16(S::set16(255), a), S::sub16(S::set16(255), b)))))
+COMBINE_VECTOR16(COMBINE_OVERLAY,     overlay16<S>(a, b))
+COMBINE_VECTOR16(COMBINE_HARD_LIGHT,  S::select(S::gt16(S::set16(128), b),
+                                                S::template shr16<7>(S::mul16(a, b)),
+                                                S::sub16(S::set16(255), S::template shr16<7>(S::mul16(S::sub16(S::set16(255), a), S::sub16(S::set16(255), b))))))
+COMBINE_VECTOR  (COMBINE_SOFT_LIGHT,  b)
+COMBINE_VECTOR  (COMBINE_AND,         S::and_(a, b))
+COMBINE_VECTOR  (COMBINE_OR,          S::or_(a, b))
+COMBINE_VECTOR  (COMBINE_XOR,         S::xor_(a, b))
+COMBINE_VECTOR16(COMBINE_SYMMETRIC_OVERLAY, S::template shr16<1>(S::add16(overlay16<S>(a, b), overlay16<S>(b, a))))
+// ((255 - a) * a + a * b) / 255 == a + a * (b - a) / 255, rounded down, written so the products fit in 16 bits
+COMBINE_VECTOR16(COMBINE_BRIGHTNESS_TO_ALPHA, S::select(S::gt16(a, b),
+                                                S::sub16(a, div255<S>(S::add16(S::mul16(a, S::sub16(a, b)), S::set16(254)))),
+                                                S::add16(a, div255<S>(S::mul16(a, S::sub16(b, a))))))
+// (255 * a + (255 - a) * b) / 255 == a + (255 - a) * b / 255
+COMBINE_VECTOR16(COMBINE_DARKNESS_TO_ALPHA, S::add16(a, div255<S>(S::mul16(S::sub16(S::set16(255), a), b))))
+
+#else
+
+template <ImageCombine combine> struct CombineVector {
+  static const bool available = false;
+};
+
+#endif
+
+// ----------------------------------------------------------------------------- : Combining tables
+
+/// Table of the results of Combine<combine>::f, for modes without a vectorized version
+/** This avoids the divisions and branches for each byte */
+template <ImageCombine combine> struct CombineTable {
+  Byte results[256 * 256];
+  CombineTable() {
+    for (int a = 0 ; a < 256 ; ++a) {
+      for (int b = 0 ; b < 256 ; ++b) {
+        results[a << 8 | b] = Combine<combine>::f(a, b);
+      }
+    }
   }
-  // Copy alpha channel?
-  if (b.HasAlpha()) {
-    if (!a.HasAlpha()) a.InitAlpha();
-    memcpy(a.GetAlpha(), b.GetAlpha(), a.GetWidth() * a.GetHeight());
+  static const CombineTable& get() {
+    static const CombineTable table; // initialized on first use
+    return table;
   }
-  // Combine image data, by dispatching to combineImageDo
+};
+
+// ----------------------------------------------------------------------------- : Combining
+
+/// Combine the bytes b onto the bytes a using some combining mode.
+/// The results are stored in a.
+template <ImageCombine combine>
+void combine_bytes_do(Byte* a, const Byte* b, size_t size, bool reference) {
+  size_t i = 0;
+  if (!reference) {
+    #if MSE_SIMD
+      if constexpr (CombineVector<combine>::available) {
+        for ( ; i + Simd::BYTES <= size ; i += Simd::BYTES) {
+          Simd::store(a + i, CombineVector<combine>::template f<Simd>(Simd::load(a + i), Simd::load(b + i)));
+        }
+      }
+    #endif
+    if (!CombineVector<combine>::available) {
+      const Byte* results = CombineTable<combine>::get().results;
+      for ( ; i < size ; ++i) {
+        a[i] = results[a[i] << 8 | b[i]];
+      }
+    }
+  }
+  // for each remaining byte: apply function
+  for ( ; i < size ; ++i) {
+    a[i] = Combine<combine>::f(a[i], b[i]);
+  }
+}
+
+void combine_bytes(Byte* a, const Byte* b, size_t size, ImageCombine combine, bool reference) {
+  // dispatch to combine_bytes_do
   switch(combine) {
-    #define DISPATCH(comb) case comb: combine_image_do<comb>(a,b); return
+    #define DISPATCH(comb) case comb: combine_bytes_do<comb>(a, b, size, reference); return
     case COMBINE_DEFAULT:
-    case COMBINE_NORMAL: a = b; return; // no need to do a per pixel operation
+    DISPATCH(COMBINE_NORMAL);
     DISPATCH(COMBINE_ADD);
     DISPATCH(COMBINE_SUBTRACT);
     DISPATCH(COMBINE_STAMP);
@@ -443,7 +541,26 @@ void combine_image(Image& a, const Image& b, ImageCombine combine) {
     DISPATCH(COMBINE_SMALLER_THAN_240);
     DISPATCH(COMBINE_SMALLER_THAN_245);
     DISPATCH(COMBINE_SMALLER_THAN_250);
+    #undef DISPATCH
+  }
+}
+
+void combine_image(Image& a, const Image& b, ImageCombine combine) {
+  // Images must have same size
+  if (a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight()) {
+    throw Error(_ERROR_("images used for combine blending must have the same size"));
+  }
+  // Copy alpha channel?
+  if (b.HasAlpha()) {
+    if (!a.HasAlpha()) a.InitAlpha();
+    memcpy(a.GetAlpha(), b.GetAlpha(), a.GetWidth() * a.GetHeight());
+  }
+  if (combine <= COMBINE_NORMAL) {
+    a = b; // no need to do a per pixel operation
+    return;
   }
+  // Combine image data
+  combine_bytes(a.GetData(), b.GetData(), (size_t)a.GetWidth() * a.GetHeight() * 3, combine);
 }
 
 void draw_combine_image(DC& dc, UInt x, UInt y, const Image& img, ImageCombine combine) {
@@ -15,6 +15,7 @@
 #include <render/symbol/filter.hpp>
 #include <gui/util.hpp> // load_resource_image
 #include <wx/wfstream.h>
+#include <typeinfo>
 
 // ----------------------------------------------------------------------------- : GeneratedImage
 
@@ -25,7 +26,7 @@ GeneratedImageP GeneratedImage::toImage() const {
 }
 
 Image GeneratedImage::generateConform(const Options& options) const {
-  return conform_image(generate(options),options);
+  return conform_image(generateShared(options),options);
 }
 
 Image conform_image(const Image& img, const GeneratedImage::Options& options) {
@@ -35,18 +36,18 @@ Image conform_image(const Image& img, const GeneratedImage::Options& options) {
   if ((iw == options.width && ih == options.height) || (options.width == 0 && options.height == 0)) {
     // zoom?
     if (options.zoom != 1.0) {
-      image = resample(image, int(iw * options.zoom), int(ih * options.zoom));
+      image = resample(image, int(iw * options.zoom), int(ih * options.zoom), options.filter);
     } else {
       // already the right size
     }
   } else if (options.height == 0) {
     // width is given, determine height
     int h = options.width * ih / iw;
-    image = resample(image, options.width, h);
+    image = resample(image, options.width, h, options.filter);
   } else if (options.width == 0) {
     // height is given, determine width
     int w = options.height * iw / ih;
-    image = resample(image, w, options.height);
+    image = resample(image, w, options.height, options.filter);
   } else if (options.preserve_aspect == ASPECT_FIT) {
     // determine actual size of resulting image
     int w, h;
@@ -57,13 +58,13 @@ Image conform_image(const Image& img, const GeneratedImage::Options& options) {
       w = options.height * iw / ih;
       h = options.height;
     }
-    image = resample(image, w, h);
+    image = resample(image, w, h, options.filter);
   } else {
     if (options.preserve_aspect == ASPECT_BORDER && (options.width < options.height * 3) && (options.height < options.width * 3)) {
       // preserve the aspect ratio if there is not too much difference
-      image = resample_preserve_aspect(image, options.width, options.height);
+      image = resample_preserve_aspect(image, options.width, options.height, options.filter);
     } else {
-      image = resample(image, options.width, options.height);
+      image = resample(image, options.width, options.height, options.filter);
     }
   }
   // saturate?
@@ -79,6 +80,234 @@ Image conform_image(const Image& img, const GeneratedImage::Options& options) {
   return image;
 }
 
+// ----------------------------------------------------------------------------- : Hashing
+
+/// Combine a hash with the hash of the next value
+inline void hash_combine(size_t& seed, size_t h) {
+  seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+inline size_t hash_member(int x)                    { return std::hash<int>()(x); }
+inline size_t hash_member(size_t x)                 { return std::hash<size_t>()(x); }
+inline size_t hash_member(double x)                 { return std::hash<double>()(x); }
+inline size_t hash_member(Color x)                  { return std::hash<uint32_t>()(x.packed); }
+inline size_t hash_member(Age x)                    { return std::hash<Age::age_t>()(x.get()); }
+inline size_t hash_member(const String& x)          { return std::hash<String>()(x); }
+inline size_t hash_member(const LocalFileName& x)   { return std::hash<String>()(x.toStringForKey()); }
+inline size_t hash_member(const GeneratedImageP& x) { return x->hash(); }
+
+/// Hash of an image of type T with the given members
+template <typename T, typename... Members>
+size_t hash_image(const Members&... members) {
+  size_t seed = typeid(T).hash_code();
+  (hash_combine(seed, hash_member(members)), ...);
+  return seed;
+}
+
+// ----------------------------------------------------------------------------- : Sharing generated images
+
+CacheCounter generated_image_cache_counter;
+
+/// Total size of the images that are shared, in bytes
+const size_t GENERATED_IMAGE_CACHE_BYTES = 128 * 1024 * 1024;
+
+/// Size of the data of an image in bytes
+size_t image_bytes(const Image& img) {
+  return (size_t)img.GetWidth() * img.GetHeight() * (img.HasAlpha() ? 4 : 3);
+}
+
+bool same_options(const GeneratedImage::Options& a, const GeneratedImage::Options& b) {
+  return a.width == b.width && a.height == b.height && a.zoom == b.zoom && a.angle == b.angle
+      && a.preserve_aspect == b.preserve_aspect && a.saturate == b.saturate && a.filter == b.filter
+      && a.package == b.package && a.local_package == b.local_package;
+}
+
+/// The images generated by GeneratedImage::generateShared, found by the structure of the image and the options
+/** The least recently used images are removed when the images take more than max_bytes.
+ *  The cache is shared between threads, all access is locked.
+ */
+class GeneratedImageCache {
+public:
+  GeneratedImageCache(size_t max_bytes) : max_bytes(max_bytes), bytes(0) {}
+  
+  /// Find the image generated by an image equal to the given one with the same options
+  shared_ptr<const Image> find(const GeneratedImage& image, size_t hash, const GeneratedImage::Options& opt) {
+    wxMutexLocker lock(mutex);
+    auto it = findEntry(image, hash, opt);
+    if (it == items.end()) {
+      generated_image_cache_counter.misses++;
+      return nullptr;
+    }
+    generated_image_cache_counter.hits++;
+    items.splice(items.begin(), items, it); // most recently used
+    return it->result;
+  }
+  /// Add a generated image, removes the least recently used images if there are too many
+  void store(const GeneratedImage& image, size_t hash, const GeneratedImage::Options& opt, const shared_ptr<const Image>& result) {
+    size_t size = image_bytes(*result);
+    if (size > max_bytes / 4) return; // this image would push out too many others
+    wxMutexLocker lock(mutex);
+    if (findEntry(image, hash, opt) != items.end()) return; // generated by another thread in the meantime
+    items.push_front(Entry{hash, image.toImage(), opt, result, size});
+    index.emplace(hash, items.begin());
+    bytes += size;
+    while (bytes > max_bytes) {
+      auto last = prev(items.end());
+      removeIndex(last);
+      items.pop_back();
+    }
+  }
+  /// Remove the images generated with a package, the options only refer to it by address
+  void forget(const Package* package) {
+    Items removed; // destroyed after unlocking
+    wxMutexLocker lock(mutex);
+    for (auto it = items.begin() ; it != items.end() ; ) {
+      auto next = std::next(it);
+      if (it->options.package == package || it->options.local_package == package) {
+        removeIndex(it);
+        removed.splice(removed.end(), items, it);
+      }
+      it = next;
+    }
+  }
+  void clear() {
+    wxMutexLocker lock(mutex);
+    index.clear();
+    items.clear();
+    bytes = 0;
+  }
+  
+private:
+  struct Entry {
+    size_t                  hash;
+    GeneratedImageP         image;   ///< The image that was generated, to compare with operator ==
+    GeneratedImage::Options options;
+    shared_ptr<const Image> result;  ///< Never modified, users get a copy
+    size_t                  bytes;
+  };
+  typedef list<Entry> Items;
+  size_t  max_bytes, bytes;
+  wxMutex mutex;
+  Items   items; ///< Most recently used first
+  unordered_multimap<size_t, Items::iterator> index;
+  
+  /// Remove an item from the index, and stop counting its size
+  void removeIndex(Items::iterator item) {
+    auto range = index.equal_range(item->hash);
+    for (auto it = range.first ; it != range.second ; ++it) {
+      if (it->second == item) {
+        index.erase(it);
+        break;
+      }
+    }
+    bytes -= item->bytes;
+  }
+  Items::iterator findEntry(const GeneratedImage& image, size_t hash, const GeneratedImage::Options& opt) {
+    auto range = index.equal_range(hash);
+    for (auto it = range.first ; it != range.second ; ++it) {
+      const Entry& e = *it->second;
+      if (same_options(e.options, opt) && *e.image == image) return it->second;
+    }
+    return items.end();
+  }
+};
+
+GeneratedImageCache generated_image_cache(GENERATED_IMAGE_CACHE_BYTES);
+
+void clear_generated_image_cache() {
+  generated_image_cache.clear();
+}
+
+void forget_generated_images(const Package* package) {
+  generated_image_cache.forget(package);
+}
+
+Image GeneratedImage::generateShared(const Options& opt) const {
+  if (!cacheable()) return generate(opt);
+  size_t h = hash();
+  // note: the data of a wxImage is not copied on write, and its reference count is not atomic,
+  //       so every user gets their own copy of the shared image
+  if (shared_ptr<const Image> shared = generated_image_cache.find(*this, h, opt)) {
+    return shared->Copy();
+  }
+  Image img = generate(opt);
+  if (img.Ok()) {
+    generated_image_cache.store(*this, h, opt, make_shared<const Image>(img.Copy()));
+  }
+  return img;
+}
+
+/// An image of a single color whose hash is always the same, to check that colliding images are told apart
+class CollidingImage : public GeneratedImage {
+public:
+  CollidingImage(Color color) : color(color) {}
+  Image generate(const Options& opt) const override {
+    Image img(max(1, opt.width), max(1, opt.height));
+    img.SetRGB(wxRect(0, 0, img.GetWidth(), img.GetHeight()), color.r, color.g, color.b);
+    return img;
+  }
+  bool operator == (const GeneratedImage& that) const override {
+    const CollidingImage* that2 = dynamic_cast<const CollidingImage*>(&that);
+    return that2 && color == that2->color;
+  }
+  size_t hash() const override { return 0; }
+private:
+  Color color;
+};
+
+bool same_pixels(const Image& a, const Image& b) {
+  if (a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight() || a.HasAlpha() != b.HasAlpha()) return false;
+  size_t n = (size_t)a.GetWidth() * a.GetHeight();
+  return memcmp(a.GetData(), b.GetData(), 3 * n) == 0
+      && (!a.HasAlpha() || memcmp(a.GetAlpha(), b.GetAlpha(), n) == 0);
+}
+
+int check_generated_image_sharing() {
+  clear_generated_image_cache();
+  Image red(8, 8), blue(8, 8);
+  red .SetRGB(wxRect(0, 0, 8, 8), 255, 0, 0);
+  blue.SetRGB(wxRect(0, 0, 8, 8), 0, 0, 255);
+  GeneratedImageP a = make_intrusive<ArbitraryImage>(red);
+  GeneratedImageP b = make_intrusive<ArbitraryImage>(blue);
+  // graphs that are all different, some only in a number or in the order of their inputs
+  auto make_graphs = [&]() -> vector<GeneratedImageP> {
+    return {
+      make_intrusive<SetAlphaImage>(a, 0.5),
+      make_intrusive<SetAlphaImage>(a, 0.25),
+      make_intrusive<SetAlphaImage>(b, 0.5),
+      make_intrusive<InvertImage>(a),
+      make_intrusive<InvertImage>(b),
+      make_intrusive<LinearBlendImage>(a, b, 0, 0, 1, 1),
+      make_intrusive<LinearBlendImage>(b, a, 0, 0, 1, 1),
+      make_intrusive<LinearBlendImage>(a, b, 0, 0, 1, 0),
+      make_intrusive<CombineBlendImage>(a, b, COMBINE_ADD),
+      make_intrusive<CombineBlendImage>(a, b, COMBINE_MULTIPLY),
+      make_intrusive<CollidingImage>(Color(255, 0, 0)),
+      make_intrusive<CollidingImage>(Color(0, 255, 0)),
+    };
+  };
+  int mismatches = 0;
+  vector<GeneratedImageP> graphs = make_graphs();
+  for (size_t i = 0 ; i < graphs.size() ; ++i) {
+    for (size_t j = i + 1 ; j < graphs.size() ; ++j) {
+      if (*graphs[i] == *graphs[j]) ++mismatches;
+    }
+  }
+  // the first time the images are generated, the second time equal graphs must share them,
+  // both times every image must be what generating it directly gives
+  GeneratedImage::Options opt(8, 8);
+  long hits = generated_image_cache_counter.hits;
+  for (int pass = 0 ; pass < 2 ; ++pass) {
+    if (pass == 1) graphs = make_graphs();
+    FOR_EACH(g, graphs) {
+      if (!same_pixels(g->generateShared(opt), g->generate(opt))) ++mismatches;
+    }
+  }
+  if (generated_image_cache_counter.hits - hits != (long)graphs.size()) ++mismatches;
+  clear_generated_image_cache();
+  return mismatches;
+}
+
 // ----------------------------------------------------------------------------- : BlankImage
 
 Image BlankImage::generate(const Options& opt) const {
@@ -94,12 +323,15 @@ bool BlankImage::operator == (const GeneratedImage& that) const {
   const BlankImage* that2 = dynamic_cast<const BlankImage*>(&that);
   return that2;
 }
+size_t BlankImage::hash() const {
+  return hash_image<BlankImage>();
+}
 
 // ----------------------------------------------------------------------------- : LinearBlendImage
 
 Image LinearBlendImage::generate(const Options& opt) const {
-  Image img = image1->generate(opt);
-  linear_blend(img, image2->generate(opt), x1, y1, x2, y2);
+  Image img = image1->generateShared(opt);
+  linear_blend(img, image2->generateShared(opt), x1, y1, x2, y2);
   return img;
 }
 ImageCombine LinearBlendImage::combine() const {
@@ -112,12 +344,15 @@ bool LinearBlendImage::operator == (const GeneratedImage& that) const {
                && x1 == that2->x1 && y1 == that2->y1
                && x2 == that2->x2 && y2 == that2->y2;
 }
+size_t LinearBlendImage::hash() const {
+  return hash_image<LinearBlendImage>(image1, image2, x1, y1, x2, y2);
+}
 
 // ----------------------------------------------------------------------------- : MaskedBlendImage
 
 Image MaskedBlendImage::generate(const Options& opt) const {
-  Image img = light->generate(opt);
-  mask_blend(img, dark->generate(opt), mask->generate(opt));
+  Image img = light->generateShared(opt);
+  mask_blend(img, dark->generateShared(opt), mask->generateShared(opt));
   return img;
 }
 ImageCombine MaskedBlendImage::combine() const {
@@ -129,12 +364,15 @@ bool MaskedBlendImage::operator == (const GeneratedImage& that) const {
                && *dark  == *that2->dark
                && *mask  == *that2->mask;
 }
+size_t MaskedBlendImage::hash() const {
+  return hash_image<MaskedBlendImage>(light, dark, mask);
+}
 
 // ----------------------------------------------------------------------------- : CombineBlendImage
 
 Image CombineBlendImage::generate(const Options& opt) const {
-  Image img = image1->generate(opt);
-  combine_image(img, image2->generate(opt), image_combine);
+  Image img = image1->generateShared(opt);
+  combine_image(img, image2->generateShared(opt), image_combine);
   return img;
 }
 ImageCombine CombineBlendImage::combine() const {
@@ -146,12 +384,15 @@ bool CombineBlendImage::operator == (const GeneratedImage& that) const {
                && *image2 == *that2->image2
                && image_combine == that2->image_combine;
 }
+size_t CombineBlendImage::hash() const {
+  return hash_image<CombineBlendImage>(image1, image2, image_combine);
+}
 
 // ----------------------------------------------------------------------------- : SetMaskImage
 
 Image SetMaskImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
-  set_alpha(img, mask->generate(opt));
+  Image img = image->generateShared(opt);
+  set_alpha(img, mask->generateShared(opt));
   return img;
 }
 bool SetMaskImage::operator == (const GeneratedImage& that) const {
@@ -159,9 +400,12 @@ bool SetMaskImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && *mask  == *that2->mask;
 }
+size_t SetMaskImage::hash() const {
+  return hash_image<SetMaskImage>(image, mask);
+}
 
 Image SetAlphaImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
+  Image img = image->generateShared(opt);
   set_alpha(img, alpha);
   return img;
 }
@@ -170,11 +414,14 @@ bool SetAlphaImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && alpha  == that2->alpha;
 }
+size_t SetAlphaImage::hash() const {
+  return hash_image<SetAlphaImage>(image, alpha);
+}
 
 // ----------------------------------------------------------------------------- : SetCombineImage
 
 Image SetCombineImage::generate(const Options& opt) const {
-  return image->generate(opt);
+  return image->generateShared(opt);
 }
 ImageCombine SetCombineImage::combine() const {
   return image_combine;
@@ -184,11 +431,14 @@ bool SetCombineImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && image_combine == that2->image_combine;
 }
+size_t SetCombineImage::hash() const {
+  return hash_image<SetCombineImage>(image, image_combine);
+}
 
 // ----------------------------------------------------------------------------- : SaturateImage
 
 Image SaturateImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
+  Image img = image->generateShared(opt);
   saturate(img, amount);
   return img;
 }
@@ -197,11 +447,14 @@ bool SaturateImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && amount == that2->amount;
 }
+size_t SaturateImage::hash() const {
+  return hash_image<SaturateImage>(image, amount);
+}
 
 // ----------------------------------------------------------------------------- : InvertImage
 
 Image InvertImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
+  Image img = image->generateShared(opt);
   invert(img);
   return img;
 }
@@ -209,11 +462,14 @@ bool InvertImage::operator == (const GeneratedImage& that) const {
   const InvertImage* that2 = dynamic_cast<const InvertImage*>(&that);
   return that2 && *image == *that2->image;
 }
+size_t InvertImage::hash() const {
+  return hash_image<InvertImage>(image);
+}
 
 // ----------------------------------------------------------------------------- : RecolorImage
 
 Image RecolorImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
+  Image img = image->generateShared(opt);
   recolor(img, color);
   return img;
 }
@@ -222,9 +478,12 @@ bool RecolorImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && color == that2->color;
 }
+size_t RecolorImage::hash() const {
+  return hash_image<RecolorImage>(image, color);
+}
 
 Image RecolorImage2::generate(const Options& opt) const {
-  Image img = image->generate(opt);
+  Image img = image->generateShared(opt);
   recolor(img, red,green,blue,white);
   return img;
 }
@@ -236,29 +495,38 @@ bool RecolorImage2::operator == (const GeneratedImage& that) const {
                && blue == that2->blue
                && white == that2->white;
 }
+size_t RecolorImage2::hash() const {
+  return hash_image<RecolorImage2>(image, red, green, blue, white);
+}
 
 // ----------------------------------------------------------------------------- : FlipImage
 
 Image FlipImageHorizontal::generate(const Options& opt) const {
-  Image img = image->generate(opt);
+  Image img = image->generateShared(opt);
   return flip_image_horizontal(img);
 }
 bool FlipImageHorizontal::operator == (const GeneratedImage& that) const {
   const FlipImageHorizontal* that2 = dynamic_cast<const FlipImageHorizontal*>(&that);
   return that2 && *image == *that2->image;
 }
+size_t FlipImageHorizontal::hash() const {
+  return hash_image<FlipImageHorizontal>(image);
+}
 
 Image FlipImageVertical::generate(const Options& opt) const {
-  Image img = image->generate(opt);
+  Image img = image->generateShared(opt);
   return flip_image_vertical(img);
 }
 bool FlipImageVertical::operator == (const GeneratedImage& that) const {
   const FlipImageVertical* that2 = dynamic_cast<const FlipImageVertical*>(&that);
   return that2 && *image == *that2->image;
 }
+size_t FlipImageVertical::hash() const {
+  return hash_image<FlipImageVertical>(image);
+}
 
 Image RotateImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
+  Image img = image->generateShared(opt);
   return rotate_image(img,angle);
 }
 bool RotateImage::operator == (const GeneratedImage& that) const {
@@ -266,6 +534,9 @@ bool RotateImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && angle == that2->angle;
 }
+size_t RotateImage::hash() const {
+  return hash_image<RotateImage>(image, angle);
+}
 
 // ----------------------------------------------------------------------------- : EnlargeImage
 
@@ -277,7 +548,7 @@ Image EnlargeImage::generate(const Options& opt) const {
     , opt.package
     , opt.local_package
     , opt.preserve_aspect);
-  Image img = image->generate(sub_opt);
+  Image img = image->generateShared(sub_opt);
   // size of generated image
   int w  = img.GetWidth(),  h = img.GetHeight();  // original image size
   int dw = int(w * border_size), dh = int(h * border_size); // delta
@@ -304,11 +575,14 @@ bool EnlargeImage::operator == (const GeneratedImage& that) const {
   return that2 && *image      == *that2->image
                && border_size == that2->border_size;
 }
+size_t EnlargeImage::hash() const {
+  return hash_image<EnlargeImage>(image, border_size);
+}
 
 // ----------------------------------------------------------------------------- : ResizeImage
 
 Image ResizeImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
+  Image img = image->generateShared(opt);
   return resample(img, width, height);
 }
 bool ResizeImage::operator == (const GeneratedImage& that) const {
@@ -317,12 +591,15 @@ bool ResizeImage::operator == (const GeneratedImage& that) const {
     && width == that2->width
     && height == that2->height;
 }
+size_t ResizeImage::hash() const {
+  return hash_image<ResizeImage>(image, width, height);
+}
 
 // ----------------------------------------------------------------------------- : BleedEdgedImage
 
 Image BleedEdgedImage::generate(const Options& opt) const {
   // create enlarged image
-  Image base_img = base_image->generate(opt);
+  Image base_img = base_image->generateShared(opt);
   int w = base_img.GetWidth(), h = base_img.GetHeight();
   if (w <= 0 || h <= 0) {
     queue_message(MESSAGE_ERROR, _("Cannot add bleed edge to empty image"));
@@ -464,12 +741,15 @@ bool BleedEdgedImage::operator == (const GeneratedImage& that) const {
     && vertical_size == that2->vertical_size
     && background_color == that2->background_color;
 }
+size_t BleedEdgedImage::hash() const {
+  return hash_image<BleedEdgedImage>(base_image, horizontal_size, vertical_size, background_color);
+}
 
 // ----------------------------------------------------------------------------- : InsertedImage
 
 Image InsertedImage::generate(const Options& opt) const {
-  Image base_img =     base_image->generate(opt);
-  Image inserted_img = inserted_image->generate(opt);
+  Image base_img =     base_image->generateShared(opt);
+  Image inserted_img = inserted_image->generateShared(opt);
   int base_x =     offset_x < 0 ? -offset_x : 0;
   int base_y =     offset_y < 0 ? -offset_y : 0;
   int inserted_x = offset_x < 0 ? 0         : offset_x;
@@ -504,11 +784,14 @@ bool InsertedImage::operator == (const GeneratedImage& that) const {
     && offset_x == that2->offset_x
     && offset_y == that2->offset_y;
 }
+size_t InsertedImage::hash() const {
+  return hash_image<InsertedImage>(base_image, inserted_image, offset_x, offset_y);
+}
 
 // ----------------------------------------------------------------------------- : CropImage
 
 Image CropImage::generate(const Options& opt) const {
-  return image->generate(opt).Size(wxSize((int)width, (int)height), wxPoint(-(int)offset_x, -(int)offset_y));
+  return image->generateShared(opt).Size(wxSize((int)width, (int)height), wxPoint(-(int)offset_x, -(int)offset_y));
 }
 bool CropImage::operator == (const GeneratedImage& that) const {
   const CropImage* that2 = dynamic_cast<const CropImage*>(&that);
@@ -516,61 +799,15 @@ bool CropImage::operator == (const GeneratedImage& that) const {
                && width    == that2->width    && height   == that2->height
                && offset_x == that2->offset_x && offset_y == that2->offset_y;
 }
+size_t CropImage::hash() const {
+  return hash_image<CropImage>(image, width, height, offset_x, offset_y);
+}
 
 // ----------------------------------------------------------------------------- : DropShadowImage
 
-/// Preform a gaussian blur, from the image in of w*h bytes to out
-/** out is scaled some scaling, this is the return value */
-UInt gaussian_blur(Byte* in, UInt* out, int w, int h, double radius) {
-  // blur horizontally
-  auto blur_x = make_unique<UInt[]>(w*h); // scaled by total_x, so in [0..255*total_x]
-  memset(blur_x.get(), 0, w*h*sizeof(UInt));
-  UInt total_x = 0;
-  {
-    double sigma = radius * w;
-    double mult = (1 << 8) / (sqrt(2 * M_PI) * sigma);
-    double sigsqr2 = 1 / (2 * sigma * sigma);
-    int range = min(w, (int)(3*sigma));
-    for (int d = -range ; d <= range ; ++d) {
-      UInt factor = (int)( mult * exp(-d * d * sigsqr2) );
-      total_x += factor;
-      if (factor > 0) {
-        int x_start = max(0, -d), x_end = min(w, w-d);
-        for (int y = 0 ; y < h ; ++y) {
-          for (int x = x_start ; x < x_end ; ++x) {
-            blur_x[x + y*w] += in[x + d + y*w] * factor;
-          }
-        }
-      }
-    }
-  }
-  // blur vertically
-  memset(out, 0, w*h*sizeof(UInt));
-  UInt total_y = 0;
-  {
-    double sigma = radius * h;
-    double mult = (1 << 8) / (sqrt(2 * M_PI) * sigma);
-    double sigsqr2 = 1 / (2 * sigma * sigma);
-    int range = min(h, (int)(3*sigma));
-    for (int d = -range ; d <= range ; ++d) {
-      UInt factor = (UInt)( mult * exp(-d * d * sigsqr2) );
-      total_y += factor;
-      if (factor > 0) {
-        int y_start = max(0, -d), y_end = min(h, h-d);
-        for (int y = y_start ; y < y_end ; ++y) {
-          for (int x = 0 ; x < w ; ++x) {
-            out[x + y*w] += blur_x[x + (d + y)*w] * factor;
-          }
-        }
-      }
-    }
-  }
-  return total_x * total_y;
-}
-
 Image DropShadowImage::generate(const Options& opt) const {
   // sub image
-  Image img = image->generate(opt);
+  Image img = image->generateShared(opt);
   if (!img.HasAlpha()) {
     // no alpha, there is nothing we can do
     return img;
@@ -579,7 +816,7 @@ Image DropShadowImage::generate(const Options& opt) const {
   Byte* alpha = img.GetAlpha();
   // blur
   auto shadow = make_unique<UInt[]>(w*h);
-  UInt total = 255 * gaussian_blur(alpha, shadow.get(), w, h, shadow_blur_radius);
+  UInt total = 255 * gaussian_blur(alpha, shadow.get(), w, h, shadow_blur_radius * w, shadow_blur_radius * h);
   // combine
   Byte* data = img.GetData();
   int dw = int(w * offset_x), dh = int(h * offset_y);
@@ -608,6 +845,9 @@ bool DropShadowImage::operator == (const GeneratedImage& that) const {
                && shadow_alpha == that2->shadow_alpha && shadow_blur_radius == that2->shadow_blur_radius
                && shadow_color == that2->shadow_color;
 }
+size_t DropShadowImage::hash() const {
+  return hash_image<DropShadowImage>(image, offset_x, offset_y, shadow_alpha, shadow_blur_radius, shadow_color);
+}
 
 // ----------------------------------------------------------------------------- : PackagedImage
 
@@ -628,6 +868,9 @@ bool PackagedImage::operator == (const GeneratedImage& that) const {
   const PackagedImage* that2 = dynamic_cast<const PackagedImage*>(&that);
   return that2 && filename == that2->filename;
 }
+size_t PackagedImage::hash() const {
+  return hash_image<PackagedImage>(filename);
+}
 
 // ----------------------------------------------------------------------------- : BuiltInImage
 
@@ -643,6 +886,9 @@ bool BuiltInImage::operator == (const GeneratedImage& that) const {
   const BuiltInImage* that2 = dynamic_cast<const BuiltInImage*>(&that);
   return that2 && name == that2->name;
 }
+size_t BuiltInImage::hash() const {
+  return hash_image<BuiltInImage>(name);
+}
 
 // ----------------------------------------------------------------------------- : ArbitraryImage
 
@@ -653,6 +899,9 @@ bool ArbitraryImage::operator == (const GeneratedImage& that) const {
   const ArbitraryImage* that2 = dynamic_cast<const ArbitraryImage*>(&that);
   return that2 && image.IsSameAs(that2->image);
 }
+size_t ArbitraryImage::hash() const {
+  return hash_image<ArbitraryImage>((size_t)image.GetRefData()); // IsSameAs compares the data pointers
+}
 
 
 // ----------------------------------------------------------------------------- : SymbolToImage
@@ -690,6 +939,9 @@ bool SymbolToImage::operator == (const GeneratedImage& that) const {
                    *variation == *that2->variation // custom variation
                   );
 }
+size_t SymbolToImage::hash() const {
+  return hash_image<SymbolToImage>(is_local, filename, age); // the variation is compared by operator ==
+}
 
 // ----------------------------------------------------------------------------- : ImageValueToImage
 
@@ -716,6 +968,9 @@ bool ImageValueToImage::operator == (const GeneratedImage& that) const {
   return that2 && filename == that2->filename
                && age      == that2->age;
 }
+size_t ImageValueToImage::hash() const {
+  return hash_image<ImageValueToImage>(filename, age);
+}
 
 // ----------------------------------------------------------------------------- : ExternalImage
 
@@ -761,3 +1016,6 @@ bool ExternalImage::operator == (const GeneratedImage& that) const {
   const ExternalImage* that2 = dynamic_cast<const ExternalImage*>(&that);
   return that2 && that2->filepath == filepath;
 }
+size_t ExternalImage::hash() const {
+  return hash_image<ExternalImage>(filepath);
+}
@@ -11,6 +11,7 @@
 #include <util/prec.hpp>
 #include <util/age.hpp>
 #include <util/io/package.hpp>
+#include <util/lru_cache.hpp>
 #include <gfx/gfx.hpp>
 #include <script/value.hpp>
 
@@ -29,7 +30,7 @@ public:
   struct Options {
     Options(int width = 0, int height = 0, Package* package = nullptr, Package* local_package = nullptr, PreserveAspect preserve_aspect = ASPECT_STRETCH, bool saturate = false)
       : width(width), height(height), zoom(1.0), angle(0)
-      , preserve_aspect(preserve_aspect), saturate(saturate)
+      , preserve_aspect(preserve_aspect), saturate(saturate), filter(RESAMPLE_BOX)
       , package(package), local_package(local_package)
     {}
     
@@ -39,6 +40,7 @@ public:
     Radians        angle;           ///< Angle to rotate image by afterwards
     PreserveAspect preserve_aspect;
     bool           saturate;
+    ResampleFilter filter;          ///< Filter to use when resizing the image
     Package* package;       ///< Package to load images from
     Package* local_package; ///< Package to load symbols and ImageValue images from
   };
@@ -47,11 +49,16 @@ public:
   Image generateConform(const Options&) const;
   /// Generate the image
   virtual Image generate(const Options&) const = 0;
+  /// Generate the image, or reuse the image generated earlier by an equal image with the same options
+  /** The generated images are shared by all images in the program, so cards with the same frames share the work. */
+  Image generateShared(const Options&) const;
   /// How must the image be combined with the background?
   virtual ImageCombine combine() const { return COMBINE_DEFAULT; }
   /// Equality should mean that every pixel in the generated images is the same if the same options are used
   virtual bool operator == (const GeneratedImage& that) const = 0;
   inline  bool operator != (const GeneratedImage& that) const { return !(*this == that); }
+  /// Hash of the structure of the image, equal images must have the same hash
+  virtual size_t hash() const = 0;
   
   /// Can this image be generated safely from another thread?
   virtual bool threadSafe() const { return true; }
@@ -59,6 +66,9 @@ public:
   virtual bool local() const { return false; }
   /// Is this image blank?
   virtual bool isBlank() const { return false; }
+  /// Should generateShared keep the generated image?
+  /** Not for images that are cheap to generate, or that have to be generated every time. */
+  virtual bool cacheable() const { return true; }
   
   ScriptType type() const override;
   String typeName() const override;
@@ -68,6 +78,16 @@ public:
 /// Resize an image to conform to the options
 Image conform_image(const Image&, const GeneratedImage::Options&);
 
+/// Hits and misses of the images shared by GeneratedImage::generateShared
+extern CacheCounter generated_image_cache_counter;
+/// Forget all images shared by GeneratedImage::generateShared, they refer to packages that may be gone
+void clear_generated_image_cache();
+/// Forget the images shared by GeneratedImage::generateShared that were generated with a package
+/** Called when the package is destroyed, so a new package at the same address doesn't get them */
+void forget_generated_images(const Package* package);
+/// Check that images are only shared between equal image graphs, returns the number of problems found
+int check_generated_image_sharing();
+
 // ----------------------------------------------------------------------------- : SimpleFilterImage
 
 /// Apply some filter to a single image
@@ -89,7 +109,9 @@ class BlankImage : public GeneratedImage {
 public:
   Image generate(const Options&) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
   bool isBlank() const override { return true; }
+  bool cacheable() const override { return false; }
   
   // Why is this not thread safe? What is GTK smoking?
   #ifdef __WXGTK__
@@ -108,6 +130,7 @@ public:
   Image generate(const Options& opt) const override;
   ImageCombine combine() const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
   bool local() const override { return image1->local() && image2->local(); }
 private:
   GeneratedImageP image1, image2;
@@ -125,6 +148,7 @@ public:
   Image generate(const Options& opt) const override;
   ImageCombine combine() const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
   bool local() const override { return light->local() && dark->local() && mask->local(); }
 private:
   GeneratedImageP light, dark, mask;
@@ -141,6 +165,7 @@ public:
   Image generate(const Options& opt) const override;
   ImageCombine combine() const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
   bool local() const override { return image1->local() && image2->local(); }
 private:
   GeneratedImageP image1, image2;
@@ -157,6 +182,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   GeneratedImageP mask;
 };
@@ -169,6 +195,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   double alpha;
 };
@@ -184,6 +211,8 @@ public:
   Image generate(const Options& opt) const override;
   ImageCombine combine() const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
+  bool cacheable() const override { return false; }
 private:
   ImageCombine image_combine;
 };
@@ -198,6 +227,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   double amount;
 };
@@ -212,6 +242,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 };
 
 // ----------------------------------------------------------------------------- : RecolorImage
@@ -224,6 +255,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   Color color;
 };
@@ -235,6 +267,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   Color red,green,blue,white;
 };
@@ -249,6 +282,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 };
 
 /// Flip an image vertically
@@ -259,6 +293,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 };
 
 /// Rotate an image
@@ -269,6 +304,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   Radians angle;
 };
@@ -283,6 +319,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   double border_size;
 };
@@ -297,6 +334,7 @@ public:
     {}
     Image generate(const Options& opt) const override;
     bool operator == (const GeneratedImage& that) const override;
+    size_t hash() const override;
 private:
     int width;
     int height;
@@ -312,6 +350,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   double width, height;
   double offset_x, offset_y;
@@ -327,6 +366,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   GeneratedImageP base_image;
   double horizontal_size, vertical_size;
@@ -344,6 +384,7 @@ public:
     Image generate(const Options& opt) const override;
     ImageCombine combine() const override;
     bool operator == (const GeneratedImage& that) const override;
+    size_t hash() const override;
     bool local() const override { return base_image->local() && inserted_image->local(); }
 private:
     GeneratedImageP base_image, inserted_image;
@@ -362,6 +403,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   double offset_x, offset_y;
   double shadow_alpha;
@@ -379,6 +421,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   String filename;
 };
@@ -393,6 +436,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   String name;
 };
@@ -406,6 +450,8 @@ public:
     {}
     Image generate(const Options& opt) const override;
     bool operator == (const GeneratedImage& that) const override;
+    size_t hash() const override;
+    bool cacheable() const override { return false; }
 private:
     Image image;
 };
@@ -419,6 +465,7 @@ public:
   ~SymbolToImage();
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
   bool local() const override { return is_local; }
   
   #ifdef __WXGTK__
@@ -441,6 +488,7 @@ public:
   ~ImageValueToImage();
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
   bool local() const override { return true; }
 private:
   ImageValueToImage(const ImageValueToImage&); // copy ctor
@@ -456,6 +504,8 @@ public:
     ExternalImage(const String& filepath) : filepath(filepath) {};
     Image generate(const Options&) const override;
     bool operator == (const GeneratedImage& that) const override;
+    size_t hash() const override;
+    bool cacheable() const override { return false; } // importing has side effects
     inline String toString() { return filepath; }
     inline String toCode() const override { return _("<image>"); }
 private:
@@ -20,13 +20,23 @@
 
 // ----------------------------------------------------------------------------- : Resampling
 
+/// Filter to use when resampling an image
+enum ResampleFilter
+{  RESAMPLE_BOX      ///< average of the input pixels covered by an output pixel
+,  RESAMPLE_LANCZOS  ///< lanczos filter, sharper but slower, for high quality output such as printing
+};
+
 /// Resample (resize) an image, uses bilenear filtering
-void resample(const Image& img_in, Image& img_out);
-Image resample(const Image& img_in, int width, int height);
+/** Large images are resampled using multiple threads */
+void resample(const Image& img_in, Image& img_out, ResampleFilter filter = RESAMPLE_BOX);
+Image resample(const Image& img_in, int width, int height, ResampleFilter filter = RESAMPLE_BOX);
 
 /// Resamples an image, first clips the input image to a specified rectangle
 /** The selected rectangle is resampled into the entire output image */
-void resample_and_clip(const Image& img_in, Image& img_out, wxRect rect);
+void resample_and_clip(const Image& img_in, Image& img_out, wxRect rect, ResampleFilter filter = RESAMPLE_BOX);
+
+/// The original single threaded box resampler, resample_and_clip should give exactly the same results
+void resample_reference(const Image& img_in, Image& img_out, wxRect rect);
 
 /// How to preserve the aspect ratio of an image when rescaling
 enum PreserveAspect
@@ -36,8 +46,8 @@ enum PreserveAspect
 };
 
 /// Resample an image, but preserve the aspect ratio by adding a transparent border around the output if needed.
-void resample_preserve_aspect(const Image& img_in, Image& img_out);
-Image resample_preserve_aspect(const Image& img_in, int width, int height);
+void resample_preserve_aspect(const Image& img_in, Image& img_out, ResampleFilter filter = RESAMPLE_BOX);
+Image resample_preserve_aspect(const Image& img_in, int width, int height, ResampleFilter filter = RESAMPLE_BOX);
 
 /// Resample an image to create a sharp result by applying a sharpening filter
 /** Amount must be between 0 and 100 */
@@ -83,6 +93,12 @@ void linear_blend(Image& img1, const Image& img2, double x1,double y1, double x2
  */
 void mask_blend(Image& img1, const Image& img2, const Image& mask);
 
+/// Blend size bytes of b onto a, using mask[i * mask_stride] as the mask for a[i]
+/** Used by mask_blend, the same formula is used for every byte.
+ *  If reference, then no vectorized code is used (for testing).
+ */
+void mask_blend_bytes(Byte* a, const Byte* b, const Byte* mask, size_t size, size_t mask_stride, bool reference = false);
+
 // ----------------------------------------------------------------------------- : Effects
 
 /// Saturate an image
@@ -91,6 +107,18 @@ void saturate(Image& image, double amount);
 /// Invert the colors in an image
 void invert(Image& img);
 
+/// Blur the w*h bytes in with a gaussian blur, and store the result in out.
+/** sigma_x and sigma_y are the standard deviations in pixels, outside the image everything is 0.
+ *  The results are scaled, out is in the range [0..255*scale], where scale is returned.
+ *
+ *  Large blurs are approximated with box blurs, so the time per pixel doesn't depend on sigma.
+ *  The result differs from an exact gaussian blur by at most GAUSSIAN_BLUR_TOLERANCE.
+ */
+UInt gaussian_blur(const Byte* in, UInt* out, int w, int h, double sigma_x, double sigma_y);
+
+/// Maximum difference between gaussian_blur and an exact gaussian blur, on the scale [0..255]
+const double GAUSSIAN_BLUR_TOLERANCE = 6;
+
 // ----------------------------------------------------------------------------- : Combining
 
 /// Ways in which images can be combined, similair to what Photoshop supports
@@ -231,6 +259,11 @@ enum ImageCombine
 /// drawn onto the area where A originated.
 void combine_image(Image& a, const Image& b, ImageCombine combine);
 
+/// Combine size bytes of b onto a using some combining function, the results are stored in a.
+/** If reference, then no vectorized code or tables are used (for testing).
+ */
+void combine_bytes(Byte* a, const Byte* b, size_t size, ImageCombine combine, bool reference = false);
+
 /// Draw an image to a DC using a combining function
 void draw_combine_image(DC& dc, UInt x, UInt y, const Image& img, ImageCombine combine);
 
@@ -243,6 +276,12 @@ void set_alpha(Image& img, Byte* alphas, const wxSize& alphas_size);
 /// Set the transparency of img
 void set_alpha(Image& img, double alpha);
 
+/// Multiply size alpha values in a by alpha[i * alpha_stride] / 255
+/** If reference, then no vectorized code is used (for testing). */
+void multiply_alpha_bytes(Byte* a, const Byte* alpha, size_t size, size_t alpha_stride, bool reference = false);
+/// Multiply size alpha values in a by alpha / 255
+void multiply_alpha_bytes(Byte* a, Byte alpha, size_t size, bool reference = false);
+
 /// An alpha mask is an alpha channel that can be copied to another image
 /** It is created by treating black in the source image as transparent and white (red) as opaque
  */
@@ -8,148 +8,357 @@
 
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/simd.hpp>
 #include <util/error.hpp>
+#include <wx/thread.h>
+#include <atomic>
 
-// ----------------------------------------------------------------------------- : Resample passes
+// ----------------------------------------------------------------------------- : Resample weights
 
 // bitshift for fixed point numbers
 //  higher is less error
-//  we will get errors if 2^shift * imagesize becomes too large
-const int shift = 32-10-8; // => max size = 1024, max alpha = 255
+//  we will get errors if 2^shift * 255 * 255 becomes too large, the sums of premultiplied colors must fit in an int
+const int shift = 32-10-8; // => max alpha = 255, with room for the negative lobes of the lanczos filter
 
-// Resample an image only in a single direction, either horizontally or vertically
-/* Terms are based on x resampling (keeping the same number of lines):
- *  offset     = number of elements to skip at the start
- *  length     = length of a line
- *  delta      = number of elements between pixels in a lines
- *  lines      = number of lines
- *  line_delta = number of elements between the the first pixel of two lines
- *  1 element = 3 bytes in data, 1 byte in alpha
- */
-void resample_pass(const Image& img_in, Image& img_out, int offset_in, int offset_out,
-                   int length_in, int delta_in, int length_out, int delta_out,
-                   int lines, int line_delta_in, int line_delta_out)
-{
-  bool alpha = img_in.HasAlpha();
-  if (alpha && !img_out.HasAlpha()) img_out.InitAlpha();
-  int out_fact = (length_out << shift) / length_in; // how much to output for 256 input = 1 pixel
-  int out_rest = (length_out << shift) % length_in;
-  // for each line
-  for (int l = 0 ; l < lines ; ++l) {
-    Byte* in  = img_in .GetData() + 3 * (offset_in  + l * line_delta_in);
-    Byte* out = img_out.GetData() + 3 * (offset_out + l * line_delta_out);
-    UInt in_rem = out_fact + out_rest; // remaining to input from the current input pixel
-    
-    if (alpha) {
-      Byte* in_a  = img_in .GetAlpha() + (offset_in  + l * line_delta_in);
-      Byte* out_a = img_out.GetAlpha() + (offset_out + l * line_delta_out);
-      
-      for (int x = 0 ; x < length_out ; ++x) {
-        UInt out_rem = 1 << shift;
-        UInt totR = 0, totG = 0, totB = 0, totA = 0;
-        while (out_rem >= in_rem) {
-          // eat a whole input pixel
-          totR += in[0]   * in_rem * in_a[0]; // multiply by alpha
-          totG += in[1]   * in_rem * in_a[0];
-          totB += in[2]   * in_rem * in_a[0];
-          totA += in_a[0] * in_rem;
-          out_rem -= in_rem;
-          in_rem = out_fact;
-          in += 3*delta_in; in_a += delta_in;
-        }
-        if (out_rem > 0) {
-          // eat a partial input pixel
-          totR += in[0]   * out_rem * in_a[0];
-          totG += in[1]   * out_rem * in_a[0];
-          totB += in[2]   * out_rem * in_a[0];
-          totA += in_a[0] * out_rem;
-          in_rem -= out_rem;
-        }
-        // store
-        if (totA) {
-          out[0] = totR / totA;
-          out[1] = totG / totA;
-          out[2] = totB / totA;
-          out_a[0] = totA >> shift;
-        } else {
-          out[0] = out[1] = out[2] = out_a[0] = 0; // div by 0 is bad
-        }
-        out += 3*delta_out; out_a += delta_out;
+/// Number of lobes of the lanczos filter
+const int LANCZOS_LOBES = 3;
+
+/// The lanczos kernel
+double lanczos(double x) {
+  if (x == 0) return 1;
+  if (x <= -LANCZOS_LOBES || x >= LANCZOS_LOBES) return 0;
+  double px = M_PI * x;
+  return LANCZOS_LOBES * sin(px) * sin(px / LANCZOS_LOBES) / (px * px);
+}
+
+/// Which input pixels are used for each output pixel, and how much, when resampling in one direction
+/** The weights are fixed point numbers, the weights of an output pixel add up to exactly 1<<shift */
+struct ResampleWeights {
+  ResampleWeights(int length_in, int length_out, ResampleFilter filter);
+  
+  vector<int> first;   ///< First input pixel used for each output pixel
+  vector<int> offset;  ///< Position in weights of the weights of each output pixel, and one past the end
+  vector<int> weights; ///< Weights of the input pixels first, first+1, ...
+  
+  inline int count(int x) const { return offset[x + 1] - offset[x]; }
+  /// One past the last input pixel used for output pixel x
+  inline int end(int x) const { return first[x] + count(x); }
+};
+
+ResampleWeights::ResampleWeights(int length_in, int length_out, ResampleFilter filter) {
+  const int64_t one = 1 << shift;
+  offset.push_back(0);
+  if (filter == RESAMPLE_LANCZOS) {
+    // when downsampling the filter is stretched, so it covers all input pixels
+    double scale   = (double)length_in / length_out;
+    double stretch = max(1.0, scale);
+    double support = LANCZOS_LOBES * stretch;
+    vector<double> w;
+    for (int x = 0 ; x < length_out ; ++x) {
+      double center = (x + 0.5) * scale - 0.5;
+      int lo = (int)floor(center - support) + 1, hi = (int)ceil(center + support) - 1;
+      int first_in = max(0, lo), last_in = min(length_in - 1, hi);
+      w.assign(last_in - first_in + 1, 0.0);
+      double total = 0;
+      for (int i = lo ; i <= hi ; ++i) {
+        double v = lanczos((i - center) / stretch);
+        w[min(max(i, 0), length_in - 1) - first_in] += v; // outside the image, use the pixels at the edge
+        total += v;
       }
-      
-    } else {
-      // no alpha
-      for (int x = 0 ; x < length_out ; ++x) {
-        UInt out_rem = 1 << shift;
-        UInt totR = 0, totG = 0, totB = 0;
-        while (out_rem >= in_rem) {
-          // eat a whole input pixel
-          totR += in[0] * in_rem;
-          totG += in[1] * in_rem;
-          totB += in[2] * in_rem;
-          out_rem -= in_rem;
-          in_rem = out_fact;
-          in += 3*delta_in;
-        }
-        if (out_rem > 0) {
-          // eat a partial input pixel
-          totR += in[0] * out_rem;
-          totG += in[1] * out_rem;
-          totB += in[2] * out_rem;
-          in_rem -= out_rem;
-        }
-        // store
-        out[0] = totR >> shift;
-        out[1] = totG >> shift;
-        out[2] = totB >> shift;
-        out += 3*delta_out;
+      int sum = 0;
+      size_t largest = 0;
+      for (size_t k = 0 ; k < w.size() ; ++k) {
+        int v = (int)lround(w[k] / total * one);
+        weights.push_back(v);
+        sum += v;
+        if (w[k] > w[largest]) largest = k;
+      }
+      weights[offset.back() + largest] += (int)one - sum; // the rounding errors go to the largest weight
+      first.push_back(first_in);
+      offset.push_back((int)weights.size());
+    }
+  } else {
+    // box filter, each input pixel becomes a fixed amount of output, and the weights are the overlaps.
+    // to ensure the sum of all the pixel amounts is exacly length_out<<shift the rest of the division
+    // goes to the first pixel, so input pixel i covers [start(i), start(i+1)) of the output.
+    int64_t fact = ((int64_t)length_out << shift) / length_in;
+    int64_t rest = ((int64_t)length_out << shift) % length_in;
+    auto start = [=](int i) -> int64_t { return i == 0 ? 0 : rest + i * fact; };
+    int i = 0;
+    for (int x = 0 ; x < length_out ; ++x) {
+      int64_t lo = x * one, hi = lo + one;
+      while (start(i + 1) <= lo) ++i;
+      first.push_back(i);
+      for (int j = i ; j < length_in && start(j) < hi ; ++j) {
+        weights.push_back((int)(min(hi, start(j + 1)) - max(lo, start(j))));
       }
+      offset.push_back((int)weights.size());
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------- : Resampling rows
+
+// The image is resampled horizontally first, then vertically.
+// In between the pixels are stored as 4 ints: red*alpha, green*alpha, blue*alpha, alpha.
+// The horizontal pass rounds its results to bytes, so the results are the same as when using an intermediate image.
+// Images without alpha are treated as if all alpha values were 1 instead of 255, which gives the same colors.
+
+/// x / y for 0 <= x < 2^31 and 0 < y < 2^31, rounded down like integer division
+/** Multiplying by the reciprocal is much faster than three integer divisions, and it is off by at most one */
+inline int divide(int x, double reciprocal, int y) {
+  int q = (int)(x * reciprocal);
+  if ((int64_t)q * y > x) return q - 1;
+  if ((int64_t)(q + 1) * y <= x) return q + 1;
+  return q;
+}
+
+/// Convert a weighted sum of premultiplied pixels back to a pixel
+/** If opaque, then the input had no alpha, and the output is opaque */
+inline void store_pixel(const int* total, Byte* out, Byte* out_alpha, bool opaque) {
+  int a = total[3];
+  if (a == 1 << shift) {
+    // the input has no alpha
+    out[0] = (Byte)col(total[0] >> shift);
+    out[1] = (Byte)col(total[1] >> shift);
+    out[2] = (Byte)col(total[2] >> shift);
+  } else if (a > 0) {
+    double reciprocal = 1.0 / a;
+    out[0] = (Byte)(total[0] <= 0 ? 0 : min(255, divide(total[0], reciprocal, a)));
+    out[1] = (Byte)(total[1] <= 0 ? 0 : min(255, divide(total[1], reciprocal, a)));
+    out[2] = (Byte)(total[2] <= 0 ? 0 : min(255, divide(total[2], reciprocal, a)));
+  } else {
+    out[0] = out[1] = out[2] = 0; // div by 0 is bad
+  }
+  if (out_alpha) *out_alpha = opaque ? 255 : (Byte)col(a >> shift);
+}
+
+/// Resample a row of pixels, call store(x, total) for each output pixel, with the weighted sum of premultiplied pixels
+template <bool has_alpha, typename Store>
+void resample_row(const Byte* data, const Byte* alpha, const ResampleWeights& weights, int length_out, Store store) {
+  const int* offset = weights.offset.data();
+  const int* first  = weights.first.data();
+  const int* w      = weights.weights.data();
+  for (int x = 0 ; x < length_out ; ++x) {
+    const Byte* in   = data + 3 * first[x];
+    const Byte* in_a = has_alpha ? alpha + first[x] : nullptr;
+    int r = 0, g = 0, b = 0, a = 0;
+    for (int k = offset[x] ; k < offset[x + 1] ; ++k, in += 3) {
+      int weight = has_alpha ? w[k] * *in_a++ : w[k]; // premultiply by alpha
+      r += in[0] * weight;
+      g += in[1] * weight;
+      b += in[2] * weight;
+      a += weight;
+    }
+    int total[4] = {r, g, b, a};
+    store(x, total);
+  }
+}
+
+/// Weighted sum of count rows of length ints, that are stride apart
+void sum_rows(const int* rows, size_t stride, const int* weights, int count, int length, int* out) {
+  int x = 0;
+  #if MSE_SIMD
+    for ( ; x + (int)Simd::INTS <= length ; x += Simd::INTS) {
+      Simd::V sum = Simd::zero();
+      for (int k = 0 ; k < count ; ++k) {
+        sum = Simd::add32(sum, Simd::mul32(Simd::load32(rows + k * stride + x), Simd::set32(weights[k])));
+      }
+      Simd::store32(out + x, sum);
+    }
+  #endif
+  for ( ; x < length ; ++x) {
+    int sum = 0;
+    for (int k = 0 ; k < count ; ++k) sum += rows[k * stride + x] * weights[k];
+    out[x] = sum;
+  }
+}
+
+// ----------------------------------------------------------------------------- : Resampling tiles
+
+/// Number of output rows that are resampled together
+/** The input rows they use are resampled horizontally once per tile,
+ *  so with larger tiles less work is done twice, but more memory is used. */
+const int RESAMPLE_TILE_ROWS = 32;
+/// Maximum number of threads used for resampling one image
+const int MAX_RESAMPLE_JOBS = 8;
+/// Only use an extra thread for every this many pixels (in the input and the output)
+const long MIN_PIXELS_PER_RESAMPLE_JOB = 512 * 512;
+
+/// Resampling of a rectangle of one image into a rectangle of another
+/** Split into tiles of output rows, that can be resampled in parallel */
+class ResampleJob {
+public:
+  ResampleJob(const Image& img_in, wxRect rect, Image& img_out, wxRect out_rect, ResampleFilter filter, bool alpha);
+  
+  /// Resample all tiles, using multiple threads if the images are large enough
+  void run();
+  
+private:
+  class Worker;
+  const Byte* in_data;
+  const Byte* in_alpha;  ///< or nullptr if the input has no alpha
+  int         in_stride; ///< width of the input image
+  Byte*       out_data;
+  Byte*       out_alpha; ///< or nullptr if the output alpha is not written
+  int         out_stride;
+  int         in_width, in_height, out_width, out_height;
+  ResampleWeights weights_x, weights_y;
+  int         tiles;
+  atomic<int> next_tile;
+  
+  /// Resample tiles until there are no more left
+  void work();
+  void resampleTile(int tile);
+  /// Resample input row y horizontally
+  template <typename Store> inline void resampleRow(int y, Store store) const {
+    if (in_alpha) {
+      resample_row<true> (in_data + 3 * y * in_stride, in_alpha + y * in_stride, weights_x, out_width, store);
+    } else {
+      resample_row<false>(in_data + 3 * y * in_stride, nullptr, weights_x, out_width, store);
+    }
+  }
+};
+
+class ResampleJob::Worker : public wxThread {
+public:
+  Worker(ResampleJob& job) : wxThread(wxTHREAD_JOINABLE), job(job) {}
+  ExitCode Entry() override {
+    job.work();
+    return 0;
+  }
+private:
+  ResampleJob& job;
+};
+
+ResampleJob::ResampleJob(const Image& img_in, wxRect rect, Image& img_out, wxRect out_rect, ResampleFilter filter, bool alpha)
+  : in_data  (img_in.GetData() + 3 * (rect.x + rect.y * img_in.GetWidth()))
+  , in_alpha (img_in.HasAlpha() ? img_in.GetAlpha() + rect.x + rect.y * img_in.GetWidth() : nullptr)
+  , in_stride(img_in.GetWidth())
+  , out_data (img_out.GetData() + 3 * (out_rect.x + out_rect.y * img_out.GetWidth()))
+  , out_alpha(alpha ? img_out.GetAlpha() + out_rect.x + out_rect.y * img_out.GetWidth() : nullptr)
+  , out_stride(img_out.GetWidth())
+  , in_width (rect.width),     in_height (rect.height)
+  , out_width(out_rect.width), out_height(out_rect.height)
+  , weights_x(rect.width,  out_rect.width,  filter)
+  , weights_y(rect.height, out_rect.height, filter)
+  , tiles((out_height + RESAMPLE_TILE_ROWS - 1) / RESAMPLE_TILE_ROWS)
+  , next_tile(0)
+{}
+
+void ResampleJob::run() {
+  long pixels = (long)in_width * in_height + (long)out_width * out_height;
+  int jobs = min(min(wxThread::GetCPUCount(), MAX_RESAMPLE_JOBS), (int)min((long)tiles, pixels / MIN_PIXELS_PER_RESAMPLE_JOB));
+  // the other threads only read and write the image data, not the (non thread safe) images themselves
+  vector<unique_ptr<Worker>> workers;
+  for (int j = 1 ; j < jobs ; ++j) {
+    auto worker = make_unique<Worker>(*this);
+    if (worker->Run() != wxTHREAD_NO_ERROR) break; // the other threads will do its tiles
+    workers.push_back(move(worker));
+  }
+  work();
+  FOR_EACH(worker, workers) worker->Wait();
+}
+
+void ResampleJob::work() {
+  for (int tile = next_tile++ ; tile < tiles ; tile = next_tile++) {
+    resampleTile(tile);
+  }
+}
+
+void ResampleJob::resampleTile(int tile) {
+  int y0 = tile * RESAMPLE_TILE_ROWS, y1 = min(out_height, y0 + RESAMPLE_TILE_ROWS);
+  if (in_height == out_height) {
+    // no resizing vertically, resample the rows straight into the output
+    for (int y = y0 ; y < y1 ; ++y) {
+      Byte* out = out_data + 3 * y * out_stride;
+      Byte* out_a = out_alpha ? out_alpha + y * out_stride : nullptr;
+      resampleRow(y, [&](int x, const int* total) {
+        store_pixel(total, out + 3 * x, out_a ? out_a + x : nullptr, !in_alpha);
+      });
+    }
+    return;
+  }
+  // resample the input rows used by this tile horizontally
+  int row0 = weights_y.first[y0], row1 = weights_y.end(y1 - 1);
+  size_t stride = 4 * out_width;
+  vector<int> rows((row1 - row0) * stride);
+  for (int r = row0 ; r < row1 ; ++r) {
+    int* row = rows.data() + (r - row0) * stride;
+    if (!in_alpha) {
+      resample_row<false>(in_data + 3 * r * in_stride, nullptr, weights_x, out_width, [row](int x, const int* total) {
+        int* out = row + 4 * x;
+        out[0] = col(total[0] >> shift);
+        out[1] = col(total[1] >> shift);
+        out[2] = col(total[2] >> shift);
+        out[3] = 1;
+      });
+      continue;
     }
+    resample_row<true>(in_data + 3 * r * in_stride, in_alpha + r * in_stride, weights_x, out_width, [row](int x, const int* total) {
+      Byte rgb[3], a;
+      store_pixel(total, rgb, &a, false);
+      int* out = row + 4 * x;
+      out[0] = rgb[0] * a;
+      out[1] = rgb[1] * a;
+      out[2] = rgb[2] * a;
+      out[3] = a;
+    });
   }
+  // and then vertically
+  vector<int> sums(stride);
+  for (int y = y0 ; y < y1 ; ++y) {
+    sum_rows(rows.data() + (weights_y.first[y] - row0) * stride, stride,
+             &weights_y.weights[weights_y.offset[y]], weights_y.count(y), (int)stride, sums.data());
+    Byte* out = out_data + 3 * y * out_stride;
+    Byte* out_a = out_alpha ? out_alpha + y * out_stride : nullptr;
+    for (int x = 0 ; x < out_width ; ++x) {
+      store_pixel(sums.data() + 4 * x, out + 3 * x, out_a ? out_a + x : nullptr, !in_alpha);
+    }
+  }
+}
+
+/// Resample the rect of img_in into the out_rect of img_out
+/** If alpha, then the alpha channel of the output is written, img_out must have one. */
+void resample_rect(const Image& img_in, wxRect rect, Image& img_out, wxRect out_rect, ResampleFilter filter, bool alpha) {
+  if (rect.width <= 0 || rect.height <= 0 || out_rect.width <= 0 || out_rect.height <= 0) return;
+  ResampleJob job(img_in, rect, img_out, out_rect, filter, alpha);
+  job.run();
 }
 
 // ----------------------------------------------------------------------------- : Resample
 
 /* The algorithm first resizes in horizontally, then vertically,
  * the two passes are essentially the same:
- *  - for each row:
- *    - each input pixel becomes a fixed amount of output (in 1<<shift fixed point math)
- *    - for each output pixel:
- *      - _('eat') input pixels until the total is 1<<shift
- *      - write the total to the output pixel
- *  - to ensure the sum of all the pixel amounts is exacly width<<shift an extra rest amount
- *    is _('eaten') from the first pixel;
+ *  - for each output pixel the input pixels it uses and their weights are determined once (see ResampleWeights)
+ *  - the output rows are split into tiles, and the tiles are divided over several threads for large images
+ *  - for each tile:
+ *    - the input rows used by the tile are resampled horizontally
+ *    - each output row is a weighted sum of those rows, this loop is vectorized
  *
- * Uses fixed point numbers
+ * Uses fixed point numbers, with the box filter the results are exactly the same as those of resample_reference
  */
-void resample(const Image& img_in, Image& img_out) {
-  resample_and_clip(img_in, img_out, wxRect(0, 0, img_in.GetWidth(), img_in.GetHeight()));
+void resample(const Image& img_in, Image& img_out, ResampleFilter filter) {
+  resample_and_clip(img_in, img_out, wxRect(0, 0, img_in.GetWidth(), img_in.GetHeight()), filter);
 }
-Image resample(const Image& img_in, int width, int height) {
+Image resample(const Image& img_in, int width, int height, ResampleFilter filter) {
   if (img_in.GetWidth() == width && img_in.GetHeight() == height) {
     return img_in; // already the right size
   } else {
     Image img_out(width,height,false);
-    resample(img_in, img_out);
+    resample(img_in, img_out, filter);
     return img_out;
   }
 }
 
-void resample_and_clip(const Image& img_in, Image& img_out, wxRect rect) {
+void resample_and_clip(const Image& img_in, Image& img_out, wxRect rect, ResampleFilter filter) {
   // mask to alpha
   if (img_in.HasMask() && !img_in.HasAlpha()) {
     const_cast<Image&>(img_in).InitAlpha();
   }
-  // starting position in data
-  int offset_in = (rect.x + img_in.GetWidth() * rect.y);
-  if (img_out.GetHeight() == rect.height) {
-    // no resizing vertically
-    resample_pass(img_in,   img_out,  offset_in, 0, rect.width,  1,                   img_out .GetWidth(),  1,                   rect    .GetHeight(), img_in.GetWidth(), img_out .GetWidth());
-  } else {
-    Image img_temp(img_out.GetWidth(), rect.height, false);
-    resample_pass(img_in,   img_temp, offset_in, 0, rect.width,  1,                   img_temp.GetWidth(),  1,                   rect    .GetHeight(), img_in.GetWidth(), img_temp.GetWidth());
-    resample_pass(img_temp, img_out,  0,         0, rect.height, img_temp.GetWidth(), img_out .GetHeight(), img_temp.GetWidth(), img_temp.GetWidth(),  1,                 1);
-  }
+  bool alpha = img_in.HasAlpha();
+  if (alpha && !img_out.HasAlpha()) img_out.InitAlpha();
+  resample_rect(img_in, rect, img_out, wxRect(0, 0, img_out.GetWidth(), img_out.GetHeight()), filter, alpha);
 }
 
 
@@ -161,7 +370,7 @@ void fill_transparent(Image& img) {
   memset(img.GetAlpha(), 0, img.GetWidth() * img.GetHeight());
 }
 
-void resample_preserve_aspect(const Image& img_in, Image& img_out) {
+void resample_preserve_aspect(const Image& img_in, Image& img_out, ResampleFilter filter) {
   int rheight = img_in.GetHeight() * img_out.GetWidth()  / img_in.GetWidth();
   int rwidth  = img_in.GetWidth()  * img_out.GetHeight() / img_in.GetHeight();
   // actual size of output
@@ -173,19 +382,15 @@ void resample_preserve_aspect(const Image& img_in, Image& img_out) {
   // transparent background
   fill_transparent(img_out);
   // resample
-  int offset_out = dx + img_out.GetWidth() * dy;
-  Image img_temp(rwidth, img_in.GetHeight(), false);
-  img_temp.InitAlpha();
-  resample_pass(img_in,   img_temp, 0, 0,          img_in.GetWidth(),  1,                   rwidth,  1,                  img_in.GetHeight(), img_in.GetWidth(), img_temp.GetWidth());
-  resample_pass(img_temp, img_out,  0, offset_out, img_in.GetHeight(), img_temp.GetWidth(), rheight, img_out.GetWidth(), rwidth,             1,                 1);
+  resample_rect(img_in, wxRect(0, 0, img_in.GetWidth(), img_in.GetHeight()), img_out, wxRect(dx, dy, rwidth, rheight), filter, true);
 }
 
-Image resample_preserve_aspect(const Image& img_in, int width, int height) {
+Image resample_preserve_aspect(const Image& img_in, int width, int height, ResampleFilter filter) {
   if (img_in.GetWidth() == width && img_in.GetHeight() == height) {
     return img_in; // already the right size
   } else {
     Image img_out(width,height,false);
-    resample_preserve_aspect(img_in, img_out);
+    resample_preserve_aspect(img_in, img_out, filter);
     return img_out;
   }
 }
@@ -294,3 +499,116 @@ void sharp_downsample(const Image& img_in, Image& img_out, int amount) {
     if (al) al += width*2;
   }
 }
+
+// ----------------------------------------------------------------------------- : Reference
+
+// The original resampler, that streams through one line at a time.
+// It is kept to check that the resampling above gives the same results.
+
+// Resample an image only in a single direction, either horizontally or vertically
+/* Terms are based on x resampling (keeping the same number of lines):
+ *  offset     = number of elements to skip at the start
+ *  length     = length of a line
+ *  delta      = number of elements between pixels in a lines
+ *  lines      = number of lines
+ *  line_delta = number of elements between the the first pixel of two lines
+ *  1 element = 3 bytes in data, 1 byte in alpha
+ */
+void resample_pass_reference(const Image& img_in, Image& img_out, int offset_in, int offset_out,
+                   int length_in, int delta_in, int length_out, int delta_out,
+                   int lines, int line_delta_in, int line_delta_out)
+{
+  bool alpha = img_in.HasAlpha();
+  if (alpha && !img_out.HasAlpha()) img_out.InitAlpha();
+  int out_fact = (length_out << shift) / length_in; // how much to output for 256 input = 1 pixel
+  int out_rest = (length_out << shift) % length_in;
+  // for each line
+  for (int l = 0 ; l < lines ; ++l) {
+    Byte* in  = img_in .GetData() + 3 * (offset_in  + l * line_delta_in);
+    Byte* out = img_out.GetData() + 3 * (offset_out + l * line_delta_out);
+    UInt in_rem = out_fact + out_rest; // remaining to input from the current input pixel
+    
+    if (alpha) {
+      Byte* in_a  = img_in .GetAlpha() + (offset_in  + l * line_delta_in);
+      Byte* out_a = img_out.GetAlpha() + (offset_out + l * line_delta_out);
+      
+      for (int x = 0 ; x < length_out ; ++x) {
+        UInt out_rem = 1 << shift;
+        UInt totR = 0, totG = 0, totB = 0, totA = 0;
+        while (out_rem >= in_rem) {
+          // eat a whole input pixel
+          totR += in[0]   * in_rem * in_a[0]; // multiply by alpha
+          totG += in[1]   * in_rem * in_a[0];
+          totB += in[2]   * in_rem * in_a[0];
+          totA += in_a[0] * in_rem;
+          out_rem -= in_rem;
+          in_rem = out_fact;
+          in += 3*delta_in; in_a += delta_in;
+        }
+        if (out_rem > 0) {
+          // eat a partial input pixel
+          totR += in[0]   * out_rem * in_a[0];
+          totG += in[1]   * out_rem * in_a[0];
+          totB += in[2]   * out_rem * in_a[0];
+          totA += in_a[0] * out_rem;
+          in_rem -= out_rem;
+        }
+        // store
+        if (totA) {
+          out[0] = totR / totA;
+          out[1] = totG / totA;
+          out[2] = totB / totA;
+          out_a[0] = totA >> shift;
+        } else {
+          out[0] = out[1] = out[2] = out_a[0] = 0; // div by 0 is bad
+        }
+        out += 3*delta_out; out_a += delta_out;
+      }
+      
+    } else {
+      // no alpha
+      for (int x = 0 ; x < length_out ; ++x) {
+        UInt out_rem = 1 << shift;
+        UInt totR = 0, totG = 0, totB = 0;
+        while (out_rem >= in_rem) {
+          // eat a whole input pixel
+          totR += in[0] * in_rem;
+          totG += in[1] * in_rem;
+          totB += in[2] * in_rem;
+          out_rem -= in_rem;
+          in_rem = out_fact;
+          in += 3*delta_in;
+        }
+        if (out_rem > 0) {
+          // eat a partial input pixel
+          totR += in[0] * out_rem;
+          totG += in[1] * out_rem;
+          totB += in[2] * out_rem;
+          in_rem -= out_rem;
+        }
+        // store
+        out[0] = totR >> shift;
+        out[1] = totG >> shift;
+        out[2] = totB >> shift;
+        out += 3*delta_out;
+      }
+    }
+  }
+}
+
+void resample_reference(const Image& img_in, Image& img_out, wxRect rect) {
+  // mask to alpha
+  if (img_in.HasMask() && !img_in.HasAlpha()) {
+    const_cast<Image&>(img_in).InitAlpha();
+  }
+  // starting position in data
+  int offset_in = (rect.x + img_in.GetWidth() * rect.y);
+  if (img_out.GetHeight() == rect.height) {
+    // no resizing vertically
+    resample_pass_reference(img_in,   img_out,  offset_in, 0, rect.width,  1,                   img_out .GetWidth(),  1,                   rect    .GetHeight(), img_in.GetWidth(), img_out .GetWidth());
+  } else {
+    Image img_temp(img_out.GetWidth(), rect.height, false);
+    resample_pass_reference(img_in,   img_temp, offset_in, 0, rect.width,  1,                   img_temp.GetWidth(),  1,                   rect    .GetHeight(), img_in.GetWidth(), img_temp.GetWidth());
+    resample_pass_reference(img_temp, img_out,  0,         0, rect.height, img_temp.GetWidth(), img_out .GetHeight(), img_temp.GetWidth(), img_temp.GetWidth(),  1,                 1);
+  }
+}
@@ -0,0 +1,204 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+/** @file gfx/simd.hpp
+ *
+ *  Thin wrappers around SIMD instructions, used by the vectorized image processing kernels.
+ *  Vectors are used as bytes, shorts, ints or floats, depending on the operation.
+ *  The kernels are written once as templates over one of these instruction sets.
+ *
+ *  SSE2 is always available on x86-64, AVX2 is only used when the compiler targets it (e.g. -mavx2 or /arch:AVX2).
+ *  On other platforms MSE_SIMD is 0, and the kernels fall back to scalar code.
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define MSE_SIMD_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define MSE_SIMD_SSE2 1
+#endif
+#if defined(__SSE4_1__)
+  #include <smmintrin.h>
+#endif
+#if defined(MSE_SIMD_AVX2) || defined(MSE_SIMD_SSE2)
+  #define MSE_SIMD 1
+#else
+  #define MSE_SIMD 0
+#endif
+
+// ----------------------------------------------------------------------------- : SSE2
+
+#ifdef MSE_SIMD_SSE2
+/// Vectors of 16 bytes or 8 shorts, using SSE2
+struct SimdSse2 {
+  typedef __m128i V;
+  typedef __m128  F;
+  static const size_t BYTES = 16;
+  static const size_t INTS  = 4;
+  static const char* name() { return "SSE2"; }
+  
+  static inline V load(const Byte* p)  { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+  static inline void store(Byte* p, V v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+  static inline V zero()               { return _mm_setzero_si128(); }
+  static inline V set8 (int x)         { return _mm_set1_epi8(static_cast<char>(x)); }
+  static inline V set16(int x)         { return _mm_set1_epi16(static_cast<short>(x)); }
+  
+  // bitwise
+  static inline V and_(V a, V b)       { return _mm_and_si128(a, b); }
+  static inline V or_ (V a, V b)       { return _mm_or_si128(a, b); }
+  static inline V xor_(V a, V b)       { return _mm_xor_si128(a, b); }
+  /// mask ? a : b, for each bit
+  static inline V select(V mask, V a, V b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+  
+  // unsigned bytes
+  static inline V adds8(V a, V b)      { return _mm_adds_epu8(a, b); }
+  static inline V subs8(V a, V b)      { return _mm_subs_epu8(a, b); }
+  static inline V min8 (V a, V b)      { return _mm_min_epu8(a, b); }
+  static inline V max8 (V a, V b)      { return _mm_max_epu8(a, b); }
+  /// a > b for unsigned bytes, there is only a signed comparison
+  static inline V gt8(V a, V b)        { V s = set8(0x80); return _mm_cmpgt_epi8(_mm_xor_si128(a, s), _mm_xor_si128(b, s)); }
+  
+  // signed shorts
+  static inline V add16(V a, V b)      { return _mm_add_epi16(a, b); }
+  static inline V sub16(V a, V b)      { return _mm_sub_epi16(a, b); }
+  static inline V mul16(V a, V b)      { return _mm_mullo_epi16(a, b); }
+  static inline V min16(V a, V b)      { return _mm_min_epi16(a, b); }
+  static inline V max16(V a, V b)      { return _mm_max_epi16(a, b); }
+  static inline V gt16 (V a, V b)      { return _mm_cmpgt_epi16(a, b); }
+  template <int n> static inline V shr16(V a) { return _mm_srli_epi16(a, n); }
+  
+  // ints and floats
+  static inline V load32(const int* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+  static inline void store32(int* p, V v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+  static inline V add32(V a, V b)      { return _mm_add_epi32(a, b); }
+  static inline V sub32(V a, V b)      { return _mm_sub_epi32(a, b); }
+  static inline V set32(int x)         { return _mm_set1_epi32(x); }
+  /// Multiply ints, keeping the low 32 bits of the products
+  static inline V mul32(V a, V b) {
+    #ifdef __SSE4_1__
+      return _mm_mullo_epi32(a, b);
+    #else
+      // SSE2 can only multiply the even ints to 64 bit results
+      V even = _mm_mul_epu32(a, b);
+      V odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+      return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+    #endif
+  }
+  static inline F setf(float x)        { return _mm_set1_ps(x); }
+  static inline F addf(F a, F b)       { return _mm_add_ps(a, b); }
+  static inline F mulf(F a, F b)       { return _mm_mul_ps(a, b); }
+  static inline F to_float(V a)        { return _mm_cvtepi32_ps(a); }
+  /// Convert to int, rounding towards zero
+  static inline V to_int(F a)          { return _mm_cvttps_epi32(a); }
+  
+  /// Widen bytes to shorts, apply f, and narrow the results back to bytes (with saturation)
+  template <typename F> static inline V per16(V a, V b, F f) {
+    V lo = f(_mm_unpacklo_epi8(a, zero()), _mm_unpacklo_epi8(b, zero()));
+    V hi = f(_mm_unpackhi_epi8(a, zero()), _mm_unpackhi_epi8(b, zero()));
+    return _mm_packus_epi16(lo, hi);
+  }
+  template <typename F> static inline V per16(V a, V b, V c, F f) {
+    V lo = f(_mm_unpacklo_epi8(a, zero()), _mm_unpacklo_epi8(b, zero()), _mm_unpacklo_epi8(c, zero()));
+    V hi = f(_mm_unpackhi_epi8(a, zero()), _mm_unpackhi_epi8(b, zero()), _mm_unpackhi_epi8(c, zero()));
+    return _mm_packus_epi16(lo, hi);
+  }
+};
+#endif
+
+// ----------------------------------------------------------------------------- : AVX2
+
+#ifdef MSE_SIMD_AVX2
+/// Vectors of 32 bytes or 16 shorts, using AVX2
+/** Unpacking and packing work per 128 bit half, so per16 still keeps the bytes in order */
+struct SimdAvx2 {
+  typedef __m256i V;
+  typedef __m256  F;
+  static const size_t BYTES = 32;
+  static const size_t INTS  = 8;
+  static const char* name() { return "AVX2"; }
+  
+  static inline V load(const Byte* p)  { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+  static inline void store(Byte* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+  static inline V zero()               { return _mm256_setzero_si256(); }
+  static inline V set8 (int x)         { return _mm256_set1_epi8(static_cast<char>(x)); }
+  static inline V set16(int x)         { return _mm256_set1_epi16(static_cast<short>(x)); }
+  
+  static inline V and_(V a, V b)       { return _mm256_and_si256(a, b); }
+  static inline V or_ (V a, V b)       { return _mm256_or_si256(a, b); }
+  static inline V xor_(V a, V b)       { return _mm256_xor_si256(a, b); }
+  static inline V select(V mask, V a, V b) { return _mm256_blendv_epi8(b, a, mask); }
+  
+  static inline V adds8(V a, V b)      { return _mm256_adds_epu8(a, b); }
+  static inline V subs8(V a, V b)      { return _mm256_subs_epu8(a, b); }
+  static inline V min8 (V a, V b)      { return _mm256_min_epu8(a, b); }
+  static inline V max8 (V a, V b)      { return _mm256_max_epu8(a, b); }
+  static inline V gt8(V a, V b)        { V s = set8(0x80); return _mm256_cmpgt_epi8(_mm256_xor_si256(a, s), _mm256_xor_si256(b, s)); }
+  
+  static inline V add16(V a, V b)      { return _mm256_add_epi16(a, b); }
+  static inline V sub16(V a, V b)      { return _mm256_sub_epi16(a, b); }
+  static inline V mul16(V a, V b)      { return _mm256_mullo_epi16(a, b); }
+  static inline V min16(V a, V b)      { return _mm256_min_epi16(a, b); }
+  static inline V max16(V a, V b)      { return _mm256_max_epi16(a, b); }
+  static inline V gt16 (V a, V b)      { return _mm256_cmpgt_epi16(a, b); }
+  template <int n> static inline V shr16(V a) { return _mm256_srli_epi16(a, n); }
+  
+  static inline V load32(const int* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+  static inline void store32(int* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+  static inline V add32(V a, V b)      { return _mm256_add_epi32(a, b); }
+  static inline V sub32(V a, V b)      { return _mm256_sub_epi32(a, b); }
+  static inline V set32(int x)         { return _mm256_set1_epi32(x); }
+  static inline V mul32(V a, V b)      { return _mm256_mullo_epi32(a, b); }
+  static inline F setf(float x)        { return _mm256_set1_ps(x); }
+  static inline F addf(F a, F b)       { return _mm256_add_ps(a, b); }
+  static inline F mulf(F a, F b)       { return _mm256_mul_ps(a, b); }
+  static inline F to_float(V a)        { return _mm256_cvtepi32_ps(a); }
+  static inline V to_int(F a)          { return _mm256_cvttps_epi32(a); }
+  
+  template <typename F> static inline V per16(V a, V b, F f) {
+    V lo = f(_mm256_unpacklo_epi8(a, zero()), _mm256_unpacklo_epi8(b, zero()));
+    V hi = f(_mm256_unpackhi_epi8(a, zero()), _mm256_unpackhi_epi8(b, zero()));
+    return _mm256_packus_epi16(lo, hi);
+  }
+  template <typename F> static inline V per16(V a, V b, V c, F f) {
+    V lo = f(_mm256_unpacklo_epi8(a, zero()), _mm256_unpacklo_epi8(b, zero()), _mm256_unpacklo_epi8(c, zero()));
+    V hi = f(_mm256_unpackhi_epi8(a, zero()), _mm256_unpackhi_epi8(b, zero()), _mm256_unpackhi_epi8(c, zero()));
+    return _mm256_packus_epi16(lo, hi);
+  }
+};
+#endif
+
+// ----------------------------------------------------------------------------- : Best instruction set
+
+#if defined(MSE_SIMD_AVX2)
+  typedef SimdAvx2 Simd;
+#elif defined(MSE_SIMD_SSE2)
+  typedef SimdSse2 Simd;
+#endif
+
+#if MSE_SIMD
+/// x / 255 for shorts with 0 <= x <= 65279 (i.e. at least 255*255+254), rounded down like integer division
+template <typename S>
+inline typename S::V div255(typename S::V x) {
+  return S::template shr16<8>(S::add16(S::add16(x, S::set16(1)), S::template shr16<8>(x)));
+}
+#endif
+
+/// Name of the instruction set used by the vectorized kernels
+inline const char* simd_name() {
+  #if MSE_SIMD
+    return Simd::name();
+  #else
+    return "none";
+  #endif
+}
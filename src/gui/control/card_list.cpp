@@ -136,6 +136,15 @@ void CardListBase::getSelection(vector<CardP>& out) const {
   }
 }
 
+void CardListBase::getNeighbours(size_t count, vector<CardP>& out) const {
+  if (selected_item_pos < 0) return;
+  long size = (long)sorted_list.size();
+  for (long d = 1 ; d <= (long)count ; ++d) {
+    if (selected_item_pos + d < size) out.push_back(getCard(selected_item_pos + d));
+    if (selected_item_pos - d >= 0)   out.push_back(getCard(selected_item_pos - d));
+  }
+}
+
 // ----------------------------------------------------------------------------- : CardListBase : Clipboard
 
 bool CardListBase::canCut()   const { return canDelete(); }
@@ -99,6 +99,8 @@ public:
   inline CardP getCard(long pos) const { return static_pointer_cast<Card>(getItem(pos)); }
   /// Get a list of all focused cards
   void getSelection(vector<CardP>& out) const;
+  /// Get the cards after and before the selected card in the sorted list, up to count in each direction, nearest first
+  void getNeighbours(size_t count, vector<CardP>& out) const;
 protected:
   /// Get a list of all cards
   void getItems(vector<VoidP>& out) const override;
@@ -0,0 +1,224 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gui/control/card_prefetcher.hpp>
+#include <gui/control/card_viewer.hpp>
+#include <data/set.hpp>
+#include <data/card.hpp>
+#include <data/stylesheet.hpp>
+#include <data/action/value.hpp>
+#include <script/context.hpp>
+#include <script/to_value.hpp>
+#include <util/error.hpp>
+
+// ----------------------------------------------------------------------------- : PrefetchViewer
+
+/// Update styles, like SetScriptManager::updateStyles does, the only listeners are the viewers of the prefetcher
+void update_style_copies(Context& ctx, IndexMap<FieldP,StyleP>& styles, bool only_content_dependent) {
+  FOR_EACH(s, styles) {
+    if (only_content_dependent && !s->content_dependent) continue;
+    try {
+      if (int change = s->update(ctx)) {
+        s->tellListeners(change | (only_content_dependent ? CHANGE_ALREADY_PREPARED : 0));
+      }
+    } catch (const ScriptError& e) {
+      handle_error(ScriptError(e.what() + _("\n  while updating styles for '") + s->fieldP->name + _("'")));
+    }
+  }
+}
+
+/// Draws cards off-screen in the same way as the owner does
+/** The cards are drawn with copies of the styles of the stylesheet.
+ *  Updating the shared styles would tell the viewers of the owner that their styles changed,
+ *  and they would have to be prepared and drawn again.
+ */
+class CardPrefetcher::PrefetchViewer : public DataViewer {
+public:
+  PrefetchViewer(const CardViewer& owner) : owner(owner) {}
+  
+  Rotation rotation;
+  
+  /// View the same set as the owner
+  void useSet(const SetP& new_set) {
+    if (set != new_set) setSet(new_set);
+  }
+  
+  /// Show a card, using copies of the styles of its stylesheet
+  void showCard(const CardP& new_card) {
+    StyleSheetP new_stylesheet = set->stylesheetForP(new_card);
+    if (copied_from != new_stylesheet) {
+      dropCopies();
+      card_styles.cloneFrom(new_stylesheet->card_style);
+      extra_styles.cloneFrom(new_stylesheet->extra_card_style);
+      copied_from = new_stylesheet;
+    }
+    card = new_card;
+    stylesheet = new_stylesheet;
+    setStyles(stylesheet, card_styles, &extra_styles);
+    setData(card->data, &card->extraDataFor(*stylesheet));
+  }
+  
+  /// Forget the copied styles, scripted images in them can be out of date
+  void dropCopies() {
+    viewers.clear(); // the viewers listen to the copies
+    card_styles.clear();
+    extra_styles.clear();
+    copied_from = StyleSheetP();
+  }
+  
+  Rotation getRotation() const override           { return rotation; }
+  bool nativeLook() const override                { return owner.nativeLook(); }
+  DrawWhat drawWhat(const ValueViewer* v) const override { return owner.drawWhat(v); }
+  
+protected:
+  void updateStyles(bool only_content_dependent) override {
+    try {
+      Context& ctx = set->getContext(card);
+      if (!only_content_dependent) {
+        // update extra card fields
+        FOR_EACH(v, card->extraDataFor(*stylesheet)) {
+          if (v->update(ctx)) {
+            ScriptValueEvent change(card.get(), v.get());
+            set->actions.tellListeners(change, false);
+          }
+        }
+      }
+      // style scripts can look at other styles, those should be the copies as well
+      LocalScope scope(ctx);
+      ctx.setVariable(SCRIPT_VAR_card_style,       to_script(&card_styles));
+      ctx.setVariable(SCRIPT_VAR_extra_card_style, to_script(&extra_styles));
+      update_style_copies(ctx, card_styles,  only_content_dependent);
+      update_style_copies(ctx, extra_styles, only_content_dependent);
+    } catch (const Error& e) {
+      handle_error(e);
+    }
+  }
+  
+  // changes to the set are handled by the owner, it clears the prepared images
+  void onAction(const Action&, bool undone) override {}
+  
+  void onChangeSet() override {
+    dropCopies();
+    DataViewer::onChangeSet();
+  }
+  
+private:
+  const CardViewer& owner;
+  StyleSheetP copied_from;                ///< Stylesheet the styles were copied from
+  IndexMap<FieldP,StyleP> card_styles;    ///< Copies of the card styles of that stylesheet
+  IndexMap<FieldP,StyleP> extra_styles;   ///< Copies of the extra card styles of that stylesheet
+};
+
+// ----------------------------------------------------------------------------- : CardPrefetcher
+
+CardPrefetcher::CardPrefetcher(CardViewer& owner, size_t memory_budget)
+  : owner(owner)
+  , viewer(make_unique<PrefetchViewer>(owner))
+  , memory_budget(memory_budget)
+  , memory_used(0)
+  , drawing(false)
+{}
+
+CardPrefetcher::~CardPrefetcher() {}
+
+void CardPrefetcher::request(const vector<CardP>& cards) {
+  requested.clear();
+  FOR_EACH_CONST(card, cards) {
+    if (card && !isPrepared(card)) requested.push_back(card);
+  }
+}
+
+bool CardPrefetcher::prepareNext() {
+  if (requested.empty()) return false;
+  CardP card = requested.front();
+  requested.pop_front();
+  // only cards that look like the current one, other stylesheets have a different size
+  const SetP& set = owner.set;
+  if (!set || !owner.stylesheet || set->stylesheetForP(card) != owner.stylesheet) return !requested.empty();
+  wxSize size = owner.GetClientSize();
+  if (size.GetWidth() <= 0 || size.GetHeight() <= 0) return !requested.empty();
+  // draw the card, the same way CardViewer::onPaint does
+  viewer->useSet(set);
+  viewer->rotation = owner.getRotation();
+  drawing = true;
+  try {
+    Bitmap bitmap(size.GetWidth(), size.GetHeight());
+    if (!bitmap.Ok()) return false;
+    viewer->showCard(card);
+    wxMemoryDC dc;
+    dc.SelectObject(bitmap);
+    viewer->draw(dc);
+    dc.SelectObject(wxNullBitmap);
+    // store, drop the least recently used images to stay within the budget
+    size_t bytes = (size_t)size.GetWidth() * size.GetHeight() * 4;
+    while (!prepared.empty() && memory_used + bytes > memory_budget) {
+      memory_used -= prepared.back().bytes;
+      prepared.pop_back();
+    }
+    if (bytes <= memory_budget) {
+      prepared.push_front({card, bitmap, viewer->rotation, bytes});
+      memory_used += bytes;
+    }
+  } CATCH_ALL_ERRORS(false);
+  drawing = false;
+  return !requested.empty();
+}
+
+bool CardPrefetcher::find(const CardP& card, Bitmap& out) {
+  for (auto it = prepared.begin() ; it != prepared.end() ; ++it) {
+    if (it->card != card) continue;
+    if (!sameRotation(it->rotation) || it->bitmap.GetSize() != owner.GetClientSize()) {
+      // the viewer was zoomed or resized
+      memory_used -= it->bytes;
+      prepared.erase(it);
+      return false;
+    }
+    prepared.splice(prepared.begin(), prepared, it); // most recently used
+    out = prepared.front().bitmap;
+    return true;
+  }
+  return false;
+}
+
+void CardPrefetcher::drop(const Card* card) {
+  for (auto it = prepared.begin() ; it != prepared.end() ; ++it) {
+    if (it->card.get() != card) continue;
+    memory_used -= it->bytes;
+    prepared.erase(it);
+    return;
+  }
+}
+
+void CardPrefetcher::clear() {
+  requested.clear();
+  prepared.clear();
+  memory_used = 0;
+  viewer->dropCopies();
+}
+
+void CardPrefetcher::reset() {
+  clear();
+  viewer->useSet(SetP());
+}
+
+bool CardPrefetcher::isPrepared(const CardP& card) const {
+  FOR_EACH_CONST(p, prepared) {
+    if (p.card == card) return true;
+  }
+  return false;
+}
+
+bool CardPrefetcher::sameRotation(const Rotation& rotation) const {
+  Rotation current = owner.getRotation();
+  RealRect a = rotation.getExternalRect(), b = current.getExternalRect();
+  return rotation.getAngle()   == current.getAngle()
+      && rotation.getZoom()    == current.getZoom()
+      && rotation.getStretch() == current.getStretch()
+      && a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
@@ -0,0 +1,72 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/rotation.hpp>
+#include <list>
+
+DECLARE_POINTER_TYPE(Card);
+class CardViewer;
+
+// ----------------------------------------------------------------------------- : CardPrefetcher
+
+/// Renders the cards around the one shown in a CardViewer ahead of time
+/** When the viewer switches to a prepared card, the image can be shown right away,
+ *  instead of waiting for the styles to be updated and all values to be drawn.
+ *
+ *  Cards are drawn with copies of the styles, so the viewers of the owner are not disturbed.
+ *  wx can only draw from the main thread, so cards are prepared one at a time when the application is idle.
+ *  Prepared images are dropped when the set changes, or when they no longer fit in the memory budget.
+ */
+class CardPrefetcher {
+public:
+  CardPrefetcher(CardViewer& owner, size_t memory_budget = 64 * 1024 * 1024);
+  ~CardPrefetcher();
+  
+  /// Set the cards to prepare, nearest first, this replaces the previous request
+  void request(const vector<CardP>& cards);
+  /// Prepare the next requested card, returns false if there is nothing left to do
+  bool prepareNext();
+  
+  /// Find the prepared image of a card, it must have been rendered with the owner's current size and rotation
+  bool find(const CardP& card, Bitmap& out);
+  /// Drop the prepared image of a card, because it is no longer up to date
+  void drop(const Card* card);
+  /// Drop all prepared images, because they are no longer up to date
+  void clear();
+  /// Drop everything, including the set, because the owner shows a different set
+  void reset();
+  
+  /// Is a card being drawn right now?
+  /** Drawing a card updates its values and styles, the events for that don't make other images out of date. */
+  inline bool isDrawing() const { return drawing; }
+  
+private:
+  class PrefetchViewer;
+  /// An image of a card
+  struct Prepared {
+    CardP   card;
+    Bitmap  bitmap;
+    Rotation rotation; ///< Rotation of the owner when the image was rendered
+    size_t  bytes;
+  };
+  
+  CardViewer&               owner;
+  unique_ptr<PrefetchViewer> viewer;        ///< Viewer used to draw the cards, with its own copies of the styles
+  deque<CardP>              requested;      ///< Cards that still have to be prepared, nearest first
+  std::list<Prepared>       prepared;       ///< Most recently used first
+  size_t                    memory_budget;  ///< Maximum number of bytes used by the prepared images
+  size_t                    memory_used;
+  bool                      drawing;        ///< Is prepareNext drawing a card?
+  
+  bool isPrepared(const CardP& card) const;
+  /// Is an image rendered with the given rotation valid for the owner?
+  bool sameRotation(const Rotation& rotation) const;
+};
@@ -13,6 +13,7 @@
 #include <data/stylesheet.hpp>
 #include <data/settings.hpp>
 #include <render/value/viewer.hpp>
+#include <data/action/value.hpp>
 #include <wx/dcbuffer.h>
 #include <util/window_id.hpp>
 
@@ -105,10 +106,61 @@ void CardViewer::onPaint(wxPaintEvent&) {
   // draw
   if (!up_to_date) {
     up_to_date = true;
+    Bitmap prefetched;
+    if (card != drawn_card && prefetcher && prefetcher->find(card, prefetched)) {
+      // show the prepared image now, the viewers are prepared for editing when idle
+      dc.DrawBitmap(prefetched, 0, 0);
+    } else {
+      drawn_card = card;
+      try {
+        draw(dc);
+      } CATCH_ALL_ERRORS(false); // don't show message boxes in onPaint!
+    }
+  }
+}
+
+void CardViewer::onIdle(wxIdleEvent& ev) {
+  if (!prefetcher) return;
+  if (card != drawn_card && up_to_date) {
+    // we are showing a prefetched image, which is up to date, so don't draw the card again,
+    // only prepare the viewers for editing
+    drawn_card = card;
+    Bitmap scratch(1, 1);
+    wxMemoryDC dc;
+    dc.SelectObject(scratch);
     try {
-      draw(dc);
-    } CATCH_ALL_ERRORS(false); // don't show message boxes in onPaint!
+      prepare(dc);
+    } CATCH_ALL_ERRORS(false);
+    dc.SelectObject(wxNullBitmap);
+    ev.RequestMore();
+  } else if (prefetcher->prepareNext()) {
+    ev.RequestMore();
+  }
+}
+
+void CardViewer::prefetch(const vector<CardP>& cards) {
+  if (!prefetcher) prefetcher = make_unique<CardPrefetcher>(*this);
+  prefetcher->request(cards);
+}
+
+void CardViewer::onAction(const Action& action, bool undone) {
+  if (prefetcher && !prefetcher->isDrawing()) {
+    const ScriptValueEvent* change = dynamic_cast<const ScriptValueEvent*>(&action);
+    if (change && change->card) {
+      // a script changed a value of one card, for example after the keywords changed
+      prefetcher->drop(change->card);
+    } else {
+      // a change to the set can change how other cards look
+      prefetcher->clear();
+    }
   }
+  DataViewer::onAction(action, undone);
+}
+
+void CardViewer::onChangeSet() {
+  if (prefetcher) prefetcher->reset();
+  drawn_card = CardP();
+  DataViewer::onChangeSet();
 }
 
 void CardViewer::onClick(wxMouseEvent& ev) {
@@ -177,5 +229,6 @@ Rotation CardViewer::getRotation() const {
 
 BEGIN_EVENT_TABLE(CardViewer, wxControl)
   EVT_PAINT(CardViewer::onPaint)
+  EVT_IDLE(CardViewer::onIdle)
   EVT_LEFT_DOWN(CardViewer::onClick)
 END_EVENT_TABLE  ()
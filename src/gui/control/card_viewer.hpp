@@ -10,6 +10,7 @@
 
 #include <util/prec.hpp>
 #include <render/card/viewer.hpp>
+#include <gui/control/card_prefetcher.hpp>
 
 // ----------------------------------------------------------------------------- : Events
 
@@ -37,6 +38,10 @@ public:
   /// The rotation to use
   Rotation getRotation() const override;
   
+  /// Render the given cards in the background, so they can be shown without delay when selected
+  /** The cards should be given nearest first */
+  void prefetch(const vector<CardP>& cards);
+  
   bool AcceptsFocus() const override { return false; }
   
 protected:
@@ -51,17 +56,24 @@ protected:
   
   void drawViewer(RotatedDC& dc, ValueViewer& v) override;
   
+  void onAction(const Action&, bool undone) override;
+  void onChangeSet() override;
+  
 private:
   DECLARE_EVENT_TABLE();
 
   void onPaint(wxPaintEvent&);
+  void onIdle(wxIdleEvent&);
 
   void onClick(wxMouseEvent&);
 
   Bitmap buffer;     ///< Off-screen buffer we draw to
   bool   up_to_date; ///< Is the buffer up to date?
+  CardP  drawn_card; ///< Card for which the viewers were last drawn, if the buffer shows a prefetched card the viewers are drawn when idle
+  unique_ptr<CardPrefetcher> prefetcher; ///< Only created when prefetch() is used
   
   class OverdrawDC;
   class OverdrawDC_aux;
+  friend class CardPrefetcher;
 };
 
@@ -160,6 +160,14 @@ GraphData::GraphData(const GraphDataPre& d)
     }
     ++i;
   }
+  // number the groups on each axis, so elements don't have to search through all groups
+  vector<unordered_map<String,int>> group_index(axes.size());
+  for (size_t i = 0 ; i < axes.size() ; ++i) {
+    int j = 0;
+    FOR_EACH(g, axes[i]->groups) {
+      group_index[i].insert(make_pair(g.name, j++)); // the first group with a name wins
+    }
+  }
   // count elements in each position
   values.reserve(d.elements.size());
   size_t de_size = sizeof(GraphDataElement) + sizeof(int) * (axes.size() - 1);
@@ -178,13 +186,9 @@ GraphData::GraphData(const GraphDataPre& d)
         de->group_nrs[i] = bin_to_group(d, a->bin_size);
       } else {
         // find group that contains v
-        int j = 0;
-        FOR_EACH(g, a->groups) {
-          if (v == g.name) {
-            de->group_nrs[i] = j;
-            break;
-          }
-          ++j;
+        auto it = group_index[i].find(v);
+        if (it != group_index[i].end()) {
+          de->group_nrs[i] = it->second;
         }
       }
       ++i;
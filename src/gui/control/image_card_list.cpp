@@ -50,14 +50,16 @@ ImageFieldP ImageCardList::findImageField() {
 /// A request for a thumbnail of a card image
 class CardThumbnailRequest : public ThumbnailRequest {
 public:
-  CardThumbnailRequest(ImageCardList* parent, const LocalFileName& filename)
+  CardThumbnailRequest(ImageCardList* parent, const LocalFileName& filename, int priority)
     : ThumbnailRequest(
       parent,
       _("card") + parent->set->absoluteFilename() + _("-") + filename.toStringForKey(),
-      wxDateTime::Now())  // TODO: Find mofication time of card image
+      wxDateTime::Now(),  // TODO: Find mofication time of card image
+      priority)
     , filename(filename)
   {}
   Image generate() override {
+    if (aborted()) return Image();
     try {
       ImageCardList* parent = (ImageCardList*)owner;
       Image image;
@@ -98,8 +100,8 @@ int ImageCardList::OnGetItemImage(long pos) const {
     if (it != thumbnails.end()) {
       return it->second;
     } else {
-      // request a thumbnail
-      thumbnail_thread.request(make_intrusive<CardThumbnailRequest>(const_cast<ImageCardList*>(this), val.filename));
+      // request a thumbnail, items that are drawn last are the ones currently visible, so they come first
+      thumbnail_thread.request(make_intrusive<CardThumbnailRequest>(const_cast<ImageCardList*>(this), val.filename, ++thumbnail_requests));
     }
   }
   return -1;
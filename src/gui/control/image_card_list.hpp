@@ -33,6 +33,7 @@ private:
   
   ImageFieldP image_field;      ///< Field to use for card images
   mutable map<String,int> thumbnails;  ///< image thumbnails, based on image_field
+  mutable int thumbnail_requests = 0;  ///< Number of thumbnail requests, later requests are for the items currently shown
   
   ImageFieldP findImageField();
   
@@ -164,7 +164,10 @@ public:
     , list(list), ti(ti)
   {}
   
+  /// Downloading with wxURL from several threads at once is not safe
+  bool concurrent() const override { return false; }
   Image generate() override {
+    if (aborted()) return Image();
     wxURL url(ti->package->description->icon_url);
     unique_ptr<wxInputStream> isP(url.GetInputStream());
     if (!isP) return wxImage();
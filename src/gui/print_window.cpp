@@ -161,6 +161,12 @@ void PrintJob::center_cards() {
 
 // ----------------------------------------------------------------------------- : Printout
 
+/// A viewer for printing cards, printed cards are worth resizing images with a better filter
+class PrintDataViewer : public DataViewer {
+public:
+  ResampleFilter resampleFilter() const override { return RESAMPLE_LANCZOS; }
+};
+
 /// A printout object specifying how to print a specified set of cards
 class CardsPrintout : public wxPrintout {
 public:
@@ -176,7 +182,7 @@ public:
   
 private:
   PrintJobP job; ///< Cards to print
-  DataViewer viewer;
+  PrintDataViewer viewer;
   RealSize printer_px_per_mm;
   
   int pageCount() {
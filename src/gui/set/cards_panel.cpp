@@ -632,6 +632,10 @@ void CardsPanel::selectCard(const CardP& card) {
   card_list->setCard(card);
 
   editor->setCard(card);
+  // prepare the cards the user is likely to browse to next
+  vector<CardP> neighbours;
+  card_list->getNeighbours(2, neighbours);
+  editor->prefetch(neighbours);
   vector<pair<CardP, String>> linked_cards = card->getLinkedCards(*set);
   int count = linked_cards.size();
   if (count >= 1) {
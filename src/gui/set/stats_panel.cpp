@@ -15,6 +15,7 @@
 #include <data/game.hpp>
 #include <data/statistics.hpp>
 #include <data/action/value.hpp>
+#include <data/action/set.hpp>
 #include <util/window_id.hpp>
 #include <util/alignment.hpp>
 #include <util/tagged_string.hpp>
@@ -336,16 +337,36 @@ void StatsPanel::onChangeSet() {
     categories->show(set->game);
   #endif
   card = CardP();
+  stats_cache.clear();
   onChange();
 }
 
 void StatsPanel::onAction(const Action& action, bool undone) {
   if (!isInitialized()) return;
-  TYPE_CASE_(action, ScriptValueEvent) {
-    // ignore style only stuff
-  } else {
+  TYPE_CASE(action, ScriptValueEvent) {
+    // a script changed a value, scripts often change many values at once, so update the graph when idle
+    if (action.card) stats_cache.invalidate(action.card);
+    else             stats_cache.clear();
+    up_to_date = false;
+    return;
+  }
+  TYPE_CASE(action, ValueAction) {
+    if (action.card) stats_cache.invalidate(action.card.get());
+    else             stats_cache.clear();
+    onChange();
+    return;
+  }
+  TYPE_CASE_(action, AddCardAction) {
+    // values are found by card, so new cards are calculated and removed ones are dropped
     onChange();
+    return;
+  }
+  TYPE_CASE_(action, ReorderCardsAction) {
+    onChange();
+    return;
   }
+  stats_cache.clear();
+  onChange();
 }
 
 void StatsPanel::initUI   (wxToolBar* tb, wxMenuBar* mb) {
@@ -425,6 +446,10 @@ void StatsPanel::onChange() {
   }
 }
 
+void StatsPanel::onIdle(wxIdleEvent&) {
+  if (active && !up_to_date) showCategory();
+}
+
 void StatsPanel::showCategory(const GraphType* prefer_layout) {
   up_to_date = true;
   // find dimensions and layout
@@ -473,49 +498,15 @@ void StatsPanel::showCategory(const GraphType* prefer_layout) {
       )
     );
   }
-  // find global_script values
-  vector<ScriptValueP> global_values;
-  Context& global_ctx = set->getContext();
-  ScriptValueP global_ctx_value = global_ctx.getVariableOpt("global_value");
-  for (size_t d = 0 ; d < dims.size() ; ++d) {
-    auto& dim = dims[d];
-    try {
-      ScriptValueP global_value = dim->global_script.invoke(global_ctx);
-      global_values.push_back(global_value);
-    } catch (ScriptError const& e) {
-      handle_error(ScriptError(e.what() + _("\n  in global script for statistics dimension '") + dim->name + _("'")));
-      global_values.push_back(script_nil);
-    }
+  // find script values for each card, only cards that changed are evaluated again
+  vector<size_t> card_indices;
+  vector<vector<String>> rows;
+  stats_cache.rows(*set, dims, card_indices, rows);
+  for (size_t i = 0 ; i < rows.size() ; ++i) {
+    GraphElementP e = make_intrusive<GraphElement>(card_indices[i]);
+    e->values.swap(rows[i]);
+    d.elements.push_back(e);
   }
-  // find script values for each card
-  for (size_t i = 0 ; i < set->cards.size() ; ++i) {
-    Context& ctx = set->getContext(set->cards[i]);
-    GraphElementP e = make_intrusive<GraphElement>(i);
-    bool show = true;
-    for (size_t d = 0 ; d < dims.size() ; ++d) {
-      auto& dim = dims[d];
-      ctx.setVariable("global_value", global_values[d]);
-      try {
-        String value = untag(dim->script.invoke(ctx)->toString());
-        e->values.push_back(value);
-        if (value.empty() && !dim->show_empty) {
-          // don't show this element
-          show = false;
-          break;
-        }
-      } catch (ScriptError const& e) {
-        handle_error(ScriptError(e.what() + _("\n  in script for statistics dimension '") + dim->name + _("'")));
-        show = false;
-        break;
-      }
-    }
-    if (show) {
-      assert(e->values.size() == dims.size());
-      d.elements.push_back(e);
-    }
-  }
-  // restore old global value if any
-  if (global_ctx_value) global_ctx.setVariable("global_value", global_ctx_value);
   // split lists
   size_t dim_id = 0;
   FOR_EACH(dim, dims) {
@@ -569,6 +560,7 @@ void StatsPanel::filterCards() {
 
 BEGIN_EVENT_TABLE(StatsPanel, wxPanel)
   EVT_GRAPH_SELECT(wxID_ANY, StatsPanel::onGraphSelect)
+  EVT_IDLE        (          StatsPanel::onIdle)
 END_EVENT_TABLE()
 
 // ----------------------------------------------------------------------------- : Selection
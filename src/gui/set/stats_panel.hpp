@@ -11,6 +11,7 @@
 #include <util/prec.hpp>
 #include <gui/set/panel.hpp>
 #include <data/graph_type.hpp>
+#include <data/statistics.hpp>
 
 class StatCategoryList;
 class StatDimensionList;
@@ -60,12 +61,14 @@ private:
   wxMenu*           menuGraph;
   
   CardP card;      ///< Selected card
+  StatsCache stats_cache; ///< Values of the dimensions for each card
   bool up_to_date; ///< Are the graph and card list up to date?
   bool active;     ///< Is this panel selected?
   
   void initControls();
   
   void onChange();
+  void onIdle(wxIdleEvent&);
   void onGraphSelect(wxCommandEvent&);
   void showCategory(const GraphType* prefer_layout = nullptr);
   void showLayout(GraphType);
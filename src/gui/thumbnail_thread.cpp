@@ -38,59 +38,86 @@ String safe_filename(const String& str) {
 
 // ----------------------------------------------------------------------------- : ThumbnailThreadWorker
 
+/// Write a thumbnail to the image cache
+/** The image is written to a temporary file first, so a file in the cache is never half written */
+void write_image_cache(const String& filename, const Image& img, const wxDateTime& modified) {
+  String temp_filename = filename + String::Format(_(".%lu.tmp"), (unsigned long)wxThread::GetCurrentId());
+  if (!img.SaveFile(temp_filename, wxBITMAP_TYPE_PNG) || !wxRenameFile(temp_filename, filename, true)) {
+    wxRemoveFile(temp_filename);
+    return;
+  }
+  // set modification time
+  wxFileName fn(filename);
+  fn.SetTimes(0, &modified, 0);
+}
+
+/// Generate a thumbnail, errors give an empty image
+Image generate_thumbnail(ThumbnailRequest& request) {
+  try {
+    return request.generate();
+  } catch (const Error& e) {
+    handle_error(e);
+  } catch (...) {
+  }
+  return Image();
+}
+
 class ThumbnailThreadWorker : public wxThread {
 public:
   ThumbnailThreadWorker(ThumbnailThread* parent);
   
   ExitCode Entry() override;
   
-  ThumbnailRequestP current; ///< Request we are working on
-  ThumbnailThread*  parent;
-  bool              stop; ///< Suspend computation
+private:
+  ThumbnailThread* parent;
 };
 
 ThumbnailThreadWorker::ThumbnailThreadWorker(ThumbnailThread* parent)
   : parent(parent)
-  , stop(false)
 {}
 
 wxThread::ExitCode ThumbnailThreadWorker::Entry() {
   while (true) {
-    do {
-      Sleep(1);
-    } while (stop);
-    // get a request
+    // get some work, requests first, writing to the cache can wait
+    ThumbnailRequestP current;
+    ThumbnailThread::CacheWrite write;
     {
       wxMutexLocker lock(parent->mutex);
-      if (parent->open_requests.empty()) {
-        parent->worker = nullptr;
-        return 0; // No more requests
+      current = parent->takeRequest();
+      if (current) {
+        parent->running_requests.push_back(current);
+        if (!current->concurrent()) parent->serial_running = true;
+      } else if (!parent->cache_writes.empty()) {
+        write = parent->cache_writes.front();
+        parent->cache_writes.pop_front();
+      } else {
+        // No more work, or only requests that wait for the one that is not concurrent,
+        // the worker generating that one will take them afterwards
+        parent->workers -= 1;
+        parent->completed.Broadcast();
+        return 0;
       }
-      current = parent->open_requests.front();
-      parent->open_requests.pop_front();
+    }
+    if (!current) {
+      write_image_cache(write.filename, write.image, write.modified);
+      continue;
     }
     // perform request
     Image img;
-    try {
-      img = current->generate();
-    } catch (const Error& e) {
-      handle_error(e);
-    } catch (...) {
+    if (!current->aborted()) {
+      img = generate_thumbnail(*current);
     }
-    // store in cache
-    if (img.Ok()) {
-      String filename = image_cache_dir() + safe_filename(current->cache_name) + _(".png");
-      img.SaveFile(filename, wxBITMAP_TYPE_PNG);
-      // set modification time
-      wxFileName fn(filename);
-      fn.SetTimes(0, &current->modified, 0);
-    }
-    // store result in closed request list
+    // store result in closed request list, the owner can use it before it is written to the cache
     {
       wxMutexLocker lock(parent->mutex);
-      parent->closed_requests.push_back(make_pair(current,img));
+      parent->running_requests.erase(find(parent->running_requests.begin(), parent->running_requests.end(), current));
+      if (!current->concurrent()) parent->serial_running = false;
+      if (!current->aborted()) {
+        if (img.Ok()) parent->queueCacheWrite(*current, img);
+        parent->closed_requests.push_back(make_pair(current,img));
+      }
       current = ThumbnailRequestP();
-      parent->completed.Signal();
+      parent->completed.Broadcast();
     }
   }
 }
@@ -107,13 +134,19 @@ ThumbnailThread thumbnail_thread;
 
 ThumbnailThread::ThumbnailThread()
   : completed(mutex)
-  , worker(nullptr)
+  , workers(0)
+  , max_workers(0)
+  , serial_running(false)
 {}
 
 void ThumbnailThread::request(const ThumbnailRequestP& request) {
   assert(wxThread::IsMain());
   // Is the request in progress?
-  if (request_names.find(request) != request_names.end()) {
+  set<ThumbnailRequestP>::const_iterator existing = request_names.find(request);
+  if (existing != request_names.end()) {
+    // it might be wanted sooner now
+    wxMutexLocker lock(mutex);
+    (*existing)->priority = max((*existing)->priority, request->priority);
     return;
   }
   // Is the image in the cache?
@@ -131,40 +164,57 @@ void ThumbnailThread::request(const ThumbnailRequestP& request) {
   if (request->threadSafe()) {
     request_names.insert(request);
     // request generation
-    {
-      wxMutexLocker lock(mutex);
-      open_requests.push_back(request);
-    }
-    // is there a worker?
-    if (!worker) {
-      worker = new ThumbnailThreadWorker(this);
-      worker->Create();
-      worker->Run();
-    }
+    wxMutexLocker lock(mutex);
+    open_requests.push_back(request);
+    startWorkers();
   } else {
-    Image img;
-    try {
-      img = request->generate();
-    } catch (const Error& e) {
-      handle_error(e);
-    } catch (...) {
-    }
-    // store in cache
+    Image img = generate_thumbnail(*request);
+    // store in cache, in a worker thread
+    wxMutexLocker lock(mutex);
     if (img.Ok()) {
-      String filename = image_cache_dir() + safe_filename(request->cache_name) + _(".png");
-      img.SaveFile(filename, wxBITMAP_TYPE_PNG);
-      // set modification time
-      wxFileName fn(filename);
-      fn.SetTimes(0, &request->modified, 0);
+      queueCacheWrite(*request, img);
+      startWorkers();
     }
-    {
-      wxMutexLocker lock(mutex);
-      closed_requests.push_back(make_pair(request,img));
-      completed.Signal();
+    closed_requests.push_back(make_pair(request,img));
+  }
+}
+
+void ThumbnailThread::startWorkers() {
+  if (max_workers == 0) {
+    max_workers = max(1, min(wxThread::GetCPUCount(), 8));
+  }
+  size_t work = running_requests.size() + open_requests.size() + (cache_writes.empty() ? 0 : 1);
+  while (workers < max_workers && (size_t)workers < work) {
+    ThumbnailThreadWorker* worker = new ThumbnailThreadWorker(this);
+    if (worker->Create() != wxTHREAD_NO_ERROR || worker->Run() != wxTHREAD_NO_ERROR) {
+      delete worker;
+      break;
     }
+    workers += 1;
   }
 }
 
+ThumbnailRequestP ThumbnailThread::takeRequest() {
+  // the first request with the highest priority
+  deque<ThumbnailRequestP>::iterator best = open_requests.end();
+  for (deque<ThumbnailRequestP>::iterator it = open_requests.begin() ; it != open_requests.end() ; ++it) {
+    if (serial_running && !(*it)->concurrent()) continue; // has to wait
+    if (best == open_requests.end() || (*it)->priority > (*best)->priority) best = it;
+  }
+  if (best == open_requests.end()) return ThumbnailRequestP();
+  ThumbnailRequestP request = *best;
+  open_requests.erase(best);
+  return request;
+}
+
+void ThumbnailThread::queueCacheWrite(const ThumbnailRequest& request, const Image& image) {
+  CacheWrite write;
+  write.filename = image_cache_dir() + safe_filename(request.cache_name) + _(".png");
+  write.modified = request.modified;
+  write.image    = image.Copy(); // the original goes to the main thread
+  cache_writes.push_back(write);
+}
+
 bool ThumbnailThread::done(void* owner) {
   assert(wxThread::IsMain());
   // find finished requests
@@ -193,14 +243,7 @@ bool ThumbnailThread::done(void* owner) {
 
 void ThumbnailThread::abort(void* owner) {
   assert(wxThread::IsMain());
-  mutex.Lock();
-  if (worker && worker->current && worker->current->owner == owner) {
-    // a request for this owner is in progress, wait until it is done
-    worker->stop = true;
-    completed.Wait();
-    mutex.Lock();
-    worker->stop = false;
-  }
+  wxMutexLocker lock(mutex);
   // remove open requests for this owner
   for (size_t i = 0 ; i < open_requests.size() ; ) {
     if (open_requests[i]->owner == owner) {
@@ -211,6 +254,20 @@ void ThumbnailThread::abort(void* owner) {
       ++i;
     }
   }
+  // requests for this owner that are in progress are asked to stop, their results will be discarded
+  // the requests can refer to the owner, so wait until they are done
+  while (true) {
+    bool running = false;
+    FOR_EACH(r, running_requests) {
+      if (r->owner == owner) {
+        r->is_aborted = true;
+        request_names.erase(r);
+        running = true;
+      }
+    }
+    if (!running) break;
+    completed.Wait();
+  }
   // remove closed requests for this owner
   for (size_t i = 0 ; i < closed_requests.size() ; ) {
     if (closed_requests[i].first->owner == owner) {
@@ -221,23 +278,22 @@ void ThumbnailThread::abort(void* owner) {
       ++i;
     }
   }
-  mutex.Unlock();
 }
 
 void ThumbnailThread::abortAll() {
   assert(wxThread::IsMain());
-  mutex.Lock();
+  wxMutexLocker lock(mutex);
   open_requests.clear();
   closed_requests.clear();
   request_names.clear();
-  // end worker
-  if (worker && worker->current) {
+  // stop the requests in progress
+  FOR_EACH(r, running_requests) {
+    r->is_aborted = true;
+  }
+  // the images that were already generated are still written to the cache,
+  // wait until the workers have done that and ended, so nothing is written after we return
+  if (!cache_writes.empty()) startWorkers();
+  while (workers > 0) {
     completed.Wait();
-  } else {
-    mutex.Unlock();
   }
-  // There may still be a worker, but if there is, it has no current object, so it is
-  // in, before or after the stop loop. It can do nothing but end.
-  // An unfortunate side effect is that we might leak some memory (of the worker object),
-  // when the thread gets Kill()ed by wx.
 }
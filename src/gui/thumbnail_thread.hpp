@@ -11,7 +11,7 @@
 #include <util/prec.hpp>
 #include <wx/datetime.h>
 #include <wx/filename.h>
-#include <queue>
+#include <atomic>
 
 DECLARE_POINTER_TYPE(ThumbnailRequest);
 class ThumbnailThreadWorker;
@@ -21,8 +21,8 @@ class ThumbnailThreadWorker;
 /// A request for some kind of thumbnail
 class ThumbnailRequest : public IntrusivePtrVirtualBase {
 public:
-  ThumbnailRequest(void* owner, const String& cache_name, const wxDateTime& modified)
-    : owner(owner), cache_name(cache_name), modified(modified) {}
+  ThumbnailRequest(void* owner, const String& cache_name, const wxDateTime& modified, int priority = 0)
+    : owner(owner), cache_name(cache_name), modified(modified), priority(priority), is_aborted(false) {}
   
   virtual ~ThumbnailRequest() {}
   
@@ -33,6 +33,10 @@ public:
 
   /// Can the thumbnail safely be generated from another thread?
   virtual bool threadSafe() const { return true; }
+  /// Can the thumbnail be generated at the same time as other thumbnails?
+  /** If not, then at most one such request is generated at a time.
+   *  Requests that use state shared with other requests (that is not locked) should return false. */
+  virtual bool concurrent() const { return true; }
   
   /// Object that requested the thumbnail
   void* const owner;
@@ -40,14 +44,24 @@ public:
   String cache_name;
   /// Modification time for the object of which the thumnail is generated
   wxDateTime modified;
+  /// Requests with a higher priority are generated first, requests with the same priority in order
+  int priority;
+  
+  /// Has the owner aborted this request?
+  /** A generate() function that takes a long time can check this, and give up by returning an empty image */
+  inline bool aborted() const { return is_aborted; }
+  
+private:
+  atomic<bool> is_aborted;
+  friend class ThumbnailThread;
 };
 
 // ----------------------------------------------------------------------------- : ThumbnailThread
 
-/// A (generic) class that generates thumbnails in another thread
+/// A (generic) class that generates thumbnails in other threads
 /** All requests have an 'owner', the object that requested the thumbnail.
  *  This object should regularly call "done(this)".
- *  Multiple requests can be open at the same time.
+ *  Multiple requests can be open at the same time, they are generated by a pool of worker threads.
  *  Thumbnails are cached, and need not be generated in a thread
  */
 class ThumbnailThread {
@@ -55,25 +69,50 @@ public:
   ThumbnailThread();
   
   /// Request a thumbnail, it may be store()d immediatly if the thumbnail is cached
+  /** If the same thumbnail was already requested, and is not being generated yet,
+   *  the priority of the earlier request is raised to that of the new one.
+   */
   void request(const ThumbnailRequestP& request);
   /// Is one or more thumbnail for the given owner finished?
   /** If so, call their store() functions */
   bool done(void* owner);
   /// Abort all thumbnail requests for the given owner
+  /** Waits until requests for this owner that are being generated are finished */
   void abort(void* owner);
   /// Abort all computations
-  /** *must* be called at application exit */
+  /** Thumbnails that were already generated are written to the cache first,
+   *  when this function returns no worker is running anymore.
+   *  *must* be called at application exit */
   void abortAll();
   
 private:
-  wxMutex     mutex;  ///< Mutex used by the worker when accessing the request lists or the thread pointer
-  wxCondition completed; ///< Event signaled when a request is completed
+  /// An image that still has to be written to the cache
+  struct CacheWrite {
+    String     filename;
+    wxDateTime modified;
+    Image      image; ///< not shared with any other thread
+  };
   
-  deque<ThumbnailRequestP>                open_requests;    ///< Requests on which work hasn't finished
+  wxMutex     mutex;     ///< Mutex used by the workers when accessing the request lists or the worker count
+  wxCondition completed; ///< Event signaled when a worker stops working on a request
+  
+  deque<ThumbnailRequestP>               open_requests;    ///< Requests on which work hasn't started
+  vector<ThumbnailRequestP>              running_requests; ///< Requests that are being generated by a worker
   vector<pair<ThumbnailRequestP,Image>>  closed_requests;  ///< Requests for which work is completed
-  set<ThumbnailRequestP>                  request_names;    ///< Requests that haven't been stored yet, to prevent duplicates
+  deque<CacheWrite>                      cache_writes;     ///< Images to write to the cache, after all requests are done
+  set<ThumbnailRequestP>                 request_names;    ///< Requests that haven't been stored yet, to prevent duplicates
   friend class ThumbnailThreadWorker;
-  ThumbnailThreadWorker* worker;                ///< The worker thread. invariant: no requests ==> worker==nullptr
+  int workers;     ///< Number of worker threads. invariant: no open requests or cache writes ==> no workers
+  int max_workers; ///< Maximum number of worker threads
+  bool serial_running; ///< Is a request that is not concurrent() being generated?
+  
+  /// Start another worker thread if there is more work than workers, mutex must be locked
+  void startWorkers();
+  /// Take the open request with the highest priority that can be started now, mutex must be locked
+  /** Returns nullptr if there is none */
+  ThumbnailRequestP takeRequest();
+  /// Queue an image to be written to the cache by a worker, mutex must be locked
+  void queueCacheWrite(const ThumbnailRequest& request, const Image& image);
 };
 
 /// The global thumbnail generator thread
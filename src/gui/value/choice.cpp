@@ -27,8 +27,11 @@ public:
 
   bool isThreadSafe;
   bool threadSafe() const override {return isThreadSafe;}
+  /// Choice images can open files from other packages, and the package manager is not locked
+  bool concurrent() const override {return false;}
 private:
   int id;
+  const ScriptableImage* image; ///< The image of the choice, looked up on the main thread, or nullptr
   
   inline ChoiceStyle& style()  { return *static_cast<ChoiceStyle*>(viewer().getStyle().get()); }
   inline ValueViewer& viewer() { return *static_cast<ValueViewer*>(owner); }
@@ -43,14 +46,17 @@ ChoiceThumbnailRequest::ChoiceThumbnailRequest(ValueViewer* viewer, int id, bool
   )
   , isThreadSafe(thread_safe)
   , id(id)
-{}
+  , image(nullptr)
+{
+  // the style is shared, so look up the image here, not from a worker thread
+  ChoiceStyle& s = style();
+  auto it = s.choice_images.find(canonical_name_form(s.field().choices->choiceName(id)));
+  if (it != s.choice_images.end()) image = &it->second;
+}
 
 Image ChoiceThumbnailRequest::generate() {
-  ChoiceStyle& s = style();
-  String name = canonical_name_form(s.field().choices->choiceName(id));
-  ScriptableImage& img = s.choice_images[name];
-  return img.isReady()
-    ? img.generate(GeneratedImage::Options(thumbnail_size, thumbnail_size, &viewer().getStylePackage(), &viewer().getLocalPackage(), ASPECT_BORDER, true))
+  return image && image->isReady()
+    ? image->generate(GeneratedImage::Options(thumbnail_size, thumbnail_size, &viewer().getStylePackage(), &viewer().getLocalPackage(), ASPECT_BORDER, true))
     : wxImage();
 }
 
@@ -16,7 +16,10 @@
 #include <data/installer.hpp>
 #include <data/format/formats.hpp>
 #include <data/font.hpp>
+#include <script/parser.hpp>
+#include <script/script_cache.hpp>
 #include <cli/cli_main.hpp>
+#include <cli/export_server.hpp>
 #include <cli/text_io_handler.hpp>
 #include <gui/welcome_window.hpp>
 #include <gui/update_checker.hpp>
@@ -136,6 +139,9 @@ int MSE::OnRun() {
           return EXIT_SUCCESS;
         } else if (f.GetExt() == _("mse-script")) {
           // Run a script file
+          if (args.size() > 1 && args[1] == _("--no-optimize")) {
+            optimize_scripts = false;
+          }
           if (!run_script_file(arg)) return EXIT_FAILURE;
           if (cli.shown_errors()) return EXIT_FAILURE;
           return EXIT_SUCCESS;
@@ -179,8 +185,10 @@ int MSE::OnRun() {
                              << NORMAL << _(" [") << BRIGHT << _("--local") << NORMAL << _("]");
           cli << _("\n         \tInstall the packages from the installer.");
           cli << _("\n         \tIf the ") << BRIGHT << _("--local") << NORMAL << _(" flag is passed, install packages for this user only.");
-          cli << _("\n\n  ") << PARAM << _("FILE") << FILE_EXT << _(".mse-script") << NORMAL;
+          cli << _("\n\n  ") << PARAM << _("FILE") << FILE_EXT << _(".mse-script")
+                             << NORMAL << _(" [") << BRIGHT << _("--no-optimize") << NORMAL << _("]");
           cli << _("\n         \tRun a script file.");
+          cli << _("\n         \tIf the ") << BRIGHT << _("--no-optimize") << NORMAL << _(" flag is passed, scripts are run exactly as parsed.");
           cli << _("\n\n  ") << BRIGHT << _("--symbol-editor") << NORMAL;
           cli << _("\n         \tShow the symbol editor instead of the welcome window.");
           cli << _("\n\n  ") << BRIGHT << _("--create-installer") << NORMAL << _(" [")
@@ -191,9 +199,41 @@ int MSE::OnRun() {
           cli << _("\n\n  ") << BRIGHT << _("--export") << NORMAL << PARAM << _(" TEMPLATE SETFILE ") << NORMAL << _(" [") << PARAM << _("OUTFILE") << NORMAL << _("]");
           cli << _("\n         \tExport a set using an export template.");
           cli << _("\n         \tIf no output filename is specified, the result is written to stdout.");
-          cli << _("\n\n  ") << BRIGHT << _("--export-images") << NORMAL << PARAM << _(" FILE") << NORMAL << _(" [") << PARAM << _("IMAGE") << NORMAL << _("]");
+          cli << _("\n\n  ") << BRIGHT << _("--export-images") << NORMAL << PARAM << _(" FILE") << NORMAL << _(" [") << PARAM << _("IMAGE") << NORMAL << _("] [")
+                             << BRIGHT << _("--jobs") << NORMAL << PARAM << _(" N") << NORMAL << _("]");
           cli << _("\n         \tExport the cards in a set to image files,");
           cli << _("\n         \tIMAGE is the same format as for 'export all card images'.");
+          cli << _("\n         \tUse ") << BRIGHT << _("--jobs") << NORMAL << PARAM << _(" N") << NORMAL << _(" to encode and write the images with N threads while rendering.");
+          cli << _("\n\n  ") << BRIGHT << _("--benchmark") << NORMAL << PARAM << _(" FILE") << NORMAL << _(" [") << PARAM << _("OUTFILE") << FILE_EXT << _(".json") << NORMAL << _("] [")
+                             << BRIGHT << _("--repeat") << NORMAL << PARAM << _(" N") << NORMAL << _("] [")
+                             << BRIGHT << _("--script") << NORMAL << PARAM << _(" SCRIPT") << NORMAL << FILE_EXT << _(".mse-script") << NORMAL << _("] [")
+                             << BRIGHT << _("--load") << NORMAL << _("] [")
+                             << BRIGHT << _("--update") << NORMAL << _(" [") << BRIGHT << _("--jobs") << NORMAL << PARAM << _(" N") << NORMAL << _("]] [")
+                             << BRIGHT << _("--parse") << NORMAL << _("] [")
+                             << BRIGHT << _("--keywords") << NORMAL << _("]");
+          cli << _("\n         \tRender all cards in a set without saving them, and report how long each stage took as JSON.");
+          cli << _("\n         \tWith ") << BRIGHT << _("--script") << NORMAL << _(" the script is evaluated for each card instead of rendering it.");
+          cli << _("\n         \tWith ") << BRIGHT << _("--load") << NORMAL << _(" the set and its packages are loaded, with and without the compiled script cache.");
+          cli << _("\n         \tWith ") << BRIGHT << _("--update") << NORMAL << _(" the card values are updated one card at a time and in parallel, the results must be the same,");
+          cli << _("\n         \tthe parallel update uses N threads, or one for each processor.");
+          cli << _("\n         \tWith ") << BRIGHT << _("--parse") << NORMAL << _(" the scripts in the set and its packages are tokenized and parsed again.");
+          cli << _("\n         \tWith ") << BRIGHT << _("--keywords") << NORMAL << _(" the keywords are found in the text of all cards, the matches must be the same as when trying every keyword.");
+          cli << _("\n         \tIf no output filename is specified, the result is written to stdout.");
+          cli << _("\n\n  ") << BRIGHT << _("--benchmark-blend") << NORMAL << _(" [") << PARAM << _("OUTFILE") << FILE_EXT << _(".json") << NORMAL << _("] [")
+                             << BRIGHT << _("--repeat") << NORMAL << PARAM << _(" N") << NORMAL << _("]");
+          cli << _("\n         \tCheck that the vectorized image combining and blending code gives the same results as the scalar code,");
+          cli << _("\n         \tthat the gaussian blur is close to an exact blur, and that generated images are only shared between");
+          cli << _("\n         \tequal images. Report the throughput of the scalar and vectorized code as JSON.");
+          cli << _("\n\n  ") << BRIGHT << _("--benchmark-resample") << NORMAL << _(" [") << PARAM << _("OUTFILE") << FILE_EXT << _(".json") << NORMAL << _("] [")
+                             << BRIGHT << _("--repeat") << NORMAL << PARAM << _(" N") << NORMAL << _("]");
+          cli << _("\n         \tCheck that the image resampler gives the same results as the original single threaded one,");
+          cli << _("\n         \tand report how long resizing large card art takes as JSON.");
+          cli << _("\n\n  ") << BRIGHT << _("--serve") << NORMAL;
+          cli << _("\n         \tRun as a batch export server: read one JSON request per line from stdin,");
+          cli << _("\n         \tand write one JSON response per line to stdout. Loaded sets and packages stay in memory.");
+          cli << _("\n         \tCommands are load, render, eval, export, unload and quit, for example:");
+          cli << _("\n         \t  {\"id\":1, \"command\":\"load\", \"set\":\"my.mse-set\"}");
+          cli << _("\n         \t  {\"id\":2, \"command\":\"render\", \"card\":0, \"out\":\"card0.png\"}");
           cli << _("\n\n  ") << BRIGHT << _("--cli") << NORMAL << _(" [")
                              << PARAM << _("FILE") << NORMAL << _("] [")
                              << BRIGHT << _("--quiet") << NORMAL << _("] [")
@@ -235,14 +275,31 @@ int MSE::OnRun() {
           }
           CLISetInterface cli_interface(set,quiet);
           return EXIT_SUCCESS;
+        } else if (arg == _("--serve")) {
+          // batch export server
+          ExportServer server;
+          server.run();
+          return EXIT_SUCCESS;
         } else if (arg == _("--export-images")) {
           if (args.size() < 2) {
             handle_error(Error(_("No input file specified for --export")));
             return EXIT_FAILURE;
           }
+          // number of threads used for writing images
+          int jobs = 1;
+          for (size_t i = 2 ; i < args.size() ; ++i) {
+            if (args[i] == _("--jobs") || args[i] == _("-j")) {
+              long n = 0;
+              if (i + 1 < args.size() && args[i + 1].ToLong(&n) && n > 0) {
+                jobs = (int)n;
+              } else {
+                jobs = max(1, wxThread::GetCPUCount());
+              }
+            }
+          }
           SetP set = import_set(args[1]);
           // path
-          String out = args.size() >= 3 && !starts_with(args[2], _("--"))
+          String out = args.size() >= 3 && !starts_with(args[2], _("-"))
             ? args[2]
             : settings.gameSettingsFor(*set->game).images_export_filename;
           String path = _(".");
@@ -254,7 +311,105 @@ int MSE::OnRun() {
             out = out.substr(pos + 1);
           }
           // export
-          export_image(set, set->cards, path, out, CONFLICT_NUMBER_OVERWRITE);
+          wxStopWatch timer;
+          size_t count = export_image(set, set->cards, path, out, CONFLICT_NUMBER_OVERWRITE, jobs);
+          double seconds = timer.Time() / 1000.0;
+          cli << String::Format(_("Exported %d cards in %.2f s (%.1f cards/s)"), (int)count, seconds, seconds > 0 ? count / seconds : 0.0) << ENDL;
+          cli.flush();
+          return EXIT_SUCCESS;
+        } else if (arg == _("--benchmark")) {
+          if (args.size() < 2) {
+            handle_error(Error(_("No input file specified for --benchmark")));
+            return EXIT_FAILURE;
+          }
+          int repeat = 1, jobs = 0;
+          bool load = false, update = false, parse_scripts = false, keywords = false, consistent = true;
+          String out, script;
+          for (size_t i = 2 ; i < args.size() ; ++i) {
+            long n = 0;
+            if (args[i] == _("--repeat") && i + 1 < args.size() && args[i + 1].ToLong(&n) && n > 0) {
+              repeat = (int)n;
+              ++i;
+            } else if (args[i] == _("--jobs") && i + 1 < args.size() && args[i + 1].ToLong(&n) && n > 0) {
+              jobs = (int)n;
+              ++i;
+            } else if (args[i] == _("--script") && i + 1 < args.size()) {
+              script = args[i + 1];
+              ++i;
+            } else if (args[i] == _("--load")) {
+              load = true;
+            } else if (args[i] == _("--update")) {
+              update = true;
+            } else if (args[i] == _("--parse")) {
+              parse_scripts = true;
+            } else if (args[i] == _("--keywords")) {
+              keywords = true;
+            } else {
+              out = args[i];
+            }
+          }
+          boost::json::object result;
+          if (load) {
+            result = benchmark_load_set(args[1], repeat);
+          } else if (update) {
+            result = benchmark_update_all(import_set(args[1]), repeat, jobs, consistent);
+          } else if (parse_scripts) {
+            result = benchmark_parse_set(args[1], repeat);
+          } else if (keywords) {
+            result = benchmark_keywords(import_set(args[1]), repeat, consistent);
+          } else {
+            SetP set = import_set(args[1]);
+            // warnings from loading the set are shown now, so they are not counted as warnings of the script
+            cli.print_pending_errors();
+            result = script.empty()
+              ? benchmark_export_image(set, repeat)
+              : benchmark_script_file(script, set, repeat, consistent);
+          }
+          write_report(out, result);
+          if (!consistent) {
+            handle_error(Error(keywords ? _("The keyword matcher found different matches than trying every keyword")
+                             : update   ? _("Updating the cards in parallel gave different values than updating them one at a time, or used only one thread")
+                                        : _("The benchmark script gave warnings or errors")));
+            return EXIT_FAILURE;
+          }
+          return EXIT_SUCCESS;
+        } else if (arg == _("--benchmark-blend")) {
+          int repeat = 1;
+          String out;
+          for (size_t i = 1 ; i < args.size() ; ++i) {
+            long n = 0;
+            if (args[i] == _("--repeat") && i + 1 < args.size() && args[i + 1].ToLong(&n) && n > 0) {
+              repeat = (int)n;
+              ++i;
+            } else {
+              out = args[i];
+            }
+          }
+          bool exact = true;
+          write_report(out, benchmark_blend(repeat, exact));
+          if (!exact) {
+            handle_error(Error(_("The vectorized blending kernels gave different results than the scalar code, or different generated images were shared")));
+            return EXIT_FAILURE;
+          }
+          return EXIT_SUCCESS;
+        } else if (arg == _("--benchmark-resample")) {
+          int repeat = 1;
+          String out;
+          for (size_t i = 1 ; i < args.size() ; ++i) {
+            long n = 0;
+            if (args[i] == _("--repeat") && i + 1 < args.size() && args[i + 1].ToLong(&n) && n > 0) {
+              repeat = (int)n;
+              ++i;
+            } else {
+              out = args[i];
+            }
+          }
+          bool exact = true;
+          write_report(out, benchmark_resample(repeat, exact));
+          if (!exact) {
+            handle_error(Error(_("The image resampler gave different results than the original resampler")));
+            return EXIT_FAILURE;
+          }
           return EXIT_SUCCESS;
         } else if (args[0] == _("--export")) {
           if (args.size() < 2) {
@@ -296,6 +451,7 @@ int MSE::runGUI() {
 int MSE::OnExit() {
   thumbnail_thread.abortAll();
   settings.write();
+  script_cache.write();
   package_manager.destroy();
   SpellChecker::destroyAll();
   return 0;
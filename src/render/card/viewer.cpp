@@ -28,9 +28,7 @@ DataViewer::~DataViewer() {}
 IMPLEMENT_DYNAMIC_ARG(bool, drawing_card, false);
 
 void DataViewer::draw(DC& dc) {
-  StyleSheetSettings& ss = settings.stylesheetSettingsFor(*stylesheet);
-  RotatedDC rdc(dc, getRotation(),
-                nativeLook() ? QUALITY_LOW : (ss.card_anti_alias() ? QUALITY_AA : QUALITY_SUB_PIXEL));
+  RotatedDC rdc(dc, getRotation(), renderQuality());
   draw(rdc, stylesheet->card_background);
 }
 void DataViewer::draw(RotatedDC& dc, const Color& background) {
@@ -38,6 +36,36 @@ void DataViewer::draw(RotatedDC& dc, const Color& background) {
   WITH_DYNAMIC_ARG(drawing_card, true);
   // fill with background color
   clearDC(dc.getDC(), background);
+  prepareViewers(dc);
+  // draw viewers
+  FOR_EACH(v, viewers) { // draw low z index fields first
+    if (v->isVisible()) {// visible
+      Rotater r(dc, v->getRotation());
+      try {
+        drawViewer(dc, *v);
+      } catch (const Error& e) {
+        handle_error(e);
+      }
+    }
+  }
+}
+void DataViewer::drawViewer(RotatedDC& dc, ValueViewer& v) {
+  v.draw(dc);
+}
+
+void DataViewer::prepare(DC& dc) {
+  if (!set) return;
+  WITH_DYNAMIC_ARG(drawing_card, true);
+  RotatedDC rdc(dc, getRotation(), renderQuality());
+  prepareViewers(rdc);
+}
+
+RenderQuality DataViewer::renderQuality() const {
+  StyleSheetSettings& ss = settings.stylesheetSettingsFor(*stylesheet);
+  return nativeLook() ? QUALITY_LOW : (ss.card_anti_alias() ? QUALITY_AA : QUALITY_SUB_PIXEL);
+}
+
+void DataViewer::prepareViewers(RotatedDC& dc) {
   // update style scripts
   updateStyles(false);
   // prepare viewers
@@ -57,20 +85,6 @@ void DataViewer::draw(RotatedDC& dc, const Color& background) {
   if (changed_content_properties) {
     updateStyles(true);
   }
-  // draw viewers
-  FOR_EACH(v, viewers) { // draw low z index fields first
-    if (v->isVisible()) {// visible
-      Rotater r(dc, v->getRotation());
-      try {
-        drawViewer(dc, *v);
-      } catch (const Error& e) {
-        handle_error(e);
-      }
-    }
-  }
-}
-void DataViewer::drawViewer(RotatedDC& dc, ValueViewer& v) {
-  v.draw(dc);
 }
 
 void DataViewer::updateStyles(bool only_content_dependent) {
@@ -102,6 +116,10 @@ DrawWhat DataViewer::drawWhat(const ValueViewer*) const {
   return (DrawWhat)(DRAW_NORMAL | nativeLook() * DRAW_NATIVELOOK);
 }
 
+ResampleFilter DataViewer::resampleFilter() const {
+  return RESAMPLE_BOX;
+}
+
 bool DataViewer::viewerIsCurrent(const ValueViewer*) const {
   return false;
 }
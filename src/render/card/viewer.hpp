@@ -35,6 +35,9 @@ public:
   virtual void draw(RotatedDC& dc, const Color& background);
   /// Draw a single viewer
   virtual void drawViewer(RotatedDC& dc, ValueViewer& v);
+  /// Update the styles and prepare the viewers for the current card, like draw() does, but without drawing
+  /** Editing needs prepared viewers, this is enough when the image of the card is already known */
+  void prepare(DC& dc);
   
   // --------------------------------------------------- : Utility for ValueViewers
   
@@ -50,6 +53,9 @@ public:
   Context& getContext() const;
   /// The rotation to use
   virtual Rotation getRotation() const;
+  /// Filter to use when resizing images
+  /** The box filter by default, viewers for printing and exporting can use a better but slower one */
+  virtual ResampleFilter resampleFilter() const;
   /// The card we are viewing, can be null
   inline const CardP& getCard() const { return card; }
   /// Invalidate and redraw (the area of) a single value viewer
@@ -75,9 +81,13 @@ public:
 private:
   /// Create some viewers for the given styles
   void addStyles(IndexMap<FieldP,StyleP>& styles);
-  /// Update style scripts
-  void updateStyles(bool only_content_dependent);
+  /// Update the styles and prepare all visible viewers
+  void prepareViewers(RotatedDC& dc);
+  /// Quality to draw with, from the settings of the stylesheet
+  RenderQuality renderQuality() const;
 protected:
+  /// Update style scripts
+  virtual void updateStyles(bool only_content_dependent);
   /// Set the styles for the data to be shown, recreating the viewers
   void setStyles(const StyleSheetP& stylesheet, IndexMap<FieldP,StyleP>& styles, IndexMap<FieldP,StyleP>* extra_styles = nullptr);
   /// Set the data to be shown in the viewers, refresh them
@@ -8,6 +8,7 @@
 
 #include <util/prec.hpp>
 #include <render/text/element.hpp>
+#include <render/text/layout_cache.hpp>
 #include <data/font.hpp>
 
 // ----------------------------------------------------------------------------- : FontTextElement
@@ -31,9 +32,21 @@ void FontTextElement::draw(RotatedDC& dc, double scale, const RealRect& rect, co
   if (native_look) font->color = font_color;
 }
 
+// Measured characters, with the same font and zoom the same text always has the same sizes
+LruCache<vector<CharInfo>> char_info_cache(4096, text_measure_cache_counter);
+
 void FontTextElement::getCharInfo(RotatedDC& dc, double scale, vector<CharInfo>& out) const {
   // font
   dc.SetFont(*font, scale);
+  // measured before?
+  String key = dc.textExtentKey();
+  key << _('|') << (int)break_style << _('|') << (int)(draw_as == DRAW_ACTIVE) << _('|') << content;
+  vector<CharInfo> cached;
+  if (char_info_cache.find(key, cached)) {
+    out.insert(out.end(), cached.begin(), cached.end());
+    return;
+  }
+  size_t first = out.size();
   // find sizes & breaks
   double prev_width = 0;
   size_t line_start = start; // start of the current line
@@ -53,6 +66,7 @@ void FontTextElement::getCharInfo(RotatedDC& dc, double scale, vector<CharInfo>&
       prev_width = s.width;
     }
   }
+  char_info_cache.store(key, vector<CharInfo>(out.begin() + first, out.end()));
 }
 
 double FontTextElement::minScale() const {
@@ -0,0 +1,15 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <render/text/layout_cache.hpp>
+
+// ----------------------------------------------------------------------------- : Text layout caches
+
+CacheCounter text_measure_cache_counter;
+CacheCounter text_layout_cache_counter;
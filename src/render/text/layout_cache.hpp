@@ -0,0 +1,19 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/lru_cache.hpp>
+
+// ----------------------------------------------------------------------------- : Text layout caches
+
+/// Lookups of measured characters, in FontTextElement::getCharInfo
+extern CacheCounter text_measure_cache_counter;
+/// Lookups of complete layouts, in TextViewer::prepareLines
+extern CacheCounter text_layout_cache_counter;
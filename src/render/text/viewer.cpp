@@ -8,6 +8,8 @@
 
 #include <util/prec.hpp>
 #include <render/text/viewer.hpp>
+#include <render/text/layout_cache.hpp>
+#include <util/stage_timer.hpp>
 #include <algorithm>
 
 // ----------------------------------------------------------------------------- : Line
@@ -156,6 +158,7 @@ void TextViewer::drawSeparators(RotatedDC& dc) {
 bool TextViewer::prepare(RotatedDC& dc, const String& text, TextStyle& style, Context& ctx) {
   if (!prepared()) {
     // not prepared yet
+    StageTimer timer(STAGE_TEXT_LAYOUT);
     prepareElements(text, style, ctx);
     prepareLines(dc, text, style, ctx);
     return true;
@@ -389,9 +392,57 @@ TextLayoutP TextViewer::extractLayoutInfo() const {
   return layout;
 }
 
+// A layout found by prepareLinesTryScales
+struct CachedTextLayout {
+  double                   scale;
+  vector<CharInfo>         chars;
+  vector<TextViewer::Line> lines;
+};
+
+// Layouts of text, so when showing the same text in the same box again the scale doesn't have to be searched
+LruCache<CachedTextLayout> text_layout_cache(512, text_layout_cache_counter);
+
+String TextViewer::layoutKey(RotatedDC& dc, const String& text, const TextStyle& style) const {
+  // the mask can change without the style changing, don't cache those layouts
+  if (style.mask.getFromCache().isLoaded()) return String();
+  // everything that the layout depends on
+  dc.SetFont(style.font, 1.0);
+  String key = dc.textExtentKey();
+  RealSize size = dc.getInternalSize();
+  key << String::Format(_("|%llu|%.17g|%.17g|%d|%d"), (unsigned long long)style.layout_id.get(), size.width, size.height,
+                        (int)style.field().multi_line, (int)style.direction);
+  const Scriptable<double>* params[] = {
+    &style.padding_left,  &style.padding_left_min,  &style.padding_right,  &style.padding_right_min,
+    &style.padding_top,   &style.padding_top_min,   &style.padding_bottom, &style.padding_bottom_min,
+    &style.line_height_soft,     &style.line_height_hard,     &style.line_height_line,
+    &style.line_height_soft_max, &style.line_height_hard_max, &style.line_height_line_max,
+    &style.paragraph_height
+  };
+  for (const Scriptable<double>* p : params) {
+    key << String::Format(_("|%.17g"), (double)*p);
+  }
+  key << String::Format(_("|%.17g|%.17g|%.17g"), style.font.scale_down_to, style.font.max_stretch, (double)style.symbol_font.size);
+  key << _('|') << style.symbol_font.name() << _('|') << text;
+  return key;
+}
+
 void TextViewer::prepareLines(RotatedDC& dc, const String& text, TextStyle& style, Context& ctx) {
   vector<CharInfo> chars;
-  prepareLinesTryScales(dc, text, style, chars);
+  String key = layoutKey(dc, text, style);
+  CachedTextLayout cached;
+  if (!key.empty() && text_layout_cache.find(key, cached)) {
+    scale = cached.scale;
+    swap(chars, cached.chars);
+    swap(lines, cached.lines);
+  } else {
+    prepareLinesTryScales(dc, text, style, chars);
+    if (!key.empty()) {
+      cached.scale = scale;
+      cached.chars = chars;
+      cached.lines = lines;
+      text_layout_cache.store(key, cached);
+    }
+  }
   assert(!lines.empty());
   
   // no text, find a dummy height for the single line we have
@@ -135,6 +135,9 @@ private:
   
   /// Prepare the lines, layout the text
   void prepareLines(RotatedDC& dc, const String& text, TextStyle& style, Context& ctx);
+  /// Key for the layout cache, the same key always gives the same result from prepareLinesTryScales
+  /** Returns an empty string if the layout should not be cached */
+  String layoutKey(RotatedDC& dc, const String& text, const TextStyle& style) const;
   /// Find the scale to use for the text
   void prepareLinesTryScales(RotatedDC& dc, const String& text, const TextStyle& style, vector<CharInfo>& chars_out);
   /// Prepare the lines, layout the text; at a specific scale
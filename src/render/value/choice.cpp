@@ -126,6 +126,7 @@ void get_options(Rotation& rot, ValueViewer& viewer, const ChoiceStyle& style, G
   opts.package       = &viewer.getStylePackage();
   opts.local_package = &viewer.getLocalPackage();
   opts.angle         = rot.getAngle();
+  opts.filter        = viewer.resampleFilter();
   if (viewer.nativeLook()) {
     opts.width = opts.height = 16;
     opts.preserve_aspect = ASPECT_BORDER;
@@ -34,7 +34,7 @@ void ImageValueViewer::draw(RotatedDC& dc) {
       try {
         auto image_file = getLocalPackage().openIn(value().filename);
         if (image_load_file(image, *image_file)) {
-          image.Rescale(w, h);
+          image = resample(image, w, h, resampleFilter());
         }
       } CATCH_ALL_ERRORS(false);
     }
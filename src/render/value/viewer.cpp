@@ -113,6 +113,9 @@ bool ValueViewer::nativeLook() const {
 DrawWhat ValueViewer::drawWhat() const {
   return parent.drawWhat(this);
 }
+ResampleFilter ValueViewer::resampleFilter() const {
+  return parent.resampleFilter();
+}
 bool ValueViewer::isCurrent() const {
   return parent.viewerIsCurrent(this);
 }
@@ -99,6 +99,8 @@ public:
   bool nativeLook() const;
   /// What elements to draw
   DrawWhat drawWhat() const;
+  /// Filter to use when resizing images
+  ResampleFilter resampleFilter() const;
   /// Is this the currently selected viewer?
   /** Usually only the editor allows selection of viewers */
   bool isCurrent() const;
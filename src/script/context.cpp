@@ -114,7 +114,14 @@ ScriptValueP Context::eval(const Script& script, bool useScope) {
         
         // Get an object member
         case I_MEMBER_C: {
-          stack.back() = stack.back()->getMember(script.constants[i.data]->toString());
+          stack.back() = stack.back()->getMemberCached(script.constants[i.data]->toString(), script.member_caches[i.data]);
+          break;
+        }
+        // Get a member of a variable
+        case I_GET_VAR_MEMBER_C: {
+          ScriptValueP value = variables[packed_var(i)].value;
+          if (!value) throw ScriptErrorNoVariable(variable_to_string(packed_var(i)));
+          stack.push_back(value->getMemberCached(script.constants[packed_const(i)]->toString(), script.member_caches[packed_const(i)]));
           break;
         }
         // Loop over a container, push next value or jump
@@ -495,7 +502,7 @@ void instrBinary (BinaryInstructionType  i, ScriptValueP& a, const ScriptValueP&
                  (bt == SCRIPT_INT || bt == SCRIPT_DOUBLE)) {
         a = to_script(a->toDouble() + b->toDouble());
       } else {
-        a = to_script(a->toString() + b->toString());
+        a = concat_script_strings(a, b);
       }
       break;
     case I_SUB:    OPERATOR_DI(-);
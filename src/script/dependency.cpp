@@ -228,6 +228,17 @@ ScriptValueP Context::dependencies(const Dependency& dep, const Script& script)
           stack.back() = stack.back()->dependencyMember(name, dep); // dependency on member
           break;
         }
+        // Get a member of a variable (same as I_GET_VAR followed by I_MEMBER_C)
+        case I_GET_VAR_MEMBER_C: {
+          ScriptValueP value = variables[packed_var(i)].value;
+          if (!value) {
+            value = make_intrusive<ScriptMissingVariable>(variable_to_string(packed_var(i))); // no errors here
+          }
+          value->dependencyThis(dep);
+          String name = script.constants[packed_const(i)]->toString();
+          stack.push_back(value->dependencyMember(name, dep)); // dependency on member
+          break;
+        }
         // Loop over a container, push next value or jump (almost as normal)
         case I_LOOP: {
           ScriptValueP& it = stack[stack.size() - 2]; // second element of stack
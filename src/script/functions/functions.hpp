@@ -16,6 +16,7 @@
 #include <util/prec.hpp>
 
 class Context;
+struct CacheCounter;
 
 // ----------------------------------------------------------------------------- : Script functions
 
@@ -28,6 +29,11 @@ void init_script_english_functions(Context& ctx);
 void init_script_spelling_functions(Context& ctx);
 void init_script_construction_functions(Context& ctx);
 
+/// Lookups in the cache of compiled regular expressions (in regex.cpp)
+extern CacheCounter regex_cache_counter;
+/// Number of compiled regular expressions in the cache
+size_t regex_cache_size();
+
 /// Initialize all built in functions for a context
 inline void init_script_functions(Context& ctx) {
   init_script_basic_functions(ctx);
@@ -10,6 +10,7 @@
 #include <script/functions/functions.hpp>
 #include <script/functions/util.hpp>
 #include <util/regex.hpp>
+#include <util/lru_cache.hpp>
 #include <util/error.hpp>
 
 DECLARE_POINTER_TYPE(ScriptRegex);
@@ -53,12 +54,24 @@ public:
   using Regex::matches;
 };
 
+// Compiled regular expressions, scripts often build the same pattern for every card.
+// Matching doesn't change a regex, so they can be shared between evaluations and threads.
+CacheCounter regex_cache_counter;
+LruCache<ScriptRegexP> regex_cache(256, regex_cache_counter);
+
+size_t regex_cache_size() {
+  return regex_cache.size();
+}
+
 ScriptRegexP regex_from_script(const ScriptValueP& value) {
   // is it a regex already?
   ScriptRegexP regex = dynamic_pointer_cast<ScriptRegex>(value);
   if (!regex) {
-    // TODO: introduce some kind of caching?
-    regex = make_intrusive<ScriptRegex>(value->toString());
+    String code = value->toString();
+    if (!regex_cache.find(code, regex)) {
+      regex = make_intrusive<ScriptRegex>(code);
+      regex_cache.store(code, regex);
+    }
   }
   return regex;
 }
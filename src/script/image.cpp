@@ -14,10 +14,12 @@
 #include <util/io/package.hpp>
 #include <gfx/generated_image.hpp>
 #include <data/field/image.hpp>
+#include <util/stage_timer.hpp>
 
 // ----------------------------------------------------------------------------- : ScriptableImage
 
 Image ScriptableImage::generate(const GeneratedImage::Options& options) const {
+  StageTimer timer(STAGE_IMAGE_GENERATE);
   // generate
   Image image;
   if (isReady()) {
@@ -25,7 +27,7 @@ Image ScriptableImage::generate(const GeneratedImage::Options& options) const {
     //       We could return a blank one, but the thumbnail code does want an invalid
     //       image in case of errors.
     //       This allows the caller to catch errors.
-    image = value->generate(options);
+    image = value->generateShared(options);
   } else {
     // error, return blank image
     Image i(1,1);
@@ -0,0 +1,232 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <script/script.hpp>
+#include <script/to_value.hpp>
+#include <util/error.hpp>
+
+// Simple instructions, defined in context.cpp
+void instrUnary  (UnaryInstructionType   i, ScriptValueP& a);
+void instrBinary (BinaryInstructionType  i, ScriptValueP& a, const ScriptValueP& b);
+
+// ----------------------------------------------------------------------------- : Utilities
+
+/// Is the instruction a jump, i.e. is its data an address?
+bool is_jump(InstructionType t) {
+  return t == I_JUMP
+      || t == I_JUMP_IF_NOT
+      || t == I_JUMP_SC_AND
+      || t == I_JUMP_SC_OR
+      || t == I_LOOP
+      || t == I_LOOP_WITH_KEY;
+}
+
+/// Is the instruction followed by n I_NOPs holding argument names?
+bool has_arguments(InstructionType t) {
+  return t == I_CALL
+      || t == I_CLOSURE
+      || t == I_TAILCALL;
+}
+
+/// Can simple instructions on this value be evaluated at parse time?
+/** Only for the plain values, functions and collections can behave differently every time.
+ */
+bool is_foldable(const ScriptValueP& value) {
+  ScriptType t = value->type();
+  return t == SCRIPT_NIL
+      || t == SCRIPT_INT
+      || t == SCRIPT_BOOL
+      || t == SCRIPT_DOUBLE
+      || t == SCRIPT_STRING;
+}
+
+/// Is it safe to evaluate a binary instruction at parse time?
+bool is_foldable(BinaryInstructionType i, const ScriptValueP& a, const ScriptValueP& b) {
+  if (!is_foldable(a) || !is_foldable(b)) return false;
+  switch (i) {
+    case I_ITERATOR_R: case I_MEMBER: case I_OR_ELSE:
+      return false;
+    case I_DIV: case I_MOD:
+      // integer division by zero is not an exception, leave that for run time
+      return a->type() == SCRIPT_DOUBLE || b->type() == SCRIPT_DOUBLE || b->toInt() != 0;
+    default:
+      return true;
+  }
+}
+
+/// Does the instruction always leave a boolean on the stack?
+/** Then converting that value to a boolean can't fail */
+bool gives_boolean(const Instruction& i, const vector<ScriptValueP>& constants) {
+  if (i.instr == I_PUSH_CONST) return constants[i.data]->type() == SCRIPT_BOOL;
+  if (i.instr == I_UNARY)      return i.instr1 == I_NOT;
+  if (i.instr == I_BINARY) {
+    switch (i.instr2) {
+      case I_EQ: case I_NEQ: case I_LT: case I_GT: case I_LE: case I_GE:
+        return true;
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+// ----------------------------------------------------------------------------- : Optimizer
+
+void Script::optimize() {
+  // each step can make new optimizations possible (for instance folding 1+2+3)
+  while (optimizeStep()) {}
+  removeUnusedConstants();
+}
+
+bool Script::optimizeStep() {
+  const size_t n = instructions.size();
+  // only optimize complete scripts
+  FOR_EACH_CONST(i, instructions) {
+    if (is_jump(i.instr) && i.data > n) return false;
+  }
+  bool changed = false;
+  // thread jumps: a jump to a jump can go to the final target directly
+  // only forward, because the dependency analysis expects all backward jumps to belong to loops
+  FOR_EACH(i, instructions) {
+    if (i.instr != I_JUMP) continue;
+    for (size_t steps = 0 ; steps < n && i.data < n ; ++steps) {
+      const Instruction& next = instructions[i.data];
+      if (next.instr != I_JUMP || next.data <= i.data) break;
+      i.data = next.data;
+      changed = true;
+    }
+  }
+  // which instructions are jumped to?
+  // we can't remove or combine instructions that are jump targets, except for the first in a sequence
+  vector<bool> is_target(n + 1, false);
+  FOR_EACH_CONST(i, instructions) {
+    if (is_jump(i.instr)) is_target[i.data] = true;
+  }
+  // can instruction pos be combined with the ones before it, and does it have the given type?
+  auto at = [&](size_t pos, InstructionType t) {
+    return pos < n && !is_target[pos] && instructions[pos].instr == t;
+  };
+  // rewrite instructions
+  vector<Instruction> out;
+  out.reserve(n);
+  vector<unsigned int> new_pos(n + 1);
+  for (size_t pos = 0 ; pos < n ; ) {
+    new_pos[pos] = (unsigned int)out.size();
+    Instruction i = instructions[pos];
+    if (has_arguments(i.instr)) {
+      // copy the call and its argument names
+      for (size_t j = 0 ; j <= i.data ; ++j) {
+        new_pos[pos + j] = (unsigned int)out.size();
+        out.push_back(instructions[pos + j]);
+      }
+      pos += i.data + 1;
+      continue;
+    }
+    if (i.instr == I_PUSH_CONST && at(pos + 1, I_UNARY) && is_foldable(constants[i.data])
+        && instructions[pos + 1].instr1 != I_ITERATOR_C) {
+      // constant folding:  push a; unary op  -->  push (op a)
+      ScriptValueP a = constants[i.data];
+      try {
+        instrUnary(instructions[pos + 1].instr1, a);
+        Instruction c = {I_PUSH_CONST, {addConstant(a)}};
+        out.push_back(c);
+        pos += 2;
+        changed = true;
+        continue;
+      } catch (const Error&) {
+        // leave the error for run time
+      }
+    }
+    if (i.instr == I_PUSH_CONST && at(pos + 1, I_PUSH_CONST) && at(pos + 2, I_BINARY)
+        && is_foldable(instructions[pos + 2].instr2, constants[i.data], constants[instructions[pos + 1].data])) {
+      // constant folding:  push a; push b; binary op  -->  push (a op b)
+      ScriptValueP a = constants[i.data];
+      try {
+        instrBinary(instructions[pos + 2].instr2, a, constants[instructions[pos + 1].data]);
+        Instruction c = {I_PUSH_CONST, {addConstant(a)}};
+        out.push_back(c);
+        pos += 3;
+        changed = true;
+        continue;
+      } catch (const Error&) {
+        // leave the error for run time
+      }
+    }
+    if ((i.instr == I_PUSH_CONST || i.instr == I_DUP) && at(pos + 1, I_POP)) {
+      // value is not used:  push x; pop  -->  nothing
+      pos += 2;
+      changed = true;
+      continue;
+    }
+    if (i.instr == I_SET_VAR && at(pos + 1, I_POP) && at(pos + 2, I_GET_VAR) && instructions[pos + 2].data == i.data) {
+      // "x := a; x":  set x; pop; get x  -->  set x
+      out.push_back(i);
+      pos += 3;
+      changed = true;
+      continue;
+    }
+    if (i.instr == I_JUMP && i.data == pos + 1) {
+      // jump to the next instruction
+      pos += 1;
+      changed = true;
+      continue;
+    }
+    if (i.instr == I_JUMP_IF_NOT && i.data == pos + 1 && pos > 0 && !is_target[pos]
+        && gives_boolean(instructions[pos - 1], constants)) {
+      // conditional jump to the next instruction, only the pop remains
+      // the condition must be a boolean, otherwise the jump gives an error that we would lose
+      Instruction p = {I_POP, {0}};
+      out.push_back(p);
+      pos += 1;
+      changed = true;
+      continue;
+    }
+    if (i.instr == I_GET_VAR && at(pos + 1, I_MEMBER_C) && can_pack_var_const(i.data, instructions[pos + 1].data)) {
+      // superinstruction:  get x; member_c y  -->  get_member_c x y
+      Instruction c = {I_GET_VAR_MEMBER_C, {pack_var_const(i.data, instructions[pos + 1].data)}};
+      out.push_back(c);
+      pos += 2;
+      changed = true;
+      continue;
+    }
+    out.push_back(i);
+    pos += 1;
+  }
+  new_pos[n] = (unsigned int)out.size();
+  // update jump targets
+  FOR_EACH(i, out) {
+    if (is_jump(i.instr)) i.data = new_pos[i.data];
+  }
+  instructions.swap(out);
+  return changed;
+}
+
+void Script::removeUnusedConstants() {
+  vector<unsigned int> new_index(constants.size(), (unsigned int)-1);
+  vector<ScriptValueP> used;
+  auto use = [&](unsigned int c) -> unsigned int {
+    if (new_index[c] == (unsigned int)-1) {
+      new_index[c] = (unsigned int)used.size();
+      used.push_back(constants[c]);
+    }
+    return new_index[c];
+  };
+  for (size_t pos = 0 ; pos < instructions.size() ; ++pos) {
+    Instruction& i = instructions[pos];
+    if (i.instr == I_PUSH_CONST || i.instr == I_MEMBER_C) {
+      i.data = use(i.data);
+    } else if (i.instr == I_GET_VAR_MEMBER_C) {
+      i.data = pack_var_const(packed_var(i), use(packed_const(i)));
+    } else if (has_arguments(i.instr)) {
+      pos += i.data; // skip argument names
+    }
+  }
+  constants.swap(used);
+  member_caches = vector<MemberCache>(constants.size());
+}
@@ -14,6 +14,7 @@
 #include <util/tagged_string.hpp>
 #include <util/io/package_manager.hpp> // for "include file" semi hack
 #include <stack>
+#include <deque>
 
 #ifdef __WXMSW__
 #define TokenType TokenType_ // some stupid windows header uses our name
@@ -39,18 +40,25 @@ enum TokenType
 };
 
 /// Tokens produced by the TokenIterator
+/** The text of a token is a view of the input, or of a constant for tokens that are not in the input,
+ *  so reading and copying tokens doesn't allocate memory.
+ *  Only string constants with escape sequences have their value stored separately, in the TokenIterator.
+ */
 struct Token {
-  TokenType type;
-  String    value;
-  bool      newline; ///< Is there a newline between this token and the previous one?
+  TokenType  type;
+  StringView text;    ///< Text of the token, for strings this is the value of the string constant
+  bool       newline; ///< Is there a newline between this token and the previous one?
   String::const_iterator pos; ///< Start position of the token
   
+  /// The text of the token as a string
+  inline String value() const { return text; }
+  
   inline bool operator == (TokenType     t) const { return type  == t; }
   inline bool operator != (TokenType     t) const { return type  != t; }
-  inline bool operator == (const String& s) const { return type != TOK_STRING && value == s; }
-  inline bool operator != (const String& s) const { return type == TOK_STRING || value != s; }
-  inline bool operator == (const Char*   s) const { return type != TOK_STRING && value == s; }
-  inline bool operator != (const Char*   s) const { return type == TOK_STRING || value != s; }
+  inline bool operator == (const String& s) const { return type != TOK_STRING && text == StringView(s); }
+  inline bool operator != (const String& s) const { return type == TOK_STRING || !(text == StringView(s)); }
+  inline bool operator == (const Char*   s) const { return type != TOK_STRING && text == s; }
+  inline bool operator != (const Char*   s) const { return type == TOK_STRING || !(text == s); }
 };
 
 enum OpenBrace 
@@ -84,12 +92,15 @@ private:
   String::const_iterator pos;
   const String::const_iterator begin, end;
   String const&    filename; ///< Filename of include files, "" for the main input
-  vector<Token>    buffer; ///< buffer of unread tokens, front() = current
+  deque<Token>     buffer; ///< buffer of unread tokens, front() = current
+  deque<String>    strings; ///< values of string tokens that are not a part of the input, tokens refer to these
   stack<OpenBrace> open_braces; ///< braces/quotes we entered from script mode
   bool             newline; ///< Did we just pass a newline?
   
   /// Add a token to the buffer, with the current newline value, resets newline
-  void addToken(TokenType type, const String& value, String::const_iterator start);
+  void addToken(TokenType type, StringView text, String::const_iterator start);
+  /// Add a string token with a value that is not a part of the input
+  void addStringToken(String&& value, String::const_iterator start);
   /// Read the next token, and add it to the buffer
   void readToken();
   /// Read the next token, which is a string
@@ -116,14 +127,63 @@ bool isUnicodeAlpha(wxUniChar c) {
   #endif
 }
 
-bool isAlpha_(wxUniChar c) { return isAlpha(c) || c==_('_'); }
 bool isAlnum_(wxUniChar c) { return isAlnum(c) || c==_('_') || isUnicodeAlpha(c); }
-bool isOper  (wxUniChar c) { return wxStrchr(_("+-*/!.@%^&:=<>;,"),c) != nullptr; }
-bool isLparen(wxUniChar c) { return c==_('(') || c==_('[') || c==_('{'); }
-bool isRparen(wxUniChar c) { return c==_(')') || c==_(']') || c==_('}'); }
-bool isDigitOrDot(wxUniChar c) { return isDigit(c) || c==_('.'); }
 bool isLongOper(StringView s) { return s==_(":=") || s==_("==") || s==_("!=") || s==_("<=") || s==_(">=") || s==_("->"); }
 
+/// Classes of characters for the tokenizer
+enum CharClass
+{  CHAR_OTHER  = 0x00
+,  CHAR_SPACE  = 0x01 // whitespace, except for newlines
+,  CHAR_ALPHA  = 0x02 // start of a name
+,  CHAR_DIGIT  = 0x04
+,  CHAR_OPER   = 0x08
+,  CHAR_LPAREN = 0x10
+,  CHAR_RPAREN = 0x20
+};
+
+/// Classes of the ASCII characters, so a character can be classified with a single lookup
+struct CharClassTable {
+  unsigned char classes[128];
+  CharClassTable() {
+    fill(classes, classes + 128, (unsigned char)CHAR_OTHER);
+    for (const char* c = " \t\r\v\f"          ; *c ; ++c) classes[(int)*c] = CHAR_SPACE;
+    for (const char* c = "+-*/!.@%^&:=<>;,"   ; *c ; ++c) classes[(int)*c] = CHAR_OPER;
+    for (const char* c = "([{"                ; *c ; ++c) classes[(int)*c] = CHAR_LPAREN;
+    for (const char* c = ")]}"                ; *c ; ++c) classes[(int)*c] = CHAR_RPAREN;
+    for (int c = 'a' ; c <= 'z' ; ++c) classes[c] = CHAR_ALPHA;
+    for (int c = 'A' ; c <= 'Z' ; ++c) classes[c] = CHAR_ALPHA;
+    for (int c = '0' ; c <= '9' ; ++c) classes[c] = CHAR_DIGIT;
+    classes[(int)'_'] = CHAR_ALPHA;
+  }
+};
+const CharClassTable char_class_table;
+
+inline int char_class(wxUniChar c) {
+  if (c < 128) return char_class_table.classes[c.GetValue()];
+  // other characters are rare, use the slow functions
+  if (isSpace(c)) return CHAR_SPACE;
+  if (isAlpha(c) || isUnicodeAlpha(c)) return CHAR_ALPHA;
+  if (isDigit(c)) return CHAR_DIGIT;
+  return CHAR_OTHER;
+}
+/// Can the character be part of a name (after the first character)?
+inline bool is_name_char(wxUniChar c) {
+  return c < 128 ? (char_class_table.classes[c.GetValue()] & (CHAR_ALPHA | CHAR_DIGIT)) != 0 : isAlnum_(c);
+}
+/// Can the character be part of a number?
+inline bool is_number_char(wxUniChar c) {
+  return c < 128 && (c == _('.') || char_class_table.classes[c.GetValue()] == CHAR_DIGIT);
+}
+
+// Text of tokens that don't come from the input
+const String TOKEN_TEXT_NONE         = _("");
+const String TOKEN_TEXT_EOF          = _("end of input");
+const String TOKEN_TEXT_INCLUDE_FILE = _("include_file");
+const String TOKEN_TEXT_LPAREN       = _("(");
+const String TOKEN_TEXT_RPAREN       = _(")");
+const String TOKEN_TEXT_STRING_LBRACE = _("\"{");
+const String TOKEN_TEXT_STRING_RBRACE = _("}\"");
+
 // moveme
 // ----------------------------------------------------------------------------- : Tokenizing
 
@@ -132,8 +192,8 @@ TokenIterator::TokenIterator(const String& str, Packaged* package, bool string_m
   , begin(str.begin())
   , end(str.end())
   , filename(filename)
-  , package(package)
   , newline(false)
+  , package(package)
   , errors(errors)
 {
   if (string_mode) {
@@ -152,91 +212,98 @@ const Token& TokenIterator::peek(size_t offset) {
 }
 
 const Token& TokenIterator::read() {
-  if (!buffer.empty()) buffer.erase(buffer.begin());
+  if (!buffer.empty()) buffer.pop_front();
   return peek(0);
 }
 
 void TokenIterator::putBack() {
   // Don't use addToken, because it changes newline
   // Also, we want to push_front
-  Token t = {TOK_DUMMY, _(""), false};
-  buffer.insert(buffer.begin(), t);
+  Token t = {TOK_DUMMY, StringView(TOKEN_TEXT_NONE), false, pos};
+  buffer.push_front(t);
 }
 
-void TokenIterator::addToken(TokenType type, const String& value, String::const_iterator start) {
-  Token t = {type, value, newline, start};
+void TokenIterator::addToken(TokenType type, StringView text, String::const_iterator start) {
+  Token t = {type, text, newline, start};
   buffer.push_back(t);
   newline = false;
 }
 
+void TokenIterator::addStringToken(String&& value, String::const_iterator start) {
+  // references to elements of a deque stay valid when adding more elements
+  strings.push_back(move(value));
+  addToken(TOK_STRING, StringView(strings.back()), start);
+}
+
 void TokenIterator::readToken() {
   if (pos == end) {
-    addToken(TOK_EOF, "end of input", pos);
+    addToken(TOK_EOF, StringView(TOKEN_TEXT_EOF), pos);
     return;
   }
   // read a character from the input
   auto c = *pos;
+  int cls = char_class(c);
   if (c == _('\n')) {
     ++pos;
     newline = true;
-  } else if (isSpace(c)) {
+  } else if (cls == CHAR_SPACE) {
     ++pos;
     // ignore
-  } else if (is_substr(pos, end, "include localized file:")) {
+  } else if (c == _('i') && is_substr(pos, end, "include localized file:")) {
     pos += 23; // "include localized file:"
     const char* newlines = "\r\n";
     auto eol = find_first_of(pos, end, newlines, newlines + 2);
     String include_file = trim(StringView(pos, eol)) + _("_") + settings.locale;
     // include_file("filename_en")
-    addToken(TOK_NAME, "include_file", pos - 23);
-    addToken(TOK_LPAREN, "(", pos);
-    addToken(TOK_STRING, include_file, pos);
-    addToken(TOK_RPAREN, ")", eol);
+    addToken(TOK_NAME, StringView(TOKEN_TEXT_INCLUDE_FILE), pos - 23);
+    addToken(TOK_LPAREN, StringView(TOKEN_TEXT_LPAREN), pos);
+    addStringToken(move(include_file), pos);
+    addToken(TOK_RPAREN, StringView(TOKEN_TEXT_RPAREN), eol);
     pos = eol;
-  } else if (is_substr(pos, end, "include dark file:")) {
+  } else if (c == _('i') && is_substr(pos, end, "include dark file:")) {
     pos += 18; // "include dark file:"
     const char* newlines = "\r\n";
     auto eol = find_first_of(pos, end, newlines, newlines + 2);
     String include_file = trim(StringView(pos, eol)) + (settings.darkMode() ? _("_dark") : _(""));
     // include_file("filename_dark")
-    addToken(TOK_NAME, "include_file", pos - 18);
-    addToken(TOK_LPAREN, "(", pos);
-    addToken(TOK_STRING, include_file, pos);
-    addToken(TOK_RPAREN, ")", eol);
+    addToken(TOK_NAME, StringView(TOKEN_TEXT_INCLUDE_FILE), pos - 18);
+    addToken(TOK_LPAREN, StringView(TOKEN_TEXT_LPAREN), pos);
+    addStringToken(move(include_file), pos);
+    addToken(TOK_RPAREN, StringView(TOKEN_TEXT_RPAREN), eol);
     pos = eol;
-  } else if (is_substr(pos, end, "include file:")) {
+  } else if (c == _('i') && is_substr(pos, end, "include file:")) {
     pos += 13; // "include file:"
     const char* newlines = "\r\n";
     auto eol = find_first_of(pos,end, newlines,newlines+2);
-    String include_file = trim(StringView(pos, eol));
     // include_file("filename")
-    addToken(TOK_NAME, "include_file", pos - 13);
-    addToken(TOK_LPAREN, "(", pos);
-    addToken(TOK_STRING, include_file, pos);
-    addToken(TOK_RPAREN, ")", eol);
+    addToken(TOK_NAME, StringView(TOKEN_TEXT_INCLUDE_FILE), pos - 13);
+    addToken(TOK_LPAREN, StringView(TOKEN_TEXT_LPAREN), pos);
+    addToken(TOK_STRING, trim(StringView(pos, eol)), pos);
+    addToken(TOK_RPAREN, StringView(TOKEN_TEXT_RPAREN), eol);
     pos = eol;
-  } else if (isAlpha(c) || isUnicodeAlpha(c) || c == _('_') || (isDigit(c) && !buffer.empty() && buffer.back() == _("."))) {
+  } else if (cls == CHAR_ALPHA || (cls == CHAR_DIGIT && !buffer.empty() && buffer.back() == _("."))) {
     // name, or a number after a . token, as in array.0
+    // names can't contain spaces, so they are already in canonical form
     auto start = pos;
-    while (pos != end && isAlnum_(*pos)) ++pos;
-    addToken(TOK_NAME, canonical_name_form(String(start, pos)), start); // convert name to canonical form
-  } else if (isDigit(c)) {
+    while (pos != end && is_name_char(*pos)) ++pos;
+    addToken(TOK_NAME, StringView(start, pos), start);
+  } else if (cls == CHAR_DIGIT) {
     // number
     auto start = pos;
     TokenType type = TOK_INT;
-    while (pos != end && isDigitOrDot(*pos)) {
+    while (pos != end && is_number_char(*pos)) {
       if (*pos == '.') type = TOK_DOUBLE;
       ++pos;
     }
-    addToken(type, String(start,pos), start);
-  } else if (isOper(c)) {
+    addToken(type, StringView(start, pos), start);
+  } else if (cls == CHAR_OPER) {
     // operator
     if (pos+1 != end && isLongOper(StringView(pos, pos+2))) {
       // long operator
-      addToken(TOK_OPER, String(pos, pos+2), pos);
+      addToken(TOK_OPER, StringView(pos, pos+2), pos);
       pos += 2;
     } else {
-      addToken(TOK_OPER, String(pos, pos+1), pos);
+      addToken(TOK_OPER, StringView(pos, pos+1), pos);
       ++pos;
     }
   } else if (c==_('"')) {
@@ -246,17 +313,17 @@ void TokenIterator::readToken() {
   } else if (c == _('}') && !open_braces.empty() && open_braces.top() != BRACE_PAREN) {
     // closing smart string, resume to string parsing
     //   "a{e}b"  -->  "a"  "{  e  }"  "b"
-    addToken(TOK_RPAREN, "}\"", pos);
+    addToken(TOK_RPAREN, StringView(TOKEN_TEXT_STRING_RBRACE), pos);
     readStringToken();
-  } else if (isLparen(c)) {
+  } else if (cls == CHAR_LPAREN) {
     // paranthesis/brace
     open_braces.push(BRACE_PAREN);
-    addToken(TOK_LPAREN, String(1,c), pos);
+    addToken(TOK_LPAREN, StringView(pos, pos+1), pos);
     ++pos;
-  } else if (isRparen(c)) {
+  } else if (cls == CHAR_RPAREN) {
     // paranthesis/brace
     if (!open_braces.empty()) open_braces.pop();
-    addToken(TOK_RPAREN, String(1,c), pos);
+    addToken(TOK_RPAREN, StringView(pos, pos+1), pos);
     ++pos;
   } else if(c==_('#')) {
     // comment untill end of line
@@ -271,17 +338,24 @@ void TokenIterator::readToken() {
 void TokenIterator::readStringToken(bool string_mode) {
   auto start = pos;
   if (!string_mode) ++pos;
+  // the value is a part of the input, until we find an escape sequence, then it is copied to str
+  auto value_start = pos;
+  bool escaped = false;
   String str;
+  auto add_string = [&](String::const_iterator value_end) {
+    if (escaped) addStringToken(move(str), start);
+    else         addToken(TOK_STRING, StringView(value_start, value_end), start);
+  };
   while (true) {
     if (pos == end) {
       if (!open_braces.empty() && open_braces.top() == BRACE_STRING_MODE) {
         // in string mode: end of input = end of string
-        addToken(TOK_STRING, str, start);
+        add_string(pos);
         return;
       } else {
         add_error(_("Unexpected end of input in string constant"));
         // fix up
-        addToken(TOK_STRING, str, start);
+        add_string(pos);
         return;
       }
     }
@@ -289,15 +363,19 @@ void TokenIterator::readStringToken(bool string_mode) {
     // parse the string constant
     if (c == '"' && !open_braces.empty() && open_braces.top() == BRACE_STRING) {
       // end of string
-      addToken(TOK_STRING, str, start);
+      add_string(pos - 1);
       open_braces.pop();
       return;
     } else if (c == '\\') {
       // escape
+      if (!escaped) {
+        str.assign(value_start, pos - 1);
+        escaped = true;
+      }
       if (pos == end) {
         add_error(_("Unexpected end of input in string constant"));
         // fix up
-        addToken(TOK_STRING, str, start);
+        add_string(pos);
         return;
       }
       c = *pos++;
@@ -324,10 +402,10 @@ void TokenIterator::readStringToken(bool string_mode) {
     } else if (c == _('{')) {
       // smart string
       //   "a{e}b"  -->  "a"  "{  e  }"  "b"
-      addToken(TOK_STRING, str, start);
-      addToken(TOK_LPAREN, _("\"{"), pos-1);
+      add_string(pos - 1);
+      addToken(TOK_LPAREN, StringView(TOKEN_TEXT_STRING_LBRACE), pos-1);
       return;
-    } else {
+    } else if (escaped) {
       str += c;
     }
   }
@@ -355,9 +433,9 @@ void TokenIterator::expected(const String& expected, const Token* opening) {
   // add error message
   if (opening) {
     size_t open_pos = opening->pos - begin;
-    errors.push_back(ScriptParseError(open_pos, error_pos, line_number(opening->pos,begin), filename, opening->value, expected, peek(0).value));
+    errors.push_back(ScriptParseError(open_pos, error_pos, line_number(opening->pos,begin), filename, opening->value(), expected, peek(0).value()));
   } else {
-    errors.push_back(ScriptParseError(error_pos, line_number(next_token_pos,begin), filename, expected, peek(0).value));
+    errors.push_back(ScriptParseError(error_pos, line_number(next_token_pos,begin), filename, expected, peek(0).value()));
   }
 }
 
@@ -427,6 +505,8 @@ ExprType parseTopLevel(TokenIterator& input, Script& script) {
   return type;
 }
 
+bool optimize_scripts = true;
+
 ScriptP parse(const String& s, Packaged* package, bool string_mode, vector<ScriptParseError>& errors_out) {
   errors_out.clear();
   // parse
@@ -438,6 +518,7 @@ ScriptP parse(const String& s, Packaged* package, bool string_mode, vector<Scrip
   if (type == EXPR_FAILED) {
     return ScriptP();
   } else {
+    if (optimize_scripts) script->optimize();
     return script;
   }
 }
@@ -451,6 +532,15 @@ ScriptP parse(const String& s, Packaged* package, bool string_mode) {
   return script;
 }
 
+size_t count_tokens(const String& s, bool string_mode) {
+  vector<ScriptParseError> errors;
+  const String filename;
+  TokenIterator input(s, nullptr, string_mode, filename, errors);
+  size_t count = 0;
+  while (input.read() != TOK_EOF) ++count;
+  return count;
+}
+
 
 // Expect a token, adds an error if it is not found
 bool expectToken(TokenIterator& input, const Char* expect, const Token* opening = nullptr, const Char* name_in_error = nullptr) {
@@ -478,6 +568,7 @@ ExprType parseExpr(TokenIterator& input, Script& script, Precedence minPrec) {
       input.add_error(_("Warning: last statement of a function should be an expression, that is, it should return a result in all cases."));
     }
     expectToken(input, _("}"), &token);
+    if (optimize_scripts) subScript->optimize();
     script.addInstruction(I_PUSH_CONST, subScript);
   } else if (token == _("[")) {
     // [] = list or map literal
@@ -486,7 +577,7 @@ ExprType parseExpr(TokenIterator& input, Script& script, Precedence minPrec) {
     while (t != _("]") && t != TOK_EOF) {
       if (input.peek(2) == _(":") && (t.type == TOK_NAME || t.type == TOK_INT || t.type == TOK_STRING)) {
         // name: ...
-        script.addInstruction(I_PUSH_CONST, to_script(t.value));
+        script.addInstruction(I_PUSH_CONST, to_script(t.value()));
         input.read(); // skip the name
         input.read(); // and the :
       } else {
@@ -589,7 +680,7 @@ ExprType parseExpr(TokenIterator& input, Script& script, Precedence minPrec) {
         input.expected(_("name"));
         return EXPR_FAILED;
       }
-      Variable var = string_to_variable(name.value);
+      Variable var = string_to_variable(name.value());
       // key:value?
       bool with_key = input.peek() == _(":");
       Variable key = (Variable)-1;
@@ -600,7 +691,7 @@ ExprType parseExpr(TokenIterator& input, Script& script, Precedence minPrec) {
           input.expected(_("name"));
           return EXPR_FAILED;
         }
-        key = string_to_variable(name.value);
+        key = string_to_variable(name.value());
         swap(var,key);
       }
       // iterator
@@ -704,7 +795,7 @@ ExprType parseExpr(TokenIterator& input, Script& script, Precedence minPrec) {
       expectToken(input, _(")"), &token);
       // include the file
       // read the entire file, and start at the beginning of it
-      String const& filename = token.value;
+      String filename = token.value();
       auto [stream,file_package] = package_manager.openFileFromPackage(input.package, filename);
       eat_utf8_bom(*stream);
       String included_input = read_utf8_line(*stream, true);
@@ -712,22 +803,22 @@ ExprType parseExpr(TokenIterator& input, Script& script, Precedence minPrec) {
       return parseTopLevel(included_tokens, script);
     } else {
       // variable
-      Variable var = string_to_variable(token.value);
+      Variable var = string_to_variable(token.value());
       script.addInstruction(I_GET_VAR, var);
       return EXPR_VAR;
     }
   } else if (token == TOK_INT) {
     long l = 0;
-    //l = lexical_cast<long>(token.value);
-    token.value.ToLong(&l);
+    //l = lexical_cast<long>(token.value());
+    token.value().ToLong(&l);
     script.addInstruction(I_PUSH_CONST, to_script(l));
   } else if (token == TOK_DOUBLE) {
     double d = 0;
-    //d = lexical_cast<double>(token.value);
-    token.value.ToDouble(&d);
+    //d = lexical_cast<double>(token.value());
+    token.value().ToDouble(&d);
     script.addInstruction(I_PUSH_CONST, to_script(d));
   } else if (token == TOK_STRING) {
-    script.addInstruction(I_PUSH_CONST, to_script(token.value));
+    script.addInstruction(I_PUSH_CONST, to_script(token.value()));
   } else {
     // Parse error, but do produce a runable script
     script.addInstruction(I_PUSH_CONST, script_nil);
@@ -826,7 +917,7 @@ ExprType parseOper(TokenIterator& input, Script& script, Precedence minPrec, Ins
                      // (this is a bit of a hack)
       const Token& token = input.read();
       if (token == TOK_NAME || token == TOK_STRING) {
-        script.addInstruction(I_MEMBER_C, token.value);
+        script.addInstruction(I_MEMBER_C, token.value());
       } else {
         input.expected(_("name"));
       }
@@ -909,7 +1000,7 @@ void parseCallArguments(TokenIterator& input, Script& script, vector<Variable>&
   while (t != _(")") && t != TOK_EOF) {
     if (input.peek(2) == _(":") && t.type == TOK_NAME) {
       // name: ...
-      arguments.push_back(string_to_variable(t.value));
+      arguments.push_back(string_to_variable(t.value()));
       input.read(); // skip the name
       input.read(); // and the :
       parseOper(input, script, PREC_SEQ);
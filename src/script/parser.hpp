@@ -35,3 +35,12 @@ ScriptP parse(const String& s, Packaged* package, bool string_mode, vector<Scrip
  */
 ScriptP parse(const String& s, Packaged* package = nullptr, bool string_mode = false);
 
+/// Count the number of tokens in a script, without parsing it
+/** Used to report the throughput of the tokenizer */
+size_t count_tokens(const String& s, bool string_mode = false);
+
+/// Should parsed scripts be optimized? (see Script::optimize)
+/** Enabled by default, it can be disabled to test that the optimizer doesn't change any results.
+ */
+extern bool optimize_scripts;
+
@@ -11,39 +11,24 @@
 #include <script/context.hpp>
 #include <script/to_value.hpp>
 #include <util/error.hpp>
+#include <util/interned_name.hpp>
 
 // ----------------------------------------------------------------------------- : Variables
 
-typedef map<String, Variable> Variables;
-Variables variables;
-#ifdef _DEBUG
-  vector<String> variable_names;
-#endif
-
 /// Return a unique name for a variable to allow for faster loopups
+/** Variables are interned names, the same ids are used for field names */
 Variable string_to_variable(const String& s) {
-  Variables::iterator it = variables.find(s);
-  if (it == variables.end()) {
-    #ifdef _DEBUG
-      variable_names.push_back(s);
-      assert(s == canonical_name_form(s)); // only use canonical names
-    #endif
-    Variable v = (Variable)variables.size();
-    variables.insert(make_pair(s,v));
-    return v;
-  } else {
-    return it->second;
-  }
+  assert(s == canonical_name_form(s)); // only use canonical names
+  return (Variable)intern_name(s);
 }
 
 /// Get the name of a vaiable
-/** Warning: this function is slow, it should only be used for error messages and such.
- */
 String variable_to_string(Variable v) {
-  FOR_EACH(vi, variables) {
-    if (vi.second == v) return replace_all(vi.first, _(" "), _("_"));
+  try {
+    return replace_all(name_from_id(v), _(" "), _("_"));
+  } catch (const InternalError&) {
+    throw InternalError(String(_("Variable not found: ")) << v);
   }
-  throw InternalError(String(_("Variable not found: ")) << v);
 }
 
 // ----------------------------------------------------------------------------- : CommonVariables
@@ -79,7 +64,7 @@ void init_script_variables() {
   Var(value);
   Var(condition);
   Var(language);
-  assert(variables.size() == SCRIPT_VAR_CUSTOM_FIRST);
+  assert(find_name_id(_("language")) + 1 == SCRIPT_VAR_CUSTOM_FIRST);
 }
 
 // ----------------------------------------------------------------------------- : Script
@@ -127,15 +112,18 @@ void Script::addInstruction(InstructionType t, Addr d) {
   addInstruction(t, d.addr);
 }
 void Script::addInstruction(InstructionType t, const ScriptValueP& c) {
-  constants.push_back(c);
-  Instruction i = {t, {(unsigned int)constants.size() - 1}};
+  Instruction i = {t, {addConstant(c)}};
   instructions.push_back(i);
 }
 void Script::addInstruction(InstructionType t, const String& s) {
-  constants.push_back(to_script(s));
-  Instruction i = {t, {(unsigned int)constants.size() - 1}};
+  Instruction i = {t, {addConstant(to_script(s))}};
   instructions.push_back(i);
 }
+unsigned int Script::addConstant(const ScriptValueP& c) {
+  constants.push_back(c);
+  member_caches.emplace_back();
+  return (unsigned int)constants.size() - 1;
+}
 
 void Script::comeFrom(Addr pos) {
   assert( instructions.at(pos.addr).instr == I_JUMP
@@ -178,6 +166,7 @@ String Script::dumpInstr(unsigned int pos, Instruction i) const {
     case I_SET_VAR:    ret += _("set");    break;
     case I_SET_GLB:    ret += _("set_global");    break;
     case I_MEMBER_C:  ret += _("member_c");  break;
+    case I_GET_VAR_MEMBER_C: ret += _("get member_c"); break;
     case I_LOOP:    ret += _("loop");    break;
     case I_LOOP_WITH_KEY:ret += _("loop with key"); break;
     case I_MAKE_OBJECT:  ret += _("make object");break;
@@ -240,6 +229,10 @@ String Script::dumpInstr(unsigned int pos, Instruction i) const {
     case I_GET_VAR: case I_SET_VAR: case I_NOP: case I_SET_GLB:          // variable
       ret += _("\t") + variable_to_string((Variable)i.data);
       break;
+    case I_GET_VAR_MEMBER_C:                                             // variable + const
+      ret += _("\t") + variable_to_string(packed_var(i));
+      ret += _("\t") + constants[packed_const(i)]->toCode();
+      break;
   }
   return ret;
 }
@@ -262,7 +255,7 @@ const Instruction* Script::backtraceSkip(const Instruction* instr, int to_skip)
     // skip an instruction
     switch (instr->instr) {
       case I_PUSH_CONST:
-      case I_GET_VAR: case I_DUP:
+      case I_GET_VAR: case I_DUP: case I_GET_VAR_MEMBER_C:
         to_skip -= 1; break; // nett stack effect +1
       case I_BINARY:
         to_skip += 1; break; // nett stack effect 1-2 == -1
@@ -341,6 +334,10 @@ String Script::instructionName(const Instruction* instr) const {
     return instructionName(backtraceSkip(instr - 1, 0))
          + _(".")
          + constants[instr->data]->toString();
+  } else if (instr->instr == I_GET_VAR_MEMBER_C) {
+    return variable_to_string(packed_var(*instr))
+         + _(".")
+         + constants[packed_const(*instr)]->toString();
   } else if (instr->instr == I_BINARY && instr->instr2 == I_MEMBER) {
     return _("??\?[...]");
   } else if (instr->instr == I_BINARY && instr->instr2 == I_ADD) {
@@ -31,6 +31,7 @@ enum InstructionType
 ,  I_GET_VAR       = 4  ///< arg = var        : find a variable, push its value onto the stack, it is an error if the variable is not found
 ,  I_SET_VAR       = 5  ///< arg = var        : assign the top value from the stack to a variable (doesn't pop)
 ,  I_SET_GLB       = 21 ///< arg = var        : assign the top value from the stack to a global variable (doesn't pop)
+,  I_GET_VAR_MEMBER_C = 22 ///< arg = var+const : I_GET_VAR followed by I_MEMBER_C, generated by the optimizer, see pack_var_const
   // Objects
 ,  I_MEMBER_C      = 6  ///< arg = const name : finds a member of the top of the stack replaces the top of the stack with the member
 ,  I_LOOP          = 7  ///< arg = address    : loop over the elements of an iterator, which is the *second* element of the stack (this allows for combing the results of multiple iterations)
@@ -156,13 +157,29 @@ enum Variable
 Variable string_to_variable(const String& s);
 
 /// Get the name of a vaiable
-/** Warning: this function is slow, it should only be used for error messages and such.
- */
 String variable_to_string(Variable v);
 
 /// initialze the script variables
 void init_script_variables();
 
+/// Number of bits used for the variable in the data of I_GET_VAR_MEMBER_C, the rest is for the constant
+const unsigned int PACKED_VAR_BITS   = 14;
+const unsigned int PACKED_CONST_BITS = 26 - PACKED_VAR_BITS;
+
+/// Can a variable and a constant index be packed in the data of a single instruction?
+inline bool can_pack_var_const(unsigned int var, unsigned int constant) {
+  return var < (1u << PACKED_VAR_BITS) && constant < (1u << PACKED_CONST_BITS);
+}
+inline unsigned int pack_var_const(unsigned int var, unsigned int constant) {
+  return var | (constant << PACKED_VAR_BITS);
+}
+inline Variable packed_var(Instruction i) {
+  return (Variable)(i.data & ((1u << PACKED_VAR_BITS) - 1));
+}
+inline unsigned int packed_const(Instruction i) {
+  return i.data >> PACKED_VAR_BITS;
+}
+
 
 // ----------------------------------------------------------------------------- : Script
 
@@ -196,6 +213,13 @@ public:
   /// Get the current instruction position
   Addr getLabel() const;
   
+  /// Optimize the instructions of this script (in optimizer.cpp)
+  /** Performs constant folding, removes useless jumps and push/pop pairs,
+   *  and combines common instruction sequences into a single instruction.
+   *  Should only be called on a complete script.
+   */
+  void optimize();
+  
   /// Get access to the vector of instructions
   inline vector<Instruction>& getInstructions() { return instructions; }
   /// Get access to the vector of constants
@@ -213,6 +237,12 @@ private:
   vector<Instruction>  instructions;
   /// Constant values that can be referred to from the script
   vector<ScriptValueP> constants;
+  /// Inline caches for I_MEMBER_C instructions, one for each constant
+  /** Each member instruction has its own constant, so this is a cache per instruction. */
+  mutable vector<MemberCache> member_caches;
+  
+  /// Add a constant, returns its index
+  unsigned int addConstant(const ScriptValueP& c);
   
   /// Do a backtrace for error messages.
   /** Starting from instr, move backwards until the nett stack effect
@@ -223,6 +253,12 @@ private:
   /// Find the name of an instruction
   String instructionName(const Instruction* instr) const;
   
+  /// One pass of the optimizer, returns true if anything was changed
+  bool optimizeStep();
+  /// Remove constants that are no longer used
+  void removeUnusedConstants();
+  
   friend class Context;
+  friend class ScriptCache;
 };
 
@@ -0,0 +1,384 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <script/script_cache.hpp>
+#include <script/script.hpp>
+#include <script/to_value.hpp>
+#include <script/parser.hpp>
+#include <util/version.hpp>
+#include <util/error.hpp>
+#include <wx/wfstream.h>
+
+String user_settings_dir();
+void read_all(wxInputStream& input, vector<char>& out);
+bool is_jump(InstructionType t);       // in optimizer.cpp
+bool has_arguments(InstructionType t); // in optimizer.cpp
+extern ScriptValueP script_warning;
+extern ScriptValueP script_warning_if_neq;
+
+ScriptCache script_cache;
+
+// ----------------------------------------------------------------------------- : Binary format
+
+// The cache file contains the magic string, the format version and the program version,
+// followed by (key, script) pairs. Variables are stored by name, because their numbers
+// depend on the order in which they are first used.
+
+/// Change this when the format or the instructions change
+const UInt SCRIPT_CACHE_VERSION = 2; // 2: scripts with include directives are no longer cached
+const char SCRIPT_CACHE_MAGIC[] = "MSE script cache";
+/// Parsing short scripts is as fast as looking them up
+const size_t SCRIPT_CACHE_MIN_LENGTH = 32;
+/// Entries from previous runs that were not used are only kept while the file is smaller than this
+const size_t SCRIPT_CACHE_MAX_SIZE = 16 * 1024 * 1024;
+
+/// Types of constants in the cache
+enum CachedConstant
+{  CACHED_NIL
+,  CACHED_TRUE
+,  CACHED_FALSE
+,  CACHED_INT
+,  CACHED_DOUBLE
+,  CACHED_STRING
+,  CACHED_SCRIPT
+,  CACHED_WARNING
+,  CACHED_WARNING_IF_NEQ
+};
+
+struct CacheOutput {
+  std::string data;
+  
+  void write(const void* p, size_t n) {
+    data.append((const char*)p, n);
+  }
+  void writeByte(Byte x)  { write(&x, sizeof(x)); }
+  void writeInt(UInt x)   { write(&x, sizeof(x)); }
+  void writeStd(const std::string& s) {
+    writeInt((UInt)s.size());
+    write(s.data(), s.size());
+  }
+  void writeString(const String& s) {
+    wxScopedCharBuffer utf8 = s.ToUTF8();
+    writeInt((UInt)utf8.length());
+    write(utf8.data(), utf8.length());
+  }
+};
+
+/// Input in the cache format, throws an error if the data ends too soon
+struct CacheInput {
+  const char* pos;
+  const char* end;
+  
+  void read(void* p, size_t n) {
+    if ((size_t)(end - pos) < n) throw InternalError(_("Script cache is damaged"));
+    memcpy(p, pos, n);
+    pos += n;
+  }
+  Byte readByte() { Byte x; read(&x, sizeof(x)); return x; }
+  UInt readInt()  { UInt x; read(&x, sizeof(x)); return x; }
+  std::string readStd() {
+    UInt n = readInt();
+    if ((size_t)(end - pos) < n) throw InternalError(_("Script cache is damaged"));
+    std::string s(pos, n);
+    pos += n;
+    return s;
+  }
+  String readString() {
+    UInt n = readInt();
+    if ((size_t)(end - pos) < n) throw InternalError(_("Script cache is damaged"));
+    String s = String::FromUTF8(pos, n);
+    pos += n;
+    return s;
+  }
+};
+
+/// Is the byte read from the cache an instruction type?
+bool is_instruction_type(Byte t) {
+  return t <= I_GET_VAR_MEMBER_C; // the highest InstructionType
+}
+
+/// Is the data of an operator instruction one of the operators?
+bool is_operator(InstructionType t, UInt data) {
+  switch (t) {
+    case I_UNARY:      return data <= I_NOT;
+    case I_BINARY:     return data <= I_OR_ELSE;
+    case I_TERNARY:    return data <= I_RGB;
+    case I_QUATERNARY: return data <= I_RGBA;
+    default:           return true;
+  }
+}
+
+/// Is the data of the instruction a variable?
+bool is_variable_instruction(InstructionType t) {
+  return t == I_GET_VAR
+      || t == I_SET_VAR
+      || t == I_SET_GLB;
+}
+
+bool ScriptCache::writeScript(CacheOutput& out, const Script& script) {
+  // variable_to_string is slow, so look up each variable only once
+  map<Variable,String> names;
+  auto writeVariable = [&](Variable v) {
+    auto it = names.find(v);
+    if (it == names.end()) it = names.insert(make_pair(v, variable_to_string(v))).first;
+    out.writeString(it->second);
+  };
+  out.writeInt((UInt)script.instructions.size());
+  size_t arguments = 0;
+  FOR_EACH_CONST(i, script.instructions) {
+    out.writeByte((Byte)i.instr);
+    if (arguments > 0) {
+      // argument name of a call
+      --arguments;
+      writeVariable((Variable)i.data);
+    } else if (is_variable_instruction(i.instr)) {
+      writeVariable((Variable)i.data);
+    } else if (i.instr == I_GET_VAR_MEMBER_C) {
+      writeVariable(packed_var(i));
+      out.writeInt(packed_const(i));
+    } else {
+      out.writeInt(i.data);
+      if (has_arguments(i.instr)) arguments = i.data;
+    }
+  }
+  out.writeInt((UInt)script.constants.size());
+  FOR_EACH_CONST(c, script.constants) {
+    if (!writeConstant(out, c)) return false;
+  }
+  return true;
+}
+
+bool ScriptCache::writeConstant(CacheOutput& out, const ScriptValueP& value) {
+  if      (value == script_nil)            out.writeByte(CACHED_NIL);
+  else if (value == script_true)           out.writeByte(CACHED_TRUE);
+  else if (value == script_false)          out.writeByte(CACHED_FALSE);
+  else if (value == script_warning)        out.writeByte(CACHED_WARNING);
+  else if (value == script_warning_if_neq) out.writeByte(CACHED_WARNING_IF_NEQ);
+  else {
+    switch (value->type()) {
+      case SCRIPT_INT:
+        out.writeByte(CACHED_INT);
+        out.writeInt((UInt)value->toInt());
+        break;
+      case SCRIPT_DOUBLE: {
+        double d = value->toDouble();
+        out.writeByte(CACHED_DOUBLE);
+        out.write(&d, sizeof(d));
+        break;
+      }
+      case SCRIPT_STRING:
+        out.writeByte(CACHED_STRING);
+        out.writeString(value->toString());
+        break;
+      case SCRIPT_FUNCTION:
+        if (const Script* script = dynamic_cast<const Script*>(value.get())) {
+          out.writeByte(CACHED_SCRIPT);
+          return writeScript(out, *script);
+        }
+        return false;
+      default:
+        return false; // not something the parser makes
+    }
+  }
+  return true;
+}
+
+ScriptP ScriptCache::readScript(CacheInput& in) {
+  ScriptP script = make_intrusive<Script>();
+  UInt count = in.readInt();
+  size_t arguments = 0;
+  for (UInt n = 0 ; n < count ; ++n) {
+    Byte type = in.readByte();
+    if (!is_instruction_type(type)) throw InternalError(_("Script cache is damaged"));
+    InstructionType t = (InstructionType)type;
+    unsigned int data;
+    if (arguments > 0) {
+      --arguments;
+      data = string_to_variable(in.readString());
+    } else if (is_variable_instruction(t)) {
+      data = string_to_variable(in.readString());
+    } else if (t == I_GET_VAR_MEMBER_C) {
+      Variable var = string_to_variable(in.readString());
+      UInt constant = in.readInt();
+      if (!can_pack_var_const(var, constant)) throw InternalError(_("Script cache is damaged"));
+      data = pack_var_const(var, constant);
+    } else {
+      data = in.readInt();
+      if (!is_operator(t, data)) throw InternalError(_("Script cache is damaged"));
+      if (has_arguments(t)) arguments = data;
+    }
+    Instruction i = {t, {data}};
+    script->instructions.push_back(i);
+  }
+  UInt constants = in.readInt();
+  for (UInt n = 0 ; n < constants ; ++n) {
+    script->addConstant(readConstant(in));
+  }
+  // don't trust the indices, a damaged cache shouldn't crash
+  FOR_EACH_CONST(i, script->instructions) {
+    if (is_jump(i.instr) && i.data > count) {
+      throw InternalError(_("Script cache is damaged"));
+    } else if ((i.instr == I_PUSH_CONST || i.instr == I_MEMBER_C) && i.data >= constants) {
+      throw InternalError(_("Script cache is damaged"));
+    } else if (i.instr == I_GET_VAR_MEMBER_C && packed_const(i) >= constants) {
+      throw InternalError(_("Script cache is damaged"));
+    }
+  }
+  return script;
+}
+
+ScriptValueP ScriptCache::readConstant(CacheInput& in) {
+  switch (in.readByte()) {
+    case CACHED_NIL:            return script_nil;
+    case CACHED_TRUE:           return script_true;
+    case CACHED_FALSE:          return script_false;
+    case CACHED_WARNING:        return script_warning;
+    case CACHED_WARNING_IF_NEQ: return script_warning_if_neq;
+    case CACHED_INT:            return to_script((int)in.readInt());
+    case CACHED_DOUBLE: {
+      double d;
+      in.read(&d, sizeof(d));
+      return to_script(d);
+    }
+    case CACHED_STRING:         return to_script(in.readString());
+    case CACHED_SCRIPT:         return readScript(in);
+    default:
+      throw InternalError(_("Script cache is damaged"));
+  }
+}
+
+// ----------------------------------------------------------------------------- : ScriptCache
+
+String script_cache_file() {
+  return user_settings_dir() + _("script_cache.bin");
+}
+
+ScriptCache::ScriptCache()
+  : enabled(true), loaded(false), changed(false)
+{}
+
+/// Scripts containing these are not cached, the included files can change without changing the script,
+/// and which file is included can depend on the locale or on dark mode.
+const Char* SCRIPT_CACHE_INCLUDES[] = {
+  _("include_file"), _("include file:"), _("include localized file:"), _("include dark file:")
+};
+
+bool ScriptCache::cacheable(const String& code) {
+  if (code.size() < SCRIPT_CACHE_MIN_LENGTH) return false;
+  for (const Char* include : SCRIPT_CACHE_INCLUDES) {
+    if (code.find(include) != String::npos) return false;
+  }
+  return true;
+}
+
+std::string ScriptCache::key(const String& code, bool string_mode) {
+  // the result also depends on whether the optimizer is used
+  char mode = string_mode ? (optimize_scripts ? 's' : 'S') : (optimize_scripts ? 'c' : 'C');
+  std::string key(1, mode);
+  wxScopedCharBuffer utf8 = code.ToUTF8();
+  key.append(utf8.data(), utf8.length());
+  return key;
+}
+
+ScriptP ScriptCache::find(const String& code, bool string_mode) {
+  if (!enabled || !cacheable(code)) return ScriptP();
+  wxMutexLocker lock(mutex);
+  if (!loaded) load();
+  auto it = entries.find(key(code, string_mode));
+  if (it == entries.end()) {
+    counter.misses++;
+    return ScriptP();
+  }
+  try {
+    CacheInput in = {it->second.data.data(), it->second.data.data() + it->second.data.size()};
+    ScriptP script = readScript(in);
+    it->second.used = true;
+    counter.hits++;
+    return script;
+  } catch (const Error&) {
+    // damaged entry, parse the script again
+    entries.erase(it);
+    counter.misses++;
+    return ScriptP();
+  }
+}
+
+void ScriptCache::store(const String& code, bool string_mode, const Script& script) {
+  if (!enabled || !cacheable(code)) return;
+  CacheOutput out;
+  if (!writeScript(out, script)) return;
+  wxMutexLocker lock(mutex);
+  if (!loaded) load();
+  Entry& entry = entries[key(code, string_mode)];
+  entry.data.swap(out.data);
+  entry.used = true;
+  changed = true;
+}
+
+void ScriptCache::clear() {
+  wxMutexLocker lock(mutex);
+  entries.clear();
+  loaded = true; // don't read the old file again
+  changed = true;
+}
+
+void ScriptCache::load() {
+  loaded = true;
+  String filename = script_cache_file();
+  if (!wxFileExists(filename)) return;
+  wxFileInputStream file(filename);
+  if (!file.IsOk()) return;
+  vector<char> data;
+  read_all(file, data);
+  try {
+    CacheInput in = {data.data(), data.data() + data.size()};
+    if (in.readStd() != SCRIPT_CACHE_MAGIC) return;
+    if (in.readInt() != SCRIPT_CACHE_VERSION) return;
+    if (in.readString() != app_version.toString()) return;
+    UInt count = in.readInt();
+    for (UInt n = 0 ; n < count ; ++n) {
+      std::string key = in.readStd();
+      entries[key] = Entry{in.readStd(), false};
+    }
+  } catch (const Error&) {
+    // a damaged cache is ignored, it is replaced when the cache is written
+    entries.clear();
+    changed = true;
+  }
+}
+
+void ScriptCache::write() {
+  wxMutexLocker lock(mutex);
+  if (!changed) return;
+  // entries used in this run first, then older ones while there is room
+  vector<const pair<const std::string,Entry>*> keep;
+  size_t size = 0;
+  for (int used = 1 ; used >= 0 ; --used) {
+    FOR_EACH_CONST(e, entries) {
+      if (e.second.used != (bool)used) continue;
+      size_t entry_size = e.first.size() + e.second.data.size() + 2 * sizeof(UInt);
+      if (!used && size + entry_size > SCRIPT_CACHE_MAX_SIZE) continue;
+      keep.push_back(&e);
+      size += entry_size;
+    }
+  }
+  CacheOutput out;
+  out.writeStd(SCRIPT_CACHE_MAGIC);
+  out.writeInt(SCRIPT_CACHE_VERSION);
+  out.writeString(app_version.toString());
+  out.writeInt((UInt)keep.size());
+  FOR_EACH_CONST(e, keep) {
+    out.writeStd(e->first);
+    out.writeStd(e->second.data);
+  }
+  wxFileOutputStream file(script_cache_file());
+  if (!file.IsOk()) return;
+  file.Write(out.data.data(), out.data.size());
+  changed = false;
+}
@@ -0,0 +1,66 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/lru_cache.hpp>
+#include <wx/thread.h>
+
+DECLARE_POINTER_TYPE(Script);
+struct CacheInput;
+struct CacheOutput;
+
+// ----------------------------------------------------------------------------- : ScriptCache
+
+/// Cache of parsed scripts, kept on disk so packages load faster the next time
+/** Scripts are found by their source code, so scripts from changed files are simply parsed again.
+ *  Scripts that include other files (with include_file or an "include file:" directive) are not cached,
+ *  because the included file could change.
+ *
+ *  The cache is shared between threads, all access is locked.
+ */
+class ScriptCache {
+public:
+  ScriptCache();
+  
+  /// Find a parsed script, returns nullptr if it is not in the cache
+  ScriptP find(const String& code, bool string_mode);
+  /// Add a parsed script to the cache
+  void store(const String& code, bool string_mode, const Script& script);
+  /// Forget all cached scripts, the file is emptied by the next write()
+  void clear();
+  /// Write the cache to disk, if anything was added
+  void write();
+  
+  /// Is the cache used at all?
+  bool enabled;
+  /// Hits and misses of find()
+  CacheCounter counter;
+  
+private:
+  struct Entry {
+    std::string data; ///< The script in the binary format
+    bool used;        ///< Was the entry used in this run?
+  };
+  wxMutex mutex;
+  bool loaded;  ///< Has the file been read?
+  bool changed; ///< Are there changes that are not written yet?
+  unordered_map<std::string, Entry> entries;
+  
+  void load();
+  static bool cacheable(const String& code);
+  static std::string key(const String& code, bool string_mode);
+  static bool writeScript(CacheOutput& out, const Script& script);
+  static bool writeConstant(CacheOutput& out, const ScriptValueP& value);
+  static ScriptP readScript(CacheInput& in);
+  static ScriptValueP readConstant(CacheInput& in);
+};
+
+/// The global script cache
+extern ScriptCache script_cache;
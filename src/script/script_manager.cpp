@@ -20,6 +20,8 @@
 #include <data/action/value.hpp>
 #include <data/action/keyword.hpp>
 #include <util/error.hpp>
+#include <util/stage_timer.hpp>
+#include <exception>
 
 // ----------------------------------------------------------------------------- : SetScriptContext : initialization
 
@@ -68,9 +70,8 @@ Context& SetScriptContext::getContext(const StyleSheetP& stylesheet) {
   }
   return ctx;
 }
-Context& SetScriptContext::getContext(const CardP& card) {
-  StyleSheetP stylesheet = set.stylesheetForP(card);
-  Context& ctx = getContext(stylesheet);
+// bind the variables for a specific card in a context
+void set_card_variables(Set& set, Context& ctx, const StyleSheetP& stylesheet, const CardP& card) {
   if (card) {
     ctx.setVariable(SCRIPT_VAR_card,    to_script(card));
     ctx.setVariable(SCRIPT_VAR_styling, to_script(&set.stylingDataFor(card)));
@@ -82,6 +83,50 @@ Context& SetScriptContext::getContext(const CardP& card) {
     ctx.setVariable(SCRIPT_VAR_extra_card_style, script_nil);
     ctx.setVariable(SCRIPT_VAR_extra_card, script_nil);
   }
+}
+
+Context& SetScriptContext::getContext(const CardP& card) {
+  StyleSheetP stylesheet = set.stylesheetForP(card);
+  Context& ctx = getContext(stylesheet);
+  set_card_variables(set, ctx, stylesheet, card);
+  return ctx;
+}
+
+Context SetScriptContext::forkContext(const StyleSheetP& stylesheet) {
+  // copying a context is cheap compared to running the init scripts,
+  // the script values themselves are immutable, so they can be shared
+  return getContext(stylesheet);
+}
+
+// ----------------------------------------------------------------------------- : SetScriptContextFork
+
+SetScriptContextFork::SetScriptContextFork(SetScriptContext& parent, const vector<CardP>& cards)
+  : set(parent.set)
+{
+  // fork a context for each stylesheet
+  contexts.emplace(set.stylesheet.get(), parent.forkContext(set.stylesheet));
+  FOR_EACH_CONST(card, cards) {
+    StyleSheetP stylesheet = set.stylesheetForP(card);
+    if (contexts.find(stylesheet.get()) == contexts.end()) {
+      contexts.emplace(stylesheet.get(), parent.forkContext(stylesheet));
+    }
+    // the extra data and styling is created on demand, do that now, and not from another thread
+    card->extraDataFor(*stylesheet);
+    set.stylingDataFor(card);
+  }
+}
+
+Context& SetScriptContextFork::getContext(const StyleSheetP& stylesheet) {
+  auto it = contexts.find(stylesheet.get());
+  if (it == contexts.end()) {
+    throw InternalError(_("Stylesheet was not forked: ") + stylesheet->name());
+  }
+  return it->second;
+}
+Context& SetScriptContextFork::getContext(const CardP& card) {
+  StyleSheetP stylesheet = set.stylesheetForP(card);
+  Context& ctx = getContext(stylesheet);
+  set_card_variables(set, ctx, stylesheet, card);
   return ctx;
 }
 
@@ -148,6 +193,143 @@ void SetScriptManager::initDependencies(Context& ctx, StyleSheet& stylesheet) {
   }
 }
 
+// ----------------------------------------------------------------------------- : SetScriptManager : update order
+
+// Add edges from a field to the fields whose scripts depend on it
+// the fields that depend on it for all cards are also added to cross_card_edges
+void add_update_edges(const Game& game, const Dependencies& deps, vector<size_t>& edges, std::set<const Field*>& copied, vector<size_t>* cross_card_edges = nullptr) {
+  FOR_EACH_CONST(d, deps) {
+    switch (d.type) {
+      case DEP_SET_FIELD:
+        edges.push_back(d.index);
+        break;
+      case DEP_CARDS_FIELD:
+        if (cross_card_edges) cross_card_edges->push_back(game.set_fields.size() + d.index);
+        // fall through
+      case DEP_CARD_FIELD:
+        edges.push_back(game.set_fields.size() + d.index);
+        break;
+      case DEP_CARD_COPY_DEP: case DEP_SET_COPY_DEP: {
+        const Field* f = (d.type == DEP_CARD_COPY_DEP ? game.card_fields : game.set_fields).at(d.index).get();
+        if (copied.insert(f).second) {
+          add_update_edges(game, f->dependent_scripts, edges, copied, cross_card_edges);
+        }
+        break;
+      } default:
+        break; // styles are updated when they are drawn
+    }
+  }
+}
+
+void SetScriptManager::initUpdateOrder() {
+  const Game& game = *set.game;
+  // dependency graph of fields: set fields are nodes 0..n_set-1, card fields come after that
+  size_t n_set = game.set_fields.size();
+  size_t n = n_set + game.card_fields.size();
+  vector<vector<size_t>> edges(n);
+  // fields that can't be updated for different cards at the same time
+  vector<bool> serial(n, false);
+  for (size_t i = 0 ; i < n ; ++i) {
+    const Field& f = i < n_set ? *game.set_fields[i] : *game.card_fields[i - n_set];
+    std::set<const Field*> copied;
+    vector<size_t> cross_card;
+    add_update_edges(game, f.dependent_scripts, edges[i], copied, &cross_card);
+    // other cards look at this field
+    if (!cross_card.empty()) serial[i] = true;
+    for (size_t to : cross_card) serial[to] = true;
+  }
+  {
+    // scripts using the card list or the keywords use caches in the set, like position_of and expand_keywords
+    vector<size_t> uses_set;
+    std::set<const Field*> copied;
+    add_update_edges(game, game.dependent_scripts_cards,    uses_set, copied);
+    add_update_edges(game, game.dependent_scripts_keywords, uses_set, copied);
+    for (size_t to : uses_set) serial[to] = true;
+  }
+  // and the card fields that depend on those card fields
+  // set fields are always updated before the cards, so it is safe to depend on those
+  vector<size_t> todo;
+  for (size_t i = n_set ; i < n ; ++i) {
+    if (serial[i]) todo.push_back(i);
+  }
+  while (!todo.empty()) {
+    size_t node = todo.back();
+    todo.pop_back();
+    for (size_t to : edges[node]) {
+      if (to >= n_set && !serial[to]) {
+        serial[to] = true;
+        todo.push_back(to);
+      }
+    }
+  }
+  parallel_card_fields.assign(game.card_fields.size(), false);
+  for (size_t i = 0 ; i < game.card_fields.size() ; ++i) {
+    parallel_card_fields[i] = !serial[n_set + i];
+  }
+  // topological sort, where possible keep the order of the fields in the game
+  vector<size_t> in_degree(n, 0);
+  FOR_EACH_CONST(e, edges) {
+    for (size_t to : e) in_degree[to]++;
+  }
+  vector<bool> done(n, false);
+  std::set<size_t> ready;
+  for (size_t i = 0 ; i < n ; ++i) {
+    if (in_degree[i] == 0) ready.insert(i);
+  }
+  update_order.assign(n, 0);
+  size_t first_not_done = 0;
+  for (size_t order = 0 ; order < n ; ++order) {
+    size_t node;
+    if (!ready.empty()) {
+      node = *ready.begin();
+      ready.erase(ready.begin());
+    } else {
+      // a cycle, there is no right order, just take the first remaining field
+      while (done[first_not_done]) ++first_not_done;
+      node = first_not_done;
+    }
+    done[node] = true;
+    update_order[node] = order;
+    for (size_t to : edges[node]) {
+      if (!done[to] && --in_degree[to] == 0) ready.insert(to);
+    }
+  }
+}
+
+size_t SetScriptManager::updateOrder(bool card_field, size_t index) {
+  if (update_order.empty() && set.game->dependencies_initialized) {
+    initUpdateOrder();
+  }
+  size_t node = card_field ? set.game->set_fields.size() + index : index;
+  return node < update_order.size() ? update_order[node] : node;
+}
+
+bool SetScriptManager::parallelCardField(size_t index) const {
+  return index < parallel_card_fields.size() && parallel_card_fields[index];
+}
+
+SetScriptManager::UpdateQueue::UpdateQueue()
+  : seq(0)
+{}
+
+void SetScriptManager::UpdateQueue::push(Value* value, const CardP& card, size_t order) {
+  if (starting_age <= value->last_script_update) return; // already updated
+  if (!queued.insert(value).second) return; // already queued
+  Item item = {order, seq++, ToUpdate(value, card)};
+  items.push(item);
+}
+
+SetScriptManager::ToUpdate SetScriptManager::UpdateQueue::pop() {
+  ToUpdate u = items.top().u;
+  items.pop();
+  queued.erase(u.value);
+  return u;
+}
+
+bool SetScriptManager::UpdateQueue::queueAllCards(size_t field_index) {
+  return all_cards.insert(field_index).second;
+}
+
 // ----------------------------------------------------------------------------- : ScriptManager : updating
 
 void SetScriptManager::onAction(const Action& action, bool undone) {
@@ -218,6 +400,7 @@ void SetScriptManager::onAction(const Action& action, bool undone) {
 
 void SetScriptManager::updateStyles(const CardP& card, bool only_content_dependent) {
   assert(card);
+  StageTimer timer(STAGE_SCRIPT_UPDATE);
   const StyleSheet& stylesheet = set.stylesheetFor(card);
   Context& ctx = getContext(card);
   if (!only_content_dependent) {
@@ -258,8 +441,7 @@ void SetScriptManager::updateDelayed() {
 }
 
 void SetScriptManager::updateValue(Value& value, const CardP& card) {
-  Age starting_age; // the start of the update process
-  deque<ToUpdate> to_update;
+  UpdateQueue to_update; // the start of the update process
   // execute script for initial changed value
   value.update(getContext(card));
   #ifdef LOG_UPDATES
@@ -267,20 +449,98 @@ void SetScriptManager::updateValue(Value& value, const CardP& card) {
   #endif
   // update dependent scripts
   alsoUpdate(to_update, value.fieldP->dependent_scripts, card);
-  updateRecursive(to_update, starting_age);
+  updateRecursive(to_update);
   #ifdef LOG_UPDATES
     wxLogDebug(_("-------------------------------\n"));
   #endif
 }
 
-void SetScriptManager::updateAll() {
+/// Don't start a thread for updating fewer cards than this
+const size_t MIN_CARDS_PER_UPDATE_JOB = 16;
+
+/// Thread that updates some fields of a range of cards
+class CardUpdateThread : public wxThread {
+public:
+  CardUpdateThread(SetScriptContext& parent, vector<CardP>&& cards, const vector<size_t>& card_fields)
+    : wxThread(wxTHREAD_JOINABLE)
+    , cards(move(cards)), card_fields(card_fields)
+    , fork(parent, this->cards)
+  {}
+  
+  ExitCode Entry() override {
+    try {
+      FOR_EACH(card, cards) {
+        Context& ctx = fork.getContext(card);
+        for (size_t i : card_fields) {
+          if (i >= card->data.size()) continue;
+          const ValueP& v = card->data.at(i);
+          try {
+            v->update(ctx);
+          } catch (const ScriptError& e) {
+            errors.push_back(e.what() + _("\n  while updating card value '") + v->fieldP->name + _("'"));
+          }
+        }
+      }
+    } catch (...) {
+      failure = current_exception();
+    }
+    return 0;
+  }
+  
+  vector<String> errors; ///< Script errors, in the order of the cards
+  exception_ptr failure; ///< Other exception that stopped the thread
+private:
+  vector<CardP> cards;
+  const vector<size_t>& card_fields;
+  SetScriptContextFork fork;
+};
+
+void SetScriptManager::updateCardsParallel(const vector<size_t>& card_fields, int jobs) {
+  // give each thread a consecutive range of cards
+  // the forks must be made on this thread, before any thread starts
+  vector<unique_ptr<CardUpdateThread>> threads;
+  size_t n = set.cards.size();
+  for (int j = 0 ; j < jobs ; ++j) {
+    vector<CardP> cards(set.cards.begin() + n * j / jobs, set.cards.begin() + n * (j + 1) / jobs);
+    threads.push_back(make_unique<CardUpdateThread>(*this, move(cards), card_fields));
+  }
+  vector<bool> running(jobs, false);
+  for (int j = 0 ; j < jobs ; ++j) {
+    running[j] = threads[j]->Run() == wxTHREAD_NO_ERROR;
+    if (!running[j]) {
+      // couldn't start the thread, do its work here
+      threads[j]->Entry();
+    }
+  }
+  for (int j = 0 ; j < jobs ; ++j) {
+    if (running[j]) threads[j]->Wait();
+  }
+  // report errors in the order of the cards
+  FOR_EACH(t, threads) {
+    if (t->failure) rethrow_exception(t->failure);
+    FOR_EACH(e, t->errors) handle_error(ScriptError(e));
+  }
+}
+
+int SetScriptManager::updateAll(bool parallel, int max_jobs) {
   #ifdef LOG_UPDATES
     wxLogDebug(_("Update all"));
   #endif
   wxBusyCursor busy;
   // update set data
   Context& ctx = getContext(set.stylesheet);
-  FOR_EACH(v, set.data) {
+  // in the update order, so values are updated after the values they depend on
+  vector<size_t> set_fields(set.data.size()), card_fields(set.game->card_fields.size());
+  for (size_t i = 0 ; i < set_fields.size()  ; ++i) set_fields[i]  = i;
+  for (size_t i = 0 ; i < card_fields.size() ; ++i) card_fields[i] = i;
+  sort(set_fields.begin(), set_fields.end(), [this](size_t a, size_t b) {
+    return updateOrder(false, a) < updateOrder(false, b);
+  });
+  sort(card_fields.begin(), card_fields.end(), [this](size_t a, size_t b) {
+    return updateOrder(true, a) < updateOrder(true, b);
+  });
+  for (size_t i : set_fields) {
+    const ValueP& v = set.data.at(i);
     try {
       PROFILER2( v->fieldP.get(), _("update set.") + v->fieldP->name );
       v->update(ctx);
@@ -289,9 +549,31 @@ void SetScriptManager::updateAll() {
     }
   }
   // update card data of all cards
+  // first the fields that can be updated in parallel, then the rest one card at a time, in the same order as before
+  vector<size_t> serial_fields = card_fields;
+  int jobs_used = 1;
+  #if !USE_SCRIPT_PROFILING // the profiler is not thread safe
+  if (parallel && wxThread::IsMain()) {
+    vector<size_t> parallel_fields;
+    serial_fields.clear();
+    for (size_t i : card_fields) {
+      (parallelCardField(i) ? parallel_fields : serial_fields).push_back(i);
+    }
+    int jobs = max_jobs > 0 ? max_jobs : min(wxThread::GetCPUCount(), 8);
+    jobs = min(jobs, (int)(set.cards.size() / MIN_CARDS_PER_UPDATE_JOB));
+    if (jobs > 1 && !parallel_fields.empty()) {
+      updateCardsParallel(parallel_fields, jobs);
+      jobs_used = jobs;
+    } else {
+      serial_fields = card_fields;
+    }
+  }
+  #endif
   FOR_EACH(card, set.cards) {
     Context& ctx = getContext(card);
-    FOR_EACH(v, card->data) {
+    for (size_t i : serial_fields) {
+      if (i >= card->data.size()) continue;
+      const ValueP& v = card->data.at(i);
       try {
         #if USE_SCRIPT_PROFILING
           Timer t;
@@ -308,27 +590,26 @@ void SetScriptManager::updateAll() {
   #ifdef LOG_UPDATES
     wxLogDebug(_("-------------------------------\n"));
   #endif
+  return jobs_used;
 }
 
 void SetScriptManager::updateAllDependend(const vector<Dependency>& dependent_scripts, const CardP& card) {
-  deque<ToUpdate> to_update;
-  Age starting_age;
+  UpdateQueue to_update;
   alsoUpdate(to_update, dependent_scripts, card);
-  updateRecursive(to_update, starting_age);
+  updateRecursive(to_update);
 }
 
-void SetScriptManager::updateRecursive(deque<ToUpdate>& to_update, Age starting_age) {
+void SetScriptManager::updateRecursive(UpdateQueue& to_update) {
   if (to_update.empty()) return;
   set.clearOrderCache(); // clear caches before evaluating a round of scripts
   while (!to_update.empty()) {
-    updateToUpdate(to_update.front(), to_update, starting_age);
-    to_update.pop_front();
+    updateToUpdate(to_update.pop(), to_update);
   }
 }
 
-void SetScriptManager::updateToUpdate(const ToUpdate& u, deque<ToUpdate>& to_update, Age starting_age) {
+void SetScriptManager::updateToUpdate(const ToUpdate& u, UpdateQueue& to_update) {
   Age age = u.value->last_script_update;
-  if (starting_age <= age)  return; // this value was already updated
+  if (to_update.starting_age <= age)  return; // this value was already updated
   Context& ctx = getContext(u.card);
   bool changes = false;
   try {
@@ -352,26 +633,29 @@ void SetScriptManager::updateToUpdate(const ToUpdate& u, deque<ToUpdate>& to_upd
   #endif
 }
 
-void SetScriptManager::alsoUpdate(deque<ToUpdate>& to_update, const vector<Dependency>& deps, const CardP& card) {
+void SetScriptManager::alsoUpdate(UpdateQueue& to_update, const vector<Dependency>& deps, const CardP& card) {
   FOR_EACH_CONST(d, deps) {
     switch (d.type) {
       case DEP_SET_FIELD: {
         ValueP value = set.data.at(d.index);
-        to_update.push_back(ToUpdate(value.get(), CardP()));
+        to_update.push(value.get(), CardP(), updateOrder(false, d.index));
         break;
       } case DEP_CARD_FIELD: {
         if (card) {
           ValueP value = card->data.at(d.index);
-          to_update.push_back(ToUpdate(value.get(), card));
+          to_update.push(value.get(), card, updateOrder(true, d.index));
           break;
         } else {
           // There is no card, so the update should affect all cards (fall through).
         }
       } case DEP_CARDS_FIELD: {
         // something invalidates a card value for all cards, so all cards need updating
+        // but only once per round, after that all these values are either queued or up to date
+        if (!to_update.queueAllCards(d.index)) break;
+        size_t order = updateOrder(true, d.index);
         FOR_EACH(card, set.cards) {
           ValueP value = card->data.at(d.index);
-          to_update.push_back(ToUpdate(value.get(), card));
+          to_update.push(value.get(), card, order);
         }
         break;
       } case DEP_CARD_STYLE: {
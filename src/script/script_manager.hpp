@@ -35,12 +35,48 @@ public:
   /// Get a context to use for the set, for a given card
   Context& getContext(const CardP&);
   
+  /// Make an independent copy of the context for a stylesheet
+  /** The init scripts are only run once, when the context returned by getContext is created.
+   *  Should be called from the thread that uses this SetScriptContext.
+   */
+  Context forkContext(const StyleSheetP&);
+  
 protected:
   Set& set; ///< Set for which we are managing scripts
   map<const StyleSheet*,Context> contexts; ///< Context for evaluating scripts that use a given stylesheet
   
   /// Called when a new context for a stylesheet is initialized
   virtual void onInit(const StyleSheetP& stylesheet, Context& ctx) {}
+  
+  friend class SetScriptContextFork;
+};
+
+// ----------------------------------------------------------------------------- : SetScriptContextFork
+
+/// Copies of the script contexts of a set, for evaluating card scripts from another thread
+/** The contexts are forked from a SetScriptContext, so the init scripts of the game and the stylesheets
+ *  don't have to be run again. Each fork should only be used by one thread at a time,
+ *  several forks of the same set can be used at the same time.
+ *
+ *  Note: functions that use the set's own caches (position_of, number_of_items with a filter, expand_keywords)
+ *        are not safe to call from a fork, scripts using them should be evaluated on the main thread.
+ */
+class SetScriptContextFork {
+public:
+  /// Fork the contexts of parent, for evaluating scripts of the given cards
+  /** Must be called from the thread that uses parent (usually the main thread).
+   */
+  SetScriptContextFork(SetScriptContext& parent, const vector<CardP>& cards);
+  
+  /// Get a context to use for the set, for a given stylesheet
+  Context& getContext(const StyleSheetP&);
+  /// Get a context to use for the set, for a given card
+  /** The card must be one of the cards passed to the constructor. */
+  Context& getContext(const CardP&);
+  
+private:
+  Set& set;
+  map<const StyleSheet*,Context> contexts;
 };
 
 
@@ -67,8 +103,12 @@ public:
   /// Update all fields of all cards
   /** Update all set info fields
    *  Doesn't update styles
+   *  If parallel, the card fields that only depend on their own card are updated by several threads,
+   *  each with a fork of the contexts, before the other card fields are updated on this thread.
+   *  There are at most max_jobs threads, or one for each processor (up to 8) if max_jobs is 0.
+   *  Returns the number of threads that updated card values, 1 if they were updated one card at a time.
    */
-  void updateAll();
+  int updateAll(bool parallel = true, int max_jobs = 0);
   
 private:
   void onInit(const StyleSheetP& stylesheet, Context& ctx) override;
@@ -90,13 +130,70 @@ private:
     Value* value;  ///< value to update
     CardP  card;   ///< card the value is in, or CadP() if it is not a card field
   };
+  
+  /// The values that are still to be updated in one round of updates
+  /** Values are updated in the topological order of their fields (see initUpdateOrder),
+   *  so a value is only updated after the values it depends on.
+   *  Each value is queued and updated at most once per round; values that don't change
+   *  don't cause their dependencies to be queued.
+   */
+  class UpdateQueue {
+  public:
+    UpdateQueue();
+    
+    Age starting_age; ///< Values updated after this are up to date
+    
+    inline bool empty() const { return items.empty(); }
+    /// Queue a value, unless it is already queued, or was already updated in this round
+    void push(Value* value, const CardP& card, size_t order);
+    /// Remove the value that comes first in the update order
+    ToUpdate pop();
+    /// Note that a card field is queued for all cards
+    /** Returns false if this already happened in this round, then there is nothing to do,
+     *  since all cards are either still in the queue or already up to date.
+     */
+    bool queueAllCards(size_t field_index);
+    
+  private:
+    struct Item {
+      size_t   order; ///< Position of the field in the update order
+      size_t   seq;   ///< Items with the same order are updated first-come first-served
+      ToUpdate u;
+      inline bool operator < (const Item& that) const {
+        // priority_queue gives the largest item first
+        return order > that.order || (order == that.order && seq > that.seq);
+      }
+    };
+    priority_queue<Item>   items;
+    std::set<const Value*> queued;    ///< Values in items
+    std::set<size_t>       all_cards; ///< Card fields that are queued for all cards
+    size_t                 seq;
+  };
+  
+  /// Position of each field in the update order, set fields first, then card fields
+  vector<size_t> update_order;
+  /// Can a card field be updated for different cards at the same time?
+  /** Not if its script looks at other cards, the card list or the keywords (these use caches in the set),
+   *  if another card looks at it, or if it depends on such a field.
+   */
+  vector<bool> parallel_card_fields;
+  /// Determine the update order from the dependencies between the fields of the game,
+  /// and which card fields can be updated in parallel
+  void initUpdateOrder();
+  /// Position of a set or card field in the update order
+  size_t updateOrder(bool card_field, size_t index);
+  /// Can a card field be updated in parallel? Call after updateOrder
+  bool parallelCardField(size_t index) const;
+  /// Update the given card fields of all cards, using several threads
+  void updateCardsParallel(const vector<size_t>& card_fields, int jobs);
+  
   /// Update all things in to_update, and things that depent on them, etc.
-  /** Only update things that are older than starting_age. */
-  void updateRecursive(deque<ToUpdate>& to_update, Age starting_age);
+  /** Only update things that are older than to_update.starting_age. */
+  void updateRecursive(UpdateQueue& to_update);
   /// Update a value given by a ToUpdate object, and add things depending on it to to_update
-  void updateToUpdate(const ToUpdate& u, deque<ToUpdate>& to_update, Age starting_age);
+  void updateToUpdate(const ToUpdate& u, UpdateQueue& to_update);
   /// Schedule all things in deps to be updated by adding them to to_update
-  void alsoUpdate(deque<ToUpdate>& to_update, const vector<Dependency>& deps, const CardP& card);
+  void alsoUpdate(UpdateQueue& to_update, const vector<Dependency>& deps, const CardP& card);
   
   /// Delayed update for (bitmask)...
   enum Delay
@@ -11,6 +11,7 @@
 #include <script/context.hpp>
 #include <script/parser.hpp>
 #include <script/script.hpp>
+#include <script/script_cache.hpp>
 #include <script/value.hpp>
 #include <gfx/color.hpp>
 
@@ -28,6 +29,10 @@ void store(const ScriptValueP& val, Defaultable<Color>&  var) { var.assign(val->
 void store(const ScriptValueP& val, Alignment& var)           { var = alignment_from_string(val->toString()); }
 void store(const ScriptValueP& val, Direction& var)           { parse_enum(val->toString(),var); }
 
+// ----------------------------------------------------------------------------- : Recording
+
+vector<ScriptSource>* recorded_script_sources = nullptr;
+
 // ----------------------------------------------------------------------------- : OptionalScript
 
 OptionalScript::OptionalScript(const String& script_)
@@ -46,8 +51,16 @@ ScriptValueP OptionalScript::invoke(Context& ctx, bool open_scope) const {
 }
 
 void OptionalScript::parse(Reader& reader, bool string_mode) {
+  if (recorded_script_sources) {
+    recorded_script_sources->push_back({unparsed, string_mode, reader.getPackage()});
+  }
+  script = script_cache.find(unparsed, string_mode);
+  if (script) return;
   vector<ScriptParseError> errors;
   script = ::parse(unparsed, reader.getPackage(), string_mode, errors);
+  if (script && errors.empty()) {
+    script_cache.store(unparsed, string_mode, *script);
+  }
   // show parse errors as warnings
   String include_warnings;
   for (size_t i = 0 ; i < errors.size() ; ++i) {
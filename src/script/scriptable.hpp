@@ -32,6 +32,18 @@ void store(const ScriptValueP& val, Defaultable<Color>&  var);
 void store(const ScriptValueP& val, Alignment& var);
 void store(const ScriptValueP& val, Direction& var);
 
+// ----------------------------------------------------------------------------- : Recording
+
+/// A script that was parsed while reading a file
+struct ScriptSource {
+  String    source;
+  bool      string_mode;
+  Packaged* package; ///< Package the script is from, for include files
+};
+
+/// If not null, all scripts parsed while reading files are added to this list, for benchmarking the parser
+extern vector<ScriptSource>* recorded_script_sources;
+
 // ----------------------------------------------------------------------------- : OptionalScript
 
 template <typename T>
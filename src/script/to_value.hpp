@@ -19,6 +19,10 @@
   #include <typeinfo>
 #endif
 
+DECLARE_POINTER_TYPE(Field);
+DECLARE_POINTER_TYPE(Value);
+struct CacheCounter;
+
 // ----------------------------------------------------------------------------- : Overloadable templates
 
 /// Number of items in some collection like object, can be overloaded
@@ -32,6 +36,13 @@ ScriptValueP make_iterator(const T& v) {
   return ScriptValueP();
 }
 
+/// The values that are nameless members of an object, can be overloaded
+/** For example card.name is card.data["name"]. Used for finding members with an inline cache. */
+template <typename T>
+const IndexMap<FieldP,ValueP>* nameless_members(const T& v) {
+  return nullptr;
+}
+
 /// Mark a dependency on a member of value, can be overloaded
 template <typename T>
 void mark_dependency_member(const T& value, const String& name, const Dependency& dep) {}
@@ -165,6 +176,43 @@ ScriptValueP get_member(const IndexMap<K,V>& m, const String& name) {
   }
 }
 
+/// Tag for inline cache keys of nameless members found through a ScriptObject
+/** Objects have named members that take precedence over their nameless members,
+ *  so these cache entries must not be used for plain maps, or the other way around.
+ */
+const uintptr_t MEMBER_CACHE_OBJECT = 1;
+
+/// The value that an inline member cache refers to, if the map contains it
+template <typename K, typename V>
+const V* find_member_cached(const IndexMap<K,V>& m, const MemberCache& cache, uintptr_t tag) {
+  size_t index  = cache.getIndex();
+  uintptr_t key = cache.getKey();
+  if (key && index < m.size() && ((uintptr_t)get_key(m[index]).get() | tag) == key) {
+    return &m[index];
+  } else {
+    return nullptr;
+  }
+}
+
+template <typename Container>
+ScriptValueP get_member(const Container& m, const String& name, MemberCache&) {
+  return get_member(m, name);
+}
+
+template <typename K, typename V>
+ScriptValueP get_member(const IndexMap<K,V>& m, const String& name, MemberCache& cache) {
+  if (const V* v = find_member_cached(m, cache, 0)) {
+    return to_script(*v);
+  }
+  typename IndexMap<K,V>::const_iterator it = m.find(name);
+  if (it != m.end()) {
+    cache.set((uintptr_t)get_key(*it).get(), it - m.begin());
+    return to_script(*it);
+  } else {
+    return delay_error(ScriptErrorNoMember(_TYPE_("collection"), name));
+  }
+}
+
 /// Script value containing a map-like collection
 template <typename Collection>
 class ScriptMap : public ScriptValue {
@@ -175,6 +223,9 @@ public:
   ScriptValueP getMember(const String& name) const override {
     return get_member(*value, name);
   }
+  ScriptValueP getMemberCached(const String& name, MemberCache& cache) const override {
+    return get_member(*value, name, cache);
+  }
   int itemCount() const override { return (int)value->size(); }
   ScriptValueP dependencyMember(const String& name, const Dependency& dep) const override {
     mark_dependency_member(*value, name, dep);
@@ -294,23 +345,16 @@ public:
     ScriptValueP d = getDefault(); return d ? d->toImage() : ScriptValue::toImage();
   }
   ScriptValueP getMember(const String& name) const override {
-    #if USE_SCRIPT_PROFILING
-      Timer t;
-      Profiler prof(t, (void*)mangled_name(typeid(T)), _("get member of ") + type_name(*value));
-    #endif
-    // Use reflection to find the member of the object
-    GetMember gm(name);
-    gm.handle(*value);
-    if (gm.result()) return gm.result();
-    else {
-      // try nameless member
-      ScriptValueP d = getDefault();
-      if (d) {
-        return d->getMember(name);
-      } else {
-        return ScriptValue::getMember(name);
-      }
+    return getMember(name, nullptr);
+  }
+  ScriptValueP getMemberCached(const String& name, MemberCache& cache) const override {
+    // nameless members can be found without going through the reflection code
+    const IndexMap<FieldP,ValueP>* data = nameless_members(*value);
+    if (!data) return getMember(name, nullptr);
+    if (const ValueP* v = find_member_cached(*data, cache, MEMBER_CACHE_OBJECT)) {
+      return to_script(*v);
     }
+    return getMember(name, &cache);
   }
   ScriptValueP getIndex(int index) const override {
     ScriptValueP d = getDefault(); return d ? d->getIndex(index) : ScriptValue::getIndex(index);
@@ -350,6 +394,29 @@ public:
   inline T getValue() const { return value; }
 private:
   T value; ///< The object
+  ScriptValueP getMember(const String& name, MemberCache* cache) const {
+    #if USE_SCRIPT_PROFILING
+      Timer t;
+      Profiler prof(t, (void*)mangled_name(typeid(T)), _("get member of ") + type_name(*value));
+    #endif
+    // Use reflection to find the member of the object
+    GetMember gm(name);
+    gm.handle(*value);
+    if (gm.result()) {
+      if (cache && gm.namelessKey()) {
+        cache->set(gm.namelessKey() | MEMBER_CACHE_OBJECT, gm.namelessIndex());
+      }
+      return gm.result();
+    } else {
+      // try nameless member
+      ScriptValueP d = getDefault();
+      if (d) {
+        return d->getMember(name);
+      } else {
+        return ScriptValue::getMember(name);
+      }
+    }
+  }
   ScriptValueP getDefault() const {
     GetDefaultMember gdm;
     gdm.handle(*value);
@@ -406,6 +473,10 @@ extern ScriptValueP script_nil; ///< The preallocated nil value
 extern ScriptValueP script_true; ///< The preallocated true value
 extern ScriptValueP script_false; ///< The preallocated false value
 extern ScriptValueP dependency_dummy; ///< Dummy value used during dependency analysis
+#if USE_SCRIPT_PROFILING
+  /// Numbers converted with to_script, hits are preallocated small numbers, misses are new allocations
+  extern CacheCounter small_number_cache_counter;
+#endif
 
 /// Convert a value to a script value
 ScriptValueP to_script(int           v);
@@ -414,6 +485,10 @@ ScriptValueP to_script(const String& v);
 ScriptValueP to_script(Color         v);
 ScriptValueP to_script(wxDateTime    v);
 
+/// Concatenate two values as strings
+/** Long strings are appended to in place where possible, so building a string in a loop takes linear time. */
+ScriptValueP concat_script_strings(const ScriptValueP& a, const ScriptValueP& b);
+
 inline ScriptValueP to_script(long v) {
   return to_script((int) v);
 }
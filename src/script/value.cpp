@@ -13,7 +13,10 @@
 #include <script/context.hpp>
 #include <gfx/generated_image.hpp>
 #include <util/error.hpp>
+#include <util/lru_cache.hpp>
 #include <boost/pool/singleton_pool.hpp>
+#include <wx/thread.h>
+#include <cmath>
 
 // ----------------------------------------------------------------------------- : ScriptValue
 // Base cases
@@ -69,6 +72,15 @@ ScriptValueP ScriptValue::getMember(const String& name) const {
     return delay_error(ScriptErrorNoMember(typeName(), name));
   }
 }
+ScriptValueP ScriptValue::getMemberCached(const String& name, MemberCache&) const {
+  return getMember(name);
+}
+
+atomic<uint32_t> MemberCache::member_cache_generation(0);
+
+void clear_member_caches() {
+  MemberCache::member_cache_generation.fetch_add(1, memory_order_relaxed);
+}
 ScriptValueP ScriptValue::getIndex(int index) const {
   return delay_error(ScriptErrorNoMember(typeName(), String()<<index));
 }
@@ -215,6 +227,33 @@ ScriptValueP rangeIterator(int start, int end) {
   #define USE_POOL_ALLOCATOR 0 // disabled by default
 #endif
 
+#ifndef USE_SMALL_NUMBER_CACHE
+  #define USE_SMALL_NUMBER_CACHE 1 // enabled by default, disable to compare with the benchmark
+#endif
+
+/// Range of numbers that are preallocated, loop counters and most arithmetic stays in here
+const int SMALL_NUMBER_MIN = -128;
+const int SMALL_NUMBER_MAX = 1023;
+
+#if USE_SCRIPT_PROFILING
+  CacheCounter small_number_cache_counter;
+  #define COUNT_SMALL_NUMBER(x) small_number_cache_counter.x.fetch_add(1, memory_order_relaxed)
+#else
+  #define COUNT_SMALL_NUMBER(x) // only counted when profiling, the counter is shared by all threads
+#endif
+
+/// Make a table of preallocated values for all small numbers
+/** The table is never freed: with the pool allocator the pool can be destroyed before it.
+ */
+template <typename T>
+const ScriptValueP* make_small_number_table(ScriptValueP (*make)(T)) {
+  ScriptValueP* table = new ScriptValueP[SMALL_NUMBER_MAX - SMALL_NUMBER_MIN + 1];
+  for (int i = SMALL_NUMBER_MIN ; i <= SMALL_NUMBER_MAX ; ++i) {
+    table[i - SMALL_NUMBER_MIN] = make((T)i);
+  }
+  return table;
+}
+
 // Integer values
 class ScriptInt : public ScriptValue {
 public:
@@ -241,7 +280,7 @@ private:
   }
 #endif
 
-ScriptValueP to_script(int v) {
+ScriptValueP new_script_int(int v) {
 #if USE_POOL_ALLOCATOR
   #if USE_INTRUSIVE_PTR
     return ScriptValueP(
@@ -258,6 +297,18 @@ ScriptValueP to_script(int v) {
 #endif
 }
 
+ScriptValueP to_script(int v) {
+#if USE_SMALL_NUMBER_CACHE
+  if (v >= SMALL_NUMBER_MIN && v <= SMALL_NUMBER_MAX) {
+    static const ScriptValueP* small_ints = make_small_number_table(new_script_int);
+    COUNT_SMALL_NUMBER(hits);
+    return small_ints[v - SMALL_NUMBER_MIN];
+  }
+#endif
+  COUNT_SMALL_NUMBER(misses);
+  return new_script_int(v);
+}
+
 // ----------------------------------------------------------------------------- : Booleans
 
 // Boolean values
@@ -294,10 +345,23 @@ private:
   double value;
 };
 
-ScriptValueP to_script(double v) {
+ScriptValueP new_script_double(double v) {
   return make_intrusive<ScriptDouble>(v);
 }
 
+ScriptValueP to_script(double v) {
+#if USE_SMALL_NUMBER_CACHE
+  // only whole numbers, and not -0.0, that would print differently
+  if (v >= SMALL_NUMBER_MIN && v <= SMALL_NUMBER_MAX && v == (int)v && !(v == 0 && signbit(v))) {
+    static const ScriptValueP* small_doubles = make_small_number_table(new_script_double);
+    COUNT_SMALL_NUMBER(hits);
+    return small_doubles[(int)v - SMALL_NUMBER_MIN];
+  }
+#endif
+  COUNT_SMALL_NUMBER(misses);
+  return new_script_double(v);
+}
+
 // ----------------------------------------------------------------------------- : String type
 
 String quote_string(String const& str) {
@@ -391,6 +455,77 @@ ScriptValueP to_script(const String& v) {
   return make_intrusive<ScriptString>(v);
 }
 
+// ----------------------------------------------------------------------------- : String concatenation
+
+// Building a string in a loop, result := result + x, would copy the whole result for every +.
+// Instead longer strings are kept in a buffer that is appended to in place,
+// the values are prefixes of that buffer, so appending doesn't change existing values.
+
+/// Strings shorter than this are concatenated by copying
+const size_t STRING_BUFFER_MIN_LENGTH = 256;
+
+/// Buffer shared by strings that are made by appending to the same string
+struct StringBuffer {
+  wxMutex mutex;
+  String text;
+};
+
+/// A string value that is a prefix of a shared buffer
+class ScriptStringBuilder : public ScriptValue {
+public:
+  ScriptStringBuilder(const shared_ptr<StringBuffer>& buffer, size_t length) : buffer(buffer), length(length) {}
+  ScriptType type() const override { return SCRIPT_STRING; }
+  String toString() const override {
+    wxMutexLocker lock(buffer->mutex);
+    return buffer->text.substr(0, length);
+  }
+  int itemCount() const override { return (int)length; }
+  // a bit of a hack: use the ScriptString implementation for everything else
+  String typeName() const override { return to_script(toString())->typeName(); }
+  String toCode() const override { return quote_string(toString()); }
+  double toDouble() const override { return to_script(toString())->toDouble(); }
+  int toInt() const override { return to_script(toString())->toInt(); }
+  bool toBool() const override { return to_script(toString())->toBool(); }
+  Color toColor() const override { return to_script(toString())->toColor(); }
+  wxDateTime toDateTime() const override { return to_script(toString())->toDateTime(); }
+  GeneratedImageP toImage() const override { return to_script(toString())->toImage(); }
+  ScriptValueP getMember(const String& name) const override { return to_script(toString())->getMember(name); }
+  
+  /// Append to this string, in place if nothing else was appended to the buffer yet
+  ScriptValueP append(const String& more) const {
+    {
+      wxMutexLocker lock(buffer->mutex);
+      if (buffer->text.size() == length) {
+        buffer->text += more;
+        return make_intrusive<ScriptStringBuilder>(buffer, buffer->text.size());
+      }
+    }
+    return make(toString() + more);
+  }
+  
+  /// A new buffer containing the given text
+  static ScriptValueP make(String&& text) {
+    shared_ptr<StringBuffer> buffer = make_shared<StringBuffer>();
+    buffer->text = move(text);
+    return make_intrusive<ScriptStringBuilder>(buffer, buffer->text.size());
+  }
+private:
+  shared_ptr<StringBuffer> buffer;
+  size_t length;
+};
+
+ScriptValueP concat_script_strings(const ScriptValueP& a, const ScriptValueP& b) {
+  if (const ScriptStringBuilder* builder = dynamic_cast<const ScriptStringBuilder*>(a.get())) {
+    return builder->append(b->toString());
+  }
+  String text = a->toString() + b->toString();
+  if (text.size() < STRING_BUFFER_MIN_LENGTH) {
+    return to_script(text);
+  } else {
+    return ScriptStringBuilder::make(move(text));
+  }
+}
+
 
 // ----------------------------------------------------------------------------- : Color
 
@@ -10,6 +10,8 @@
 
 #include <util/prec.hpp>
 #include <gfx/color.hpp>
+#include <atomic>
+#include <cstdint>
 class Context;
 class Dependency;
 class ScriptClosure;
@@ -37,6 +39,44 @@ enum ScriptType
 ,  SCRIPT_ERROR
 };
 
+/// Inline cache for looking up a member with a constant name, there is one for each I_MEMBER_C instruction
+/** Remembers which key of a map the name resolved to last time, and at what index that key was.
+ *  The cached key is never dereferenced, a hit is only used after checking that the map contains that key at that index.
+ *  Scripts can be evaluated by multiple threads, so both parts are atomic;
+ *  a mix of an old index and a new key (or the reverse) just fails the check.
+ *
+ *  The key is an address, when the packages are unloaded a new key can get the address of an old one.
+ *  So the index is stored together with the member_cache_generation, entries from before the last
+ *  unloading are never used. Read the index before the key, then the key is at least as new as the index.
+ */
+class MemberCache {
+public:
+  MemberCache() : key(0), index(0) {}
+  MemberCache(const MemberCache& that) : key(that.key.load(memory_order_relaxed)), index(that.index.load(memory_order_relaxed)) {}
+  
+  /// The cached index, or (size_t)-1 if the entry is from an earlier generation
+  inline size_t getIndex() const {
+    uint64_t i = index.load(memory_order_acquire);
+    return (i >> 32) == member_cache_generation.load(memory_order_relaxed) ? (size_t)(uint32_t)i : (size_t)-1;
+  }
+  inline uintptr_t getKey() const { return key.load(memory_order_relaxed); }
+  inline void set(uintptr_t k, size_t i) {
+    if (i > UINT32_MAX) return;
+    key.store(k, memory_order_relaxed);
+    index.store((uint64_t)member_cache_generation.load(memory_order_relaxed) << 32 | i, memory_order_release);
+  }
+  
+  /// Generation of the keys, entries from other generations are not used
+  static atomic<uint32_t> member_cache_generation;
+private:
+  atomic<uintptr_t> key;
+  atomic<uint64_t>  index; ///< generation in the high bits
+};
+
+/// Forget the inline caches of all scripts
+/** Must be called when fields can be destroyed, since their addresses are used as keys */
+void clear_member_caches();
+
 enum CompareWhat
 {  COMPARE_NO
 ,  COMPARE_AS_STRING
@@ -77,6 +117,9 @@ public:
 
   /// Get a member variable from this value
   virtual ScriptValueP getMember(const String& name) const;
+  /// Get a member variable from this value, using the inline cache of the instruction that does the lookup
+  /** The name must always be the same for the same cache. The default implementation ignores the cache. */
+  virtual ScriptValueP getMemberCached(const String& name, MemberCache& cache) const;
 
   /// Signal that a script depends on this value itself
   virtual void dependencyThis(const Dependency& dep);
@@ -74,13 +74,14 @@ String clean_filename(const String& name) {
 bool resolve_filename_conflicts(wxFileName& fn, FilenameConflicts conflicts, set<String>& used) {
   switch (conflicts) {
     case CONFLICT_KEEP_OLD:
-      return !fn.FileExists();
+      // files in used may still be waiting to be written
+      return !fn.FileExists() && used.find(fn.GetFullPath()) == used.end();
     case CONFLICT_OVERWRITE:
       return true;
     case CONFLICT_NUMBER: {
       int i = 0;
       String ext = fn.GetExt();
-      while(fn.FileExists()) {
+      while(fn.FileExists() || used.find(fn.GetFullPath()) != used.end()) {
         fn.SetExt(String() << ++i << _(".") << ext);
       }
       return true;
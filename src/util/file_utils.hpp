@@ -35,7 +35,8 @@ String add_extension(const String& filename, String const& extension);
 String clean_filename(const String& name);
 
 /// Change the filename fn if it already exists, in the way described by conflicts.
-/** Returns true if the filename should be used, false if failed. */
+/** Filenames in used count as existing files, even if they have not been written yet.
+ *  Returns true if the filename should be used, false if failed. */
 bool resolve_filename_conflicts(wxFileName& fn, FilenameConflicts conflicts, set<String>& used);
 
 // ----------------------------------------------------------------------------- : File info
@@ -11,6 +11,7 @@
 #include <vector>
 #include <map>
 #include <util/string.hpp>
+#include <util/interned_name.hpp>
 
 // ----------------------------------------------------------------------------- : IndexMap
 
@@ -22,7 +23,8 @@
  *   - There must exist a function Key get_key(Value)
  *     that returns a key for a given value
  *   - For reflection there must exist a function String get_key_name(Value)
- *     that returns the key in string form
+ *     that returns the key in string form,
+ *     and a function NameId get_key_name_id(Value) that returns the interned key name
  *   - O(1) inserts and lookups
  *
  *  The 'map' is actually just a vector of values, each key has an index
@@ -105,10 +107,14 @@ public:
   }
   
   /// Find a value given the key name, return an iterator
-  template <typename Name>
-  typename vector<Value>::const_iterator find(const Name& key) const {
+  typename vector<Value>::const_iterator find(const String& key) const {
+    return find(find_name_id(key));
+  }
+  /// Find a value given the interned key name, return an iterator
+  typename vector<Value>::const_iterator find(NameId key) const {
+    if (key == NO_NAME_ID) return end();
     for(typename vector<Value>::const_iterator it = begin() ; it != end() ; ++it) {
-      if (get_key_name(*it) == key) return it;
+      if (get_key_name_id(*it) == key) return it;
     }
     return end();
   }
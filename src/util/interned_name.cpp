@@ -0,0 +1,52 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/interned_name.hpp>
+#include <util/error.hpp>
+#include <shared_mutex>
+
+// ----------------------------------------------------------------------------- : Interned names
+
+/// Ids of all interned names, names are never removed
+unordered_map<String, NameId> name_ids;
+/// Interned names, by id
+vector<String> names_by_id;
+/// Names are interned from multiple threads (see SetScriptContextFork), so guard the table.
+/** Almost all names are added while loading, after that there are only lookups,
+ *  so lookups share the lock, and only adding a name takes it exclusively.
+ */
+shared_mutex names_mutex;
+
+NameId intern_name(const String& name) {
+  {
+    shared_lock<shared_mutex> lock(names_mutex);
+    auto it = name_ids.find(name);
+    if (it != name_ids.end()) return it->second;
+  }
+  unique_lock<shared_mutex> lock(names_mutex);
+  auto it = name_ids.try_emplace(name, (NameId)names_by_id.size());
+  if (it.second) {
+    names_by_id.push_back(name);
+  }
+  return it.first->second;
+}
+
+NameId find_name_id(const String& name) {
+  shared_lock<shared_mutex> lock(names_mutex);
+  auto it = name_ids.find(name);
+  return it == name_ids.end() ? NO_NAME_ID : it->second;
+}
+
+String name_from_id(NameId id) {
+  shared_lock<shared_mutex> lock(names_mutex);
+  if (id >= names_by_id.size()) {
+    throw InternalError(String(_("Name not found: ")) << id);
+  }
+  return names_by_id[id];
+}
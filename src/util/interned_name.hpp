@@ -0,0 +1,32 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/string.hpp>
+
+// ----------------------------------------------------------------------------- : Interned names
+
+/// A unique integer for a name, so names can be compared without comparing strings
+/** Script variables (see string_to_variable) and field names share the same table,
+ *  so the id of a field name is also the Variable with that name.
+ */
+typedef unsigned int NameId;
+
+/// The id of a name that was never interned
+const NameId NO_NAME_ID = (NameId)-1;
+
+/// Get the id of a name, adding the name to the table if needed
+NameId intern_name(const String& name);
+
+/// Get the id of a name if it was interned before, otherwise return NO_NAME_ID
+/** Use this for lookups, so names that don't exist are not added to the table. */
+NameId find_name_id(const String& name);
+
+/// Get the name with the given id
+String name_from_id(NameId id);
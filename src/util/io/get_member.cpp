@@ -36,7 +36,7 @@ template <> void GetDefaultMember::handle(const wxDateTime&   v) { value = to_sc
 // ----------------------------------------------------------------------------- : GetMember
 
 GetMember::GetMember(const String& name)
-  : target_name(name)
+  : target_name(name), target_id(find_name_id(name)), nameless_key(0), nameless_index(0)
 {}
 
 // caused by the pattern: if (!handler.isCompound()) { REFLECT_NAMELESS(stuff) }
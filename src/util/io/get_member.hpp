@@ -85,6 +85,10 @@ public:
 
   /// The result, or script_nil if the member was not found
   inline ScriptValueP result() { return gdm.result(); } 
+  /// If the result was found in a nameless index map: the key it was found under, otherwise 0
+  inline uintptr_t namelessKey() const { return nameless_key; }
+  /// If the result was found in a nameless index map: the position in that map
+  inline size_t namelessIndex() const { return nameless_index; }
   
   // --------------------------------------------------- : Handling objects
   
@@ -103,11 +107,11 @@ public:
   /// Handle an index map: invistigate keys
   template <typename K, typename V> void handle(const IndexMap<K,V>& m) {
     if (gdm.result()) return;
-    for (typename IndexMap<K,V>::const_iterator it = m.begin() ; it != m.end() ; ++it) {
-      if (get_key_name(*it) == target_name) {
-        gdm.handle(*it);
-        return;
-      }
+    typename IndexMap<K,V>::const_iterator it = m.find(target_id);
+    if (it != m.end()) {
+      gdm.handle(*it);
+      nameless_key   = (uintptr_t)get_key(*it).get();
+      nameless_index = it - m.begin();
     }
   }
   template <typename K, typename V> void handle(const DelayedIndexMaps<K,V>&);
@@ -115,7 +119,10 @@ public:
   
 private:
   const String& target_name;  ///< The name we are looking for
+  NameId target_id;        ///< The interned name we are looking for, for index maps
   GetDefaultMember gdm;    ///< Object to store and retrieve the value
+  uintptr_t nameless_key;  ///< Key of the result, if it was found in a nameless index map
+  size_t nameless_index;   ///< Position of the result in that map
 };
 
 // ----------------------------------------------------------------------------- : Reflection
@@ -13,9 +13,12 @@
 #include <script/to_value.hpp> // for reflection
 #include <script/profiler.hpp> // for PROFILER
 #include <data/set.hpp>
+#include <gfx/generated_image.hpp>
 #include <wx/wfstream.h>
 #include <wx/zipstrm.h>
+#include <wx/mstream.h>
 #include <wx/dir.h>
+#include <list>
 
 // ----------------------------------------------------------------------------- : Package : outside
 
@@ -24,9 +27,12 @@ IMPLEMENT_DYNAMIC_ARG(Package*, clipboard_package, nullptr);
 
 Package::Package()
   : zipStream (nullptr)
+  , zipMutex  (wxMUTEX_RECURSIVE)
 {}
 
 Package::~Package() {
+  forget_generated_images(this);
+  clearZipCache();
   // remove any remaining temporary files
   FOR_EACH(f, files) {
     if (f.second.wasWritten()) {
@@ -85,6 +91,8 @@ void Package::open(const String& n, bool fast) {
 void Package::reopen() {
   if (wxDirExists(filename)) {
     // make sure we have no zip open
+    clearZipCache();
+    wxMutexLocker lock(zipMutex);
     zipStream.reset();
   } else {
     // reopen only needed for zipfile
@@ -174,6 +182,26 @@ public:
   }
 };
 
+/// Class to use as a superclass
+class SharedData_aux {
+protected:
+  shared_ptr<const vector<Byte>> data;
+  inline SharedData_aux(const shared_ptr<const vector<Byte>>& data)
+    : data(data)
+  {}
+};
+
+/// A memory stream that keeps its (shared) data alive
+/** The data can be dropped from the zip cache while the stream is still in use.
+ */
+class SharedMemoryInputStream : private SharedData_aux, public wxMemoryInputStream {
+public:
+  SharedMemoryInputStream(const shared_ptr<const vector<Byte>>& data)
+    : SharedData_aux(data)
+    , wxMemoryInputStream(data->data(), data->size())
+  {}
+};
+
 /// A buffered version of wxFileInputStream
 /** 2007-08-24:
  *    According to profiling this gives a significant speedup
@@ -208,8 +236,8 @@ bool Package::existsIn(const String& file) {
     stream = make_unique<wxFileInputStream>(filename + _("/") + file);
   }
   else if (wxFileExists(filename) && it != files.end() && it->second.zipEntry) {
-    // a file in a zip archive
-    stream = make_unique<ZipFileInputStream>(filename, it->second.zipEntry);
+    // a file in a zip archive, it is in the directory of the zip file, no need to read it
+    return true;
   }
   else {
     // shouldn't happen, packaged changed by someone else since opening it
@@ -240,7 +268,7 @@ unique_ptr<wxInputStream> Package::openIn(const String& file) {
     stream = make_unique<wxFileInputStream>(filename+_("/")+file);
   } else if (wxFileExists(filename) && it != files.end() && it->second.zipEntry) {
     // a file in a zip archive
-    stream = make_unique<ZipFileInputStream>(filename, it->second.zipEntry);
+    stream = openZipEntry(it->first, it->second.zipEntry);
   } else {
     // shouldn't happen, packaged changed by someone else since opening it
     throw FileNotFoundError(file, filename);
@@ -252,6 +280,112 @@ unique_ptr<wxInputStream> Package::openIn(const String& file) {
   }
 }
 
+// ----------------------------------------------------------------------------- : Package : zip cache
+
+/// Maximum total size of the decompressed files kept in memory, for all packages together
+const size_t ZIP_CACHE_BUDGET = 16 * 1024 * 1024;
+/// Larger files are read into memory, but not kept
+const size_t ZIP_CACHE_MAX_FILE = ZIP_CACHE_BUDGET / 4;
+
+/// Recently read files from the zip files of all packages, the least recently used are removed first
+/** Shared between packages, so the memory used doesn't grow with the number of open packages.
+ *  Files are also read from other threads, all access is locked.
+ */
+class ZipCache {
+public:
+  typedef shared_ptr<const vector<Byte>> Data;
+  ZipCache() : size(0) {}
+  
+  /// Find a file, or return nullptr
+  Data find(const Package* package, const String& name) {
+    wxMutexLocker lock(mutex);
+    auto it = index.find(make_pair(package, name));
+    if (it == index.end()) return Data();
+    items.splice(items.begin(), items, it->second); // move to front
+    return it->second->second;
+  }
+  /// Add a file to the cache, if it is small enough
+  void store(const Package* package, const String& name, const Data& data) {
+    if (data->size() > ZIP_CACHE_MAX_FILE) return;
+    wxMutexLocker lock(mutex);
+    Key key(package, name);
+    if (index.find(key) != index.end()) return; // read by another thread in the meantime
+    items.emplace_front(key, data);
+    index[key] = items.begin();
+    size += data->size();
+    while (size > ZIP_CACHE_BUDGET) {
+      size -= items.back().second->size();
+      index.erase(items.back().first);
+      items.pop_back();
+    }
+  }
+  /// Remove all files of a package
+  void remove(const Package* package) {
+    wxMutexLocker lock(mutex);
+    for (auto it = items.begin() ; it != items.end() ;) {
+      if (it->first.first == package) {
+        size -= it->second->size();
+        index.erase(it->first);
+        it = items.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  
+private:
+  typedef pair<const Package*, String> Key;
+  typedef list<pair<Key,Data>> Items;
+  wxMutex         mutex;
+  Items           items; ///< most recently used first
+  map<Key, Items::iterator> index;
+  size_t          size;  ///< Total size of the data in items
+};
+
+/// The cache is never destroyed, since packages can be destroyed during program exit
+ZipCache& zip_cache() {
+  static ZipCache* cache = new ZipCache;
+  return *cache;
+}
+
+unique_ptr<wxInputStream> Package::openZipEntry(const String& name, wxZipEntry* entry) {
+  ZipData data = readZipEntry(name, entry);
+  if (data) {
+    return make_unique<SharedMemoryInputStream>(data);
+  } else {
+    // fall back to a separate stream for this file
+    return make_unique<ZipFileInputStream>(filename, entry);
+  }
+}
+
+Package::ZipData Package::readZipEntry(const String& name, wxZipEntry* entry) {
+  // already in the cache?
+  if (ZipData cached = zip_cache().find(this, name)) return cached;
+  // read using the stream that is already open, this seeks directly to the entry
+  wxMutexLocker lock(zipMutex);
+  if (!zipStream || !zipStream->OpenEntry(*entry)) return ZipData();
+  auto data = make_shared<vector<Byte>>();
+  if (entry->GetSize() > 0) data->reserve((size_t)entry->GetSize());
+  Byte buffer[4096];
+  while (zipStream->CanRead()) {
+    zipStream->Read(buffer, sizeof(buffer));
+    size_t read = zipStream->LastRead();
+    if (read == 0) break;
+    data->insert(data->end(), buffer, buffer + read);
+  }
+  bool ok = zipStream->GetLastError() == wxSTREAM_EOF || zipStream->GetLastError() == wxSTREAM_NO_ERROR;
+  zipStream->CloseEntry();
+  if (!ok) return ZipData();
+  zip_cache().store(this, name, data);
+  return data;
+}
+
+void Package::clearZipCache() {
+  zip_cache().remove(this);
+}
+
+// ----------------------------------------------------------------------------- : Package : writing
+
 unique_ptr<wxOutputStream> Package::openOut(const String& file) {
   return make_unique<wxFileOutputStream>(nameOut(file));
 }
@@ -429,6 +563,8 @@ void Package::openSubdir(const String& name) {
 }
 
 void Package::openZipfile() {
+  clearZipCache();
+  wxMutexLocker lock(zipMutex);
   // open stream
   zipStream = make_unique<ZipFileInputStream>(filename);
   if (!zipStream->IsOk())  throw PackageError(_ERROR_1_("package not found", filename));
@@ -486,6 +622,7 @@ void Package::saveToZipfile(const String& saveAs, bool remove_unused, bool is_co
   remove_file(tempFile);
   // open zip file
   try {
+    wxMutexLocker lock(zipMutex); // the entries are copied with zipStream
     unique_ptr<wxFileOutputStream> newFile(new wxFileOutputStream(tempFile));
     if (!newFile->IsOk()) throw PackageError(_ERROR_("unable to open output file"));
     unique_ptr<wxZipOutputStream>  newZip(new wxZipOutputStream(*newFile));
@@ -510,6 +647,7 @@ void Package::saveToZipfile(const String& saveAs, bool remove_unused, bool is_co
     }
     // close the old file
     if (!is_copy) {
+      clearZipCache();
       zipStream.reset();
     }
   } catch (Error const& e) {
@@ -83,9 +83,12 @@ private:
  *  The zip input stream appears to only allow one file at a time, since the stream itself maintains
  *  state about what file we are reading.
  *  There are multiple solutions:
- *    1. (currently used) Open a new ZipInputStream for each file
- *    2. (may be faster) First read the file into a memory buffer,
- *      return a stream based on that buffer (StringInputStream).
+ *    1. Open a new ZipInputStream for each file
+ *    2. (currently used) First read the file into a memory buffer,
+ *      return a stream based on that buffer.
+ *  The zip directory is read once when opening the package, after that the single zipStream is used
+ *  to seek to entries. The decompressed files are kept in a small cache shared by all packages,
+ *  so files that are opened repeatedly (images, include files) are only decompressed once.
  *
  *  TODO: maybe support sub packages (a package inside another package)?
  */
@@ -234,6 +237,19 @@ private:
   FileInfos files;
   /// Filestream/zipstream for reading zip files
   unique_ptr<wxZipInputStream> zipStream;
+  
+  /// Decompressed contents of a file in the zip file
+  typedef shared_ptr<const vector<Byte>> ZipData;
+  /// Guards zipStream, because files are also read from other threads
+  /** Recursive, because saving reads the changed files while copying the zip file */
+  wxMutex zipMutex;
+  
+  /// Open a file in the zip archive, using the cache if possible
+  unique_ptr<wxInputStream> openZipEntry(const String& name, wxZipEntry* entry);
+  /// Read a file from the zip archive into memory, returns nullptr if that fails
+  ZipData readZipEntry(const String& name, wxZipEntry* entry);
+  /// Remove all files of this package from the zip cache
+  void clearZipCache();
 
   void loadZipStream();
   void openDirectory(bool fast = false);
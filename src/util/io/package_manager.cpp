@@ -16,6 +16,8 @@
 #include <data/locale.hpp>
 #include <data/export_template.hpp>
 #include <data/installer.hpp>
+#include <gfx/generated_image.hpp>
+#include <script/value.hpp>
 #include <wx/stdpaths.h>
 #include <wx/wfstream.h>
 
@@ -34,9 +36,13 @@ void PackageManager::init() {
 }
 void PackageManager::destroy() {
   loaded_packages.clear();
+  clear_generated_image_cache();
+  clear_member_caches();
 }
 void PackageManager::reset() {
   loaded_packages.clear();
+  clear_generated_image_cache(); // the shared images refer to the packages
+  clear_member_caches();          // and the script caches to their fields
 }
 
 PackagedP PackageManager::openAny(const String& name_, bool just_header) {
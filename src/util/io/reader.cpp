@@ -19,13 +19,17 @@ using boost::tribool;
 // ----------------------------------------------------------------------------- : Reader
 
 Reader::Reader(wxInputStream& input, Packaged* package, const String& filename, bool ignore_invalid)
-  : indent(0), expected_indent(0), state(OUTSIDE)
+  : key_id(NO_NAME_ID), key_id_known(false)
+  , indent(0), expected_indent(0), state(OUTSIDE)
   , ignore_invalid(ignore_invalid)
   , filename(filename), package(package), line_number(0), previous_line_number(0)
-  , input(input)
+  , data_pos(0), eof(false)
 {
   assert(input.IsOk());
-  eat_utf8_bom(input);
+  read_all(input, data);
+  if (data.size() >= 3 && (Byte)data[0] == 0xEF && (Byte)data[1] == 0xBB && (Byte)data[2] == 0xBF) {
+    data_pos = 3; // utf-8 byte order mark
+  }
   moveNext();
   handleAppVersion();
 }
@@ -79,6 +83,23 @@ bool Reader::enterBlock(const Char* name) {
   }
 }
 
+bool Reader::enterBlock(NameId name) {
+  if (state == ENTERED) moveNext(); // on the key of the parent block, first move inside it
+  if (indent != expected_indent) return false; // not enough indentation
+  if (!key_id_known) {
+    // look up the key once per line
+    key_id = find_name_id(key);
+    key_id_known = true;
+  }
+  if (key_id == name) {
+    state = ENTERED;
+    expected_indent += 1; // the indent inside the block must be at least this much
+    return true;
+  } else {
+    return false;
+  }
+}
+
 void Reader::exitBlock() {
   assert(expected_indent > 0);
   expected_indent -= 1;
@@ -99,47 +120,49 @@ void Reader::moveNext() {
   key.clear();
   indent = -1; // if no line is read it never has the expected indentation
   // repeat until we have a good line
-  while (key.empty() && !input.Eof()) {
+  while (key.empty() && !eof) {
     readLine();
   }
   // did we reach the end of the file?
-  if (key.empty() && input.Eof()) {
+  if (key.empty() && eof) {
     line_number += 1;
     indent = -1;
   }
 }
 
-/// Faster vector, uses large local storage
-/** Usually a line from a file doesn't use very many characters.
- *  In that case, allocating a vector is a waste of resources.
- *  2007-09-21: Profiling => Using this class roughly halves the runtime of read_utf8_line,
- *              making startup slightly faster.
+/// Read all remaining data from an input stream
+/** Reading in large blocks is much faster than reading a character at a time with GetC,
+ *  even from a buffered stream.
  */
-template <typename T> class LocalVector {
-public:
-  LocalVector() : the_size(0), alloced(SMALL_SIZE), buffer(small) {}
-  ~LocalVector() { if (buffer != small) free(buffer); }
-  void push_back(T t) {
-    if (the_size >= alloced) {
-      // double buffer size
-      if (buffer != small) {
-        buffer = (T*)realloc(buffer, sizeof(T) * alloced * 2);
-      } else {
-        buffer = (T*)malloc(sizeof(T) * alloced * 2);
-        memcpy(buffer, small, alloced * sizeof(T));
-      }
-      alloced *= 2;
-    }
-    buffer[the_size++] = t;
-  }
-  inline const T* get() const { return buffer; }
-  inline size_t size() const { return the_size; }
-private:
-  static const int SMALL_SIZE = 1024;
-  size_t the_size, alloced;
-  T* buffer;
-  T small[SMALL_SIZE];
-};
+void read_all(wxInputStream& input, vector<char>& out) {
+  const size_t BLOCK_SIZE = 64 * 1024;
+  wxFileOffset length = input.GetLength(), pos = input.TellI();
+  if (length != wxInvalidOffset && pos != wxInvalidOffset && length > pos) {
+    // one extra byte, so we can see the end of the stream without growing the buffer
+    out.reserve(out.size() + (size_t)(length - pos) + 1);
+  }
+  size_t size = out.size();
+  while (true) {
+    if (size == out.capacity()) out.reserve(max(2 * size, BLOCK_SIZE));
+    out.resize(out.capacity());
+    size_t read = input.Read(out.data() + size, out.size() - size).LastRead();
+    if (read == 0) break;
+    size += read;
+  }
+  out.resize(size);
+}
+
+/// Decode UTF-8 text
+/** As opposed to wx functions, this one actually reports errors
+ */
+String decode_utf8(const char* text, size_t size) {
+  if (size == 0) return String();
+  String decoded = String::FromUTF8(text, size);
+  if (decoded.empty()) {
+    throw ParseError(_("Invalid UTF-8 sequence"));
+  }
+  return decoded;
+}
 
 /// Eat a utf-8 byte order mark from the begining of a stream
 bool eat_utf8_bom(wxInputStream& input) {
@@ -159,11 +182,13 @@ bool eat_utf8_bom(wxInputStream& input) {
  */
 String read_utf8_line(wxInputStream& input, bool until_eof = false);
 String read_utf8_line(wxInputStream& input, bool until_eof) {
-  LocalVector<char> buffer;
-  while (true) {
-    int c = input.GetC();
-    if (c == EOF) break;
-    if (!until_eof) {
+  vector<char> buffer;
+  if (until_eof) {
+    read_all(input, buffer);
+  } else {
+    while (true) {
+      int c = input.GetC();
+      if (c == EOF) break;
       if (c == '\n') break;
       if (c == '\r') {
         c = input.GetC();
@@ -172,25 +197,44 @@ String read_utf8_line(wxInputStream& input, bool until_eof) {
         }
         break; 
       }
+      buffer.push_back((char)c);
     }
-    buffer.push_back((Byte)c);
-  }
-  // convert to string
-  // TODO: Doing this in one step should be faster
-  size_t size = wxConvUTF8.ToWChar(nullptr, 0, buffer.get(), buffer.size());
-  if (size == size_t(-1)) {
-    throw ParseError(_("Invalid UTF-8 sequence"));
-  } else if (size == 0) {
-    return _("");
   }
-  return wxString::FromUTF8(buffer.get(), buffer.size());
+  return decode_utf8(buffer.data(), buffer.size());
 }
 
 void Reader::readLine(bool in_string) {
   line_number += 1;
+  key_id_known = false;
   // We have to do our own line reading, because wxTextInputStream is insane
+  // find the end of the line, memchr is vectorized by most C libraries
+  const char* begin = data.data() + data_pos;
+  const char* end   = data.data() + data.size();
+  const char* line_end = end;
+  if (begin == end) {
+    eof = true;
+  } else {
+    const char* nl = (const char*)memchr(begin, '\n', end - begin);
+    if (nl) line_end = nl;
+    const char* cr = (const char*)memchr(begin, '\r', line_end - begin);
+    if (cr) {
+      // \r or \r\n
+      line_end = cr;
+      data_pos = cr + 1 - data.data();
+      if (cr + 1 == end) {
+        eof = true;
+      } else if (cr[1] == '\n') {
+        data_pos += 1;
+      }
+    } else if (nl) {
+      data_pos = nl + 1 - data.data();
+    } else {
+      data_pos = data.size();
+      eof = true;
+    }
+  }
   try {
-    line = read_utf8_line(input);
+    line = decode_utf8(begin, line_end - begin);
   } catch (const ParseError& e) {
     throw ParseError(e.what() + String(_(" on line ")) << line_number);
   }
@@ -215,7 +259,8 @@ void Reader::readLine(bool in_string) {
       indent += 1;
     }
   }
-  key = canonical_name_form(trim(key));
+  key = String(trim(key));
+  canonical_name_form_in_place(key);
   if (pos == String::npos) {
     if (!ignore_invalid && !in_string) {
       warning(_("Missing ':' "), 0, false);
@@ -265,7 +310,7 @@ const String& Reader::getValue() {
     // read all lines that are indented enough
     readLine(true);
     previous_line_number = line_number;
-    while (indent >= expected_indent && !input.Eof()) {
+    while (indent >= expected_indent && !eof) {
       previous_value.resize(previous_value.size() + pending_newlines, _('\n'));
       pending_newlines = 0;
       previous_value += line.substr(expected_indent); // strip expected indent
@@ -273,15 +318,15 @@ const String& Reader::getValue() {
         readLine(true);
         pending_newlines++;
         // skip empty lines that are not indented enough
-      } while(trim(line).empty() && indent < expected_indent && !input.Eof());
+      } while(trim(line).empty() && indent < expected_indent && !eof);
     }
     // moveNext(), but without the initial readLine()
     state = HANDLED;
-    while (key.empty() && !input.Eof()) {
+    while (key.empty() && !eof) {
       readLine();
     }
     // did we reach the end of the file?
-    if (key.empty() && input.Eof()) {
+    if (key.empty() && eof) {
       line_number += 1;
       indent = -1;
     }
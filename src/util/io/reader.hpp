@@ -131,6 +131,9 @@ private:
   String line;
   /// The key and value of the last line we read
   String key, value;
+  /// Interned key, only valid if key_id_known
+  NameId key_id;
+  bool key_id_known;
   /// Value of the *previous* line, only valid in state==HANDLED
   String previous_value;
   /// Indentation of the last line we read
@@ -155,8 +158,12 @@ private:
   int line_number;
   /// Line number of the previous_line
   int previous_line_number;
-  /// Input stream we are reading from
-  wxBufferedInputStream input;
+  /// The contents of the input stream, read in one go
+  vector<char> data;
+  /// Position of the next line in data
+  size_t data_pos;
+  /// Have we tried to read past the end of the data?
+  bool eof;
   /// Accumulated warning messages
   String warnings;
   
@@ -164,6 +171,8 @@ private:
   
   /// Is there a block with the given key under the current cursor? if so, enter it
   bool enterBlock(const Char* name);
+  /// Is there a block with the given interned key under the current cursor? if so, enter it
+  bool enterBlock(NameId name);
   /// Enter any block, no matter what the key
   bool enterAnyBlock();
   /// Leave the block we are in
@@ -260,8 +269,12 @@ void Reader::handle(unordered_map<String, V>& m) {
 
 template <typename K, typename V>
 void Reader::handle(IndexMap<K,V>& m) {
+  // compare interned names, there are many keys to try for each line
   for (typename IndexMap<K,V>::iterator it = m.begin() ; it != m.end() ; ++it) {
-    handle(get_key_name(*it).c_str(), *it);
+    if (enterBlock(get_key_name_id(*it))) {
+      handle_greedy(*it);
+      exitBlock();
+    }
   }
 }
 
@@ -0,0 +1,22 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/lru_cache.hpp>
+
+// ----------------------------------------------------------------------------- : Cache counters
+
+double CacheCounter::hitRate() const {
+  long h = hits, m = misses;
+  return h + m > 0 ? (double)h / (h + m) : 0.0;
+}
+
+void CacheCounter::reset() {
+  hits   = 0;
+  misses = 0;
+}
@@ -0,0 +1,85 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <wx/thread.h>
+#include <atomic>
+#include <list>
+#include <unordered_map>
+
+// ----------------------------------------------------------------------------- : Cache counters
+
+/// Number of hits and misses of a cache
+struct CacheCounter {
+  atomic<long> hits{0};
+  atomic<long> misses{0};
+  
+  /// Fraction of lookups that were hits, 0 if there were no lookups
+  double hitRate() const;
+  void reset();
+};
+
+// ----------------------------------------------------------------------------- : LruCache
+
+/// A cache from strings to values that keeps the most recently used entries
+/** The cache is shared between threads, all access is locked. */
+template <typename V>
+class LruCache {
+public:
+  LruCache(size_t capacity, CacheCounter& counter) : capacity(capacity), counter(counter) {}
+  
+  /// Find a value, returns false if it is not in the cache
+  bool find(const String& key, V& out) {
+    wxMutexLocker lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end()) {
+      counter.misses++;
+      return false;
+    }
+    counter.hits++;
+    items.splice(items.begin(), items, it->second); // most recently used
+    out = it->second->second;
+    return true;
+  }
+  /// Add a value, removes the least recently used value if the cache is full
+  void store(const String& key, const V& value) {
+    wxMutexLocker lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end()) {
+      it->second->second = value;
+      items.splice(items.begin(), items, it->second);
+      return;
+    }
+    items.emplace_front(key, value);
+    index[key] = items.begin();
+    if (items.size() > capacity) {
+      index.erase(items.back().first);
+      items.pop_back();
+    }
+  }
+  void clear() {
+    wxMutexLocker lock(mutex);
+    index.clear();
+    items.clear();
+  }
+  /// Number of values in the cache
+  size_t size() {
+    wxMutexLocker lock(mutex);
+    return items.size();
+  }
+  
+private:
+  typedef list<pair<String,V>> Items;
+  size_t        capacity;
+  CacheCounter& counter;
+  wxMutex       mutex;
+  Items         items; ///< Most recently used first
+  unordered_map<String, typename Items::iterator> index;
+};
@@ -79,6 +79,10 @@
     inline bool matches(Results& results, const String::const_iterator& begin, const String::const_iterator& end) const {
       return regex_search(begin, end, results, regex);
     }
+    /// Search starting in the middle of a string, the text before begin is used for word boundaries
+    inline bool matchesAfter(Results& results, const String::const_iterator& begin, const String::const_iterator& end) const {
+      return regex_search(begin, end, results, regex, boost::match_prev_avail);
+    }
     String replace_all(const String& input, const String& format) const;
     
     inline bool empty() const {
@@ -365,6 +365,10 @@ double RotatedDC::GetCharHeight() const {
   }
 }
 
+String RotatedDC::textExtentKey() const {
+  return String::Format(_("%s|%.17g|%.17g|%d"), dc.GetFont().GetNativeFontInfoDesc(), zoomX, zoomY, (int)quality);
+}
+
 void RotatedDC::SetClippingRegion(const RealRect& rect) {
   dc.SetDeviceClippingRegion(trRectToRegion(rect));
 }
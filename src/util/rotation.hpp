@@ -200,6 +200,9 @@ public:
   
   RealSize GetTextExtent(const String& text) const;
   double GetCharHeight() const;
+  /// Identifies the current font, zoom and quality
+  /** As long as the key is the same, GetTextExtent gives the same results */
+  String textExtentKey() const;
   
   void SetClippingRegion(const RealRect& rect);
   void DestroyClippingRegion();
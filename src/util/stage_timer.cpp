@@ -0,0 +1,45 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/stage_timer.hpp>
+
+// ----------------------------------------------------------------------------- : Stage timing
+
+atomic<bool> stage_timing_enabled(false);
+
+// nanoseconds and number of calls for each stage
+atomic<long long> stage_nanoseconds[STAGE_COUNT];
+atomic<long>      stage_calls[STAGE_COUNT];
+
+const char* stage_name(RenderStage stage) {
+  switch (stage) {
+    case STAGE_SCRIPT_UPDATE:  return "script_update";
+    case STAGE_TEXT_LAYOUT:    return "text_layout";
+    case STAGE_IMAGE_GENERATE: return "image_generate";
+    case STAGE_IMAGE_ENCODE:   return "png_encode";
+    default:                   return "unknown";
+  }
+}
+
+StageTime stage_time(RenderStage stage) {
+  StageTime t = { stage_nanoseconds[stage] * 1e-9, stage_calls[stage] };
+  return t;
+}
+
+void reset_stage_times() {
+  for (int i = 0 ; i < STAGE_COUNT ; ++i) {
+    stage_nanoseconds[i] = 0;
+    stage_calls[i] = 0;
+  }
+}
+
+void add_stage_time(RenderStage stage, std::chrono::steady_clock::duration time) {
+  stage_nanoseconds[stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+  stage_calls[stage] += 1;
+}
@@ -0,0 +1,60 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <atomic>
+#include <chrono>
+
+// ----------------------------------------------------------------------------- : Stage timing
+
+/// Parts of rendering a card that are timed separately, for benchmarking
+enum RenderStage
+{  STAGE_SCRIPT_UPDATE   ///< Updating the styles of a card (SetScriptManager::updateStyles)
+,  STAGE_TEXT_LAYOUT     ///< Laying out text (TextViewer::prepare)
+,  STAGE_IMAGE_GENERATE  ///< Generating images (ScriptableImage::generate)
+,  STAGE_IMAGE_ENCODE    ///< Encoding the rendered card as PNG
+,  STAGE_COUNT
+};
+
+/// Total time spent in a stage
+struct StageTime {
+  double seconds;
+  long   calls;
+};
+
+/// Are stage times being recorded? Off by default, so timers cost next to nothing
+extern atomic<bool> stage_timing_enabled;
+
+/// Name of a stage, as used in benchmark output
+const char* stage_name(RenderStage stage);
+/// Time spent in a stage since the last reset
+StageTime stage_time(RenderStage stage);
+/// Reset all stage times to 0
+void reset_stage_times();
+/// Add to the time of a stage, can be called from any thread
+void add_stage_time(RenderStage stage, std::chrono::steady_clock::duration time);
+
+/// Time the rest of the current scope as part of a stage
+/** Stages should not be nested, since the time would be counted twice. */
+class StageTimer {
+public:
+  inline StageTimer(RenderStage stage)
+    : stage(stage), enabled(stage_timing_enabled)
+  {
+    if (enabled) start = std::chrono::steady_clock::now();
+  }
+  inline ~StageTimer() {
+    if (enabled) add_stage_time(stage, std::chrono::steady_clock::now() - start);
+  }
+private:
+  RenderStage stage;
+  bool        enabled;
+  std::chrono::steady_clock::time_point start;
+};
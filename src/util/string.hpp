@@ -162,11 +162,11 @@ public:
   inline bool empty() const {
     return begin() == end();
   }
-  inline bool operator == (StringView const& str) {
+  inline bool operator == (StringView const& str) const {
     return str.size() == size() && std::equal(begin(), end(), str.begin());
   }
   template <typename AnyChar>
-  inline bool operator == (const AnyChar* str) {
+  inline bool operator == (const AnyChar* str) const {
     String::const_iterator it = begin_;
     while (true) {
       if (it == end_) return *str == '\0';
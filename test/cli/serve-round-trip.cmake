@@ -0,0 +1,44 @@
+# Round trip through the export server: send requests to magicseteditor --serve, and check the responses
+#   cmake -DMSE=path/to/magicseteditor -DREQUESTS=serve-requests.jsonl -P serve-round-trip.cmake
+execute_process(
+  COMMAND ${MSE} --serve
+  INPUT_FILE ${REQUESTS}
+  OUTPUT_VARIABLE output
+  RESULT_VARIABLE result
+)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "magicseteditor --serve failed: ${result}\n${output}")
+endif()
+
+# one response line per request, up to and including the quit command
+string(REPLACE ";" "\;" output_escaped "${output}")
+string(REGEX REPLACE "\n$" "" output_escaped "${output_escaped}")
+string(REPLACE "\n" ";" lines "${output_escaped}")
+list(LENGTH lines count)
+if (NOT count EQUAL 6)
+  message(FATAL_ERROR "Expected 6 response lines, got ${count}:\n${output}")
+endif()
+
+function(expect index text)
+  list(GET lines ${index} line)
+  string(FIND "${line}" "${text}" pos)
+  if (pos EQUAL -1)
+    message(FATAL_ERROR "Response ${index} should contain ${text}:\n${line}")
+  endif()
+endfunction()
+
+expect(0 [["id":1]])
+expect(0 [["ok":true]])
+expect(0 [["result":"3"]])
+# no printf formatting, and UTF-8 in both directions
+expect(1 [["ok":true]])
+expect(1 [[100%s %d ünïcode]])
+# warnings are part of the response, not separate lines
+expect(2 [["result":"3"]])
+expect(2 [["type":"warning","message":"careful"]])
+expect(3 [["ok":false]])
+expect(3 [[Unknown command: frobnicate]])
+expect(4 [["ok":false]])
+expect(4 [[Invalid JSON request]])
+expect(5 [["id":5]])
+expect(5 [["ok":true]])
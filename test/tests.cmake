@@ -15,6 +15,149 @@ add_test(
   NAME script-functions
   COMMAND magicseteditor ${test_dir}/script/script-functions.mse-script
 )
+add_test(
+  NAME script-functions-unoptimized
+  COMMAND magicseteditor ${test_dir}/script/script-functions.mse-script --no-optimize
+)
+
+# Export server
+# Requests are sent to --serve on stdin, each must get exactly one JSON line as the response
+add_test(
+  NAME export-server
+  COMMAND ${CMAKE_COMMAND} -DMSE=$<TARGET_FILE:magicseteditor> -DREQUESTS=${test_dir}/cli/serve-requests.jsonl
+          -P ${test_dir}/cli/serve-round-trip.cmake
+)
+
+# Image combining, blending and blurring kernels
+# The vectorized code must give the same results as the scalar code for all modes,
+# the gaussian blur must be close to an exact one, and generated images must only be shared between equal image graphs.
+# Timings go to blend-kernels.json
+add_test(
+  NAME blend-kernels
+  COMMAND magicseteditor --benchmark-blend ${CMAKE_BINARY_DIR}/blend-kernels.json
+)
+
+# Image resampling
+# The box filter must give the same results as the original resampler. Timings go to resample.json
+add_test(
+  NAME resample
+  COMMAND magicseteditor --benchmark-resample ${CMAKE_BINARY_DIR}/resample.json
+)
+
+# Updating all cards in parallel
+# A small game and set with scripted card fields, the parallel update must give the same values as the serial one.
+# Some fields only look at their own card, others at other cards, the set fields or the keywords,
+# so both the parallel and the serial part of the update are used. Four threads are used regardless of the processors.
+# The game is found as a local package, in the user data directory of a separate home directory.
+set(test_home "${CMAKE_BINARY_DIR}/test-home")
+if (WIN32)
+  set(test_user_data "${test_home}/AppData/Roaming/Magic Set Editor/data")
+elseif (APPLE)
+  set(test_user_data "${test_home}/Library/Application Support/magicseteditor/data")
+else()
+  set(test_user_data "${test_home}/.magicseteditor/data")
+endif()
+file(COPY ${PROJECT_SOURCE_DIR}/data/ ${test_dir}/update-all/packages/ DESTINATION ${test_user_data})
+add_test(
+  NAME update-all
+  COMMAND magicseteditor --benchmark ${test_dir}/update-all/update-test.mse-set ${CMAKE_BINARY_DIR}/update-all.json --repeat 3 --update --jobs 4
+)
+# Fields are made before their names are read, the script checks that they are found by name
+add_test(
+  NAME field-lookup
+  COMMAND magicseteditor --benchmark ${test_dir}/update-all/update-test.mse-set ${CMAKE_BINARY_DIR}/field-lookup.json
+          --script ${test_dir}/script/field-lookup.mse-script
+)
+
+# Benchmarks on the same set, so they always run. The timings are written to <test>.json in the build directory.
+# The rendering benchmark draws text with keywords and generated choice images, with the stylesheet in the test packages.
+set(test_set "${test_dir}/update-all/update-test.mse-set")
+add_test(
+  NAME render-benchmark
+  COMMAND magicseteditor --benchmark ${test_set} ${CMAKE_BINARY_DIR}/render-benchmark.json --repeat 3
+)
+add_test(
+  NAME member-access-benchmark
+  COMMAND magicseteditor --benchmark ${test_set} ${CMAKE_BINARY_DIR}/member-access-benchmark.json
+          --repeat 20 --script ${test_dir}/script/member-access-benchmark.mse-script
+)
+add_test(
+  NAME name-lookup-benchmark
+  COMMAND magicseteditor --benchmark ${test_set} ${CMAKE_BINARY_DIR}/name-lookup-benchmark.json
+          --repeat 20 --script ${test_dir}/script/name-lookup-benchmark.mse-script
+)
+add_test(
+  NAME arithmetic-benchmark
+  COMMAND magicseteditor --benchmark ${test_set} ${CMAKE_BINARY_DIR}/arithmetic-benchmark.json
+          --repeat 20 --script ${test_dir}/script/arithmetic-benchmark.mse-script
+)
+add_test(
+  NAME concat-benchmark
+  COMMAND magicseteditor --benchmark ${test_set} ${CMAKE_BINARY_DIR}/concat-benchmark.json
+          --repeat 5 --script ${test_dir}/script/concat-benchmark.mse-script
+)
+add_test(
+  NAME load-benchmark
+  COMMAND magicseteditor --benchmark ${test_set} ${CMAKE_BINARY_DIR}/load-benchmark.json --repeat 5 --load
+)
+add_test(
+  NAME parse-benchmark
+  COMMAND magicseteditor --benchmark ${test_set} ${CMAKE_BINARY_DIR}/parse-benchmark.json --repeat 20 --parse
+)
+add_test(
+  NAME keyword-benchmark
+  COMMAND magicseteditor --benchmark ${test_set} ${CMAKE_BINARY_DIR}/keyword-benchmark.json --repeat 20 --keywords
+)
+set_tests_properties(
+  update-all field-lookup render-benchmark member-access-benchmark name-lookup-benchmark arithmetic-benchmark
+  concat-benchmark load-benchmark parse-benchmark keyword-benchmark
+  PROPERTIES ENVIRONMENT "HOME=${test_home};USERPROFILE=${test_home};APPDATA=${test_home}/AppData/Roaming"
+)
 
-# Rendering tests
-# TODO
+# Benchmarks on a larger set
+# Point MSE_BENCHMARK_SET to a set, with its game and stylesheet installed, to run the same benchmarks on it, for example
+#   cmake -DMSE_BENCHMARK_SET=/path/to/some.mse-set
+# The timings are written to <test>.json in the build directory.
+set(MSE_BENCHMARK_SET "" CACHE FILEPATH "Set file to use for the *-benchmark-set tests")
+if (MSE_BENCHMARK_SET)
+  add_test(
+    NAME render-benchmark-set
+    COMMAND magicseteditor --benchmark ${MSE_BENCHMARK_SET} ${CMAKE_BINARY_DIR}/render-benchmark-set.json
+  )
+  add_test(
+    NAME member-access-benchmark-set
+    COMMAND magicseteditor --benchmark ${MSE_BENCHMARK_SET} ${CMAKE_BINARY_DIR}/member-access-benchmark-set.json
+            --repeat 20 --script ${test_dir}/script/member-access-benchmark.mse-script
+  )
+  add_test(
+    NAME name-lookup-benchmark-set
+    COMMAND magicseteditor --benchmark ${MSE_BENCHMARK_SET} ${CMAKE_BINARY_DIR}/name-lookup-benchmark-set.json
+            --repeat 20 --script ${test_dir}/script/name-lookup-benchmark.mse-script
+  )
+  add_test(
+    NAME arithmetic-benchmark-set
+    COMMAND magicseteditor --benchmark ${MSE_BENCHMARK_SET} ${CMAKE_BINARY_DIR}/arithmetic-benchmark-set.json
+            --repeat 20 --script ${test_dir}/script/arithmetic-benchmark.mse-script
+  )
+  add_test(
+    NAME concat-benchmark-set
+    COMMAND magicseteditor --benchmark ${MSE_BENCHMARK_SET} ${CMAKE_BINARY_DIR}/concat-benchmark-set.json
+            --repeat 5 --script ${test_dir}/script/concat-benchmark.mse-script
+  )
+  add_test(
+    NAME load-benchmark-set
+    COMMAND magicseteditor --benchmark ${MSE_BENCHMARK_SET} ${CMAKE_BINARY_DIR}/load-benchmark-set.json --repeat 5 --load
+  )
+  add_test(
+    NAME update-all-stress
+    COMMAND magicseteditor --benchmark ${MSE_BENCHMARK_SET} ${CMAKE_BINARY_DIR}/update-all-stress.json --repeat 10 --update
+  )
+  add_test(
+    NAME parse-benchmark-set
+    COMMAND magicseteditor --benchmark ${MSE_BENCHMARK_SET} ${CMAKE_BINARY_DIR}/parse-benchmark-set.json --repeat 20 --parse
+  )
+  add_test(
+    NAME keyword-benchmark-set
+    COMMAND magicseteditor --benchmark ${MSE_BENCHMARK_SET} ${CMAKE_BINARY_DIR}/keyword-benchmark-set.json --repeat 20 --keywords
+  )
+endif()